@@ -27,6 +27,7 @@ but WITHOUT ANY WARRANTY of any kind.
 #include <mutex>
 
 #include "asd_client.h"
+#include "latency_tracker.h"
 #include "osd_info.h"
 
 namespace alba {
@@ -37,8 +38,12 @@ using asd_client::Asd_client;
 
 class ConnectionPool {
 public:
+  // timeout is for connecting, and for reads until the asd's latency is
+  // known (then it's between timeout_floor and timeout_ceiling)
   ConnectionPool(std::unique_ptr<proxy_protocol::OsdInfo>, size_t,
-                 std::chrono::steady_clock::duration timeout);
+                 std::chrono::steady_clock::duration timeout,
+                 std::chrono::steady_clock::duration timeout_floor,
+                 std::chrono::steady_clock::duration timeout_ceiling);
 
   ~ConnectionPool();
 
@@ -57,6 +62,16 @@ public:
   void release_connection(std::unique_ptr<Asd_client>);
   void report_failure();
 
+  // how long a read from this asd took (also when it failed)
+  void report_latency(std::chrono::steady_clock::duration);
+  // the same, for the first n of them
+  void report_latencies(
+      const std::vector<std::chrono::steady_clock::duration> &, size_t n);
+  // what the next read gets, see latency_tracker
+  std::chrono::steady_clock::duration read_timeout() const;
+  std::chrono::steady_clock::duration latency_percentile(double q) const;
+  latency_estimate latency() const;
+
 private:
   mutable std::mutex _mutex;
 
@@ -70,19 +85,28 @@ private:
 
   std::unique_ptr<Asd_client> make_one_() const;
 
+  void report_failure_();
+
   static std::unique_ptr<Asd_client> pop_(Connections &);
 
   static void clear_(Connections &);
 
   int _fast_path_failures;
   steady_clock::time_point _failure_time;
+
+  latency_tracker _latency;
 };
 
 class ConnectionPools {
 public:
   ConnectionPool *
   get_connection_pool(const proxy_protocol::OsdInfo &, int connection_pool_size,
-                      std::chrono::steady_clock::duration timeout);
+                      std::chrono::steady_clock::duration timeout,
+                      std::chrono::steady_clock::duration timeout_floor,
+                      std::chrono::steady_clock::duration timeout_ceiling);
+
+  // per asd (long id)
+  std::map<std::string, latency_estimate> latency_estimates() const;
 
   ConnectionPools() = default;
 
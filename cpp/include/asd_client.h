@@ -44,6 +44,25 @@ struct asd_exception : std::exception {
   virtual const char *what() const noexcept { return _what.c_str(); }
 };
 
+struct partial_get_request {
+  const string *key;
+  vector<slice> slices;
+};
+
+/* lets the caller of partial_gets know when the keys and targets of its
+   requests are in use, and change them in between */
+class requests_hook {
+public:
+  virtual ~requests_hook() {}
+  // requests[first ..] are about to be used: the keys of those that aren't
+  // written yet, and the targets of requests[first]
+  virtual void using_requests(vector<partial_get_request> &,
+                              size_t first) = 0;
+  // .. and they aren't anymore, until the next using_requests
+  // (also called when partial_gets throws, in use or not)
+  virtual void done_with_requests() = 0;
+};
+
 class Asd_client : public boost::intrusive::slist_base_hook<> {
 public:
   Asd_client(const std::chrono::steady_clock::duration &,
@@ -51,6 +70,25 @@ public:
              boost::optional<string> long_id);
 
   void partial_get(string &, vector<slice> &);
+
+  /* pipelined: up to max_in_flight requests are written before the first
+     response is read, and every response read makes room for one more.
+     The asd answers in order, so responses are matched by position.
+     max_in_flight 0 means no limit; 1 is one round trip per request.
+  */
+  void partial_gets(vector<partial_get_request> &, size_t max_in_flight = 0);
+  // the same, with its own timeout instead of the client's
+  // (for every response, not for all of them together)
+  void partial_gets(vector<partial_get_request> &, size_t max_in_flight,
+                    const std::chrono::steady_clock::duration &timeout,
+                    requests_hook *hook = nullptr);
+  /* what each response of the last partial_gets took: from when its
+     request was written, or when the response before it was in if that's
+     later. When partial_gets failed, the last one is how long it waited
+     for the response that didn't come. */
+  const vector<std::chrono::steady_clock::duration> &response_times() const {
+    return _response_times;
+  }
   void set_slowness(asd_protocol::slowness_t &slowness);
   std::tuple<int32_t, int32_t, int32_t, std::string> get_version();
 
@@ -61,7 +99,17 @@ private:
   std::unique_ptr<transport::Transport> _transport;
   const std::chrono::steady_clock::duration _timeout;
   llio::message_builder _mb;
+  std::vector<char> _requests;
+  std::shared_ptr<llio::message_buffer> _response;
+  vector<std::chrono::steady_clock::time_point> _written_at;
+  vector<std::chrono::steady_clock::duration> _response_times;
+  std::vector<struct iovec> _iov;
   void check_status(const char *function_name);
+  void _write_partial_get_requests(vector<partial_get_request> &,
+                                   size_t first, size_t last);
+  void _read_partial_get_response(vector<slice> &);
+  void _read_partial_get_response_header();
+  void _read_partial_get_data(vector<slice> &);
 };
 }
 }
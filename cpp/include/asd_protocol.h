@@ -60,8 +60,8 @@ extern const uint32_t _VERSION;
 
 void make_prologue(message_builder &mb, boost::optional<string> long_id);
 
-void write_partial_get_request(message_builder &mb, string &key,
-                               vector<slice> &slices);
+void write_partial_get_request(message_builder &mb, const string &key,
+                               const vector<slice> &slices);
 void read_partial_get_response(message &m, Status &status, bool &success);
 
 typedef boost::optional<std::pair<double, double>> slowness_t;
@@ -0,0 +1,45 @@
+/*
+Copyright (C) 2016 iNuron NV
+
+This file is part of Open vStorage Open Source Edition (OSE), as available from
+
+
+    http://www.openvstorage.org and
+    http://www.openvstorage.com.
+
+This file is free software; you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License v3 (GNU AGPLv3)
+as published by the Free Software Foundation, in version 3 as it comes
+in the <LICENSE.txt> file of the Open vStorage OSE distribution.
+
+Open vStorage is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY of any kind.
+*/
+
+#pragma once
+#include <cstddef>
+
+namespace alba {
+namespace llio {
+namespace buffer_pool {
+
+/* size classed pool for the buffers behind message_buffer and
+   message_builder. Sizes are rounded up to a power of two (at least
+   MIN_CAPACITY); released buffers go to a free list of the releasing thread,
+   and when that one is full, to a global one. Buffers above MAX_CAPACITY
+   are not pooled and get exactly the size asked for.
+*/
+const size_t MIN_CAPACITY = 64;
+const size_t MAX_CAPACITY = 8 << 20;
+
+// capacity of the buffer allocate(size) returns
+size_t capacity_for(size_t size);
+
+// returns a buffer of capacity_for(size) bytes
+char *allocate(size_t size);
+
+// capacity needs to be what capacity_for returned for the allocation
+void release(char *buffer, size_t capacity);
+}
+}
+}
@@ -22,6 +22,7 @@ but WITHOUT ANY WARRANTY of any kind.
 #include "llio.h"
 #include "stuff.h"
 #include <iostream>
+#include <memory>
 
 namespace alba {
 #define SHA_SIZE 20
@@ -76,4 +77,22 @@ std::ostream &operator<<(std::ostream &, const algo_t &);
 std::ostream &operator<<(std::ostream &, const Checksum &);
 
 bool verify(const Checksum &c0, const Checksum &c1);
+
+/* computing them, as the ocaml side does:
+   crc32c is CRC-32C (Castagnoli), with sse4.2's crc32 instruction (or
+   armv8's) when the cpu has it, and a table otherwise. sha1 is
+   libgcrypt's, which takes the sha extensions where the cpu has those.
+*/
+
+// crc32c(crc32c(0, a), b) is the crc32c of a followed by b
+uint32_t crc32c(uint32_t crc, const uint8_t *data, size_t size);
+
+// the SHA_SIZE byte digest
+std::string sha1(const uint8_t *data, size_t size);
+
+std::unique_ptr<Checksum> compute_checksum(algo_t, const uint8_t *data,
+                                           size_t size);
+
+// data has checksum c (always true for a NoChecksum)
+bool verify(const Checksum &c, const uint8_t *data, size_t size);
 }
@@ -0,0 +1,213 @@
+/*
+Copyright (C) 2016 iNuron NV
+
+This file is part of Open vStorage Open Source Edition (OSE), as available from
+
+
+    http://www.openvstorage.org and
+    http://www.openvstorage.com.
+
+This file is free software; you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License v3 (GNU AGPLv3)
+as published by the Free Software Foundation, in version 3 as it comes
+in the <LICENSE.txt> file of the Open vStorage OSE distribution.
+
+Open vStorage is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY of any kind.
+*/
+
+#pragma once
+#include "manifest.h"
+#include <boost/utility/string_ref.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace alba {
+namespace proxy_protocol {
+
+/* a ManifestWithNamespaceId as the rora client keeps it in its cache:
+   one contiguous block without pointers, with the per fragment data
+   as arrays (structure of arrays) and all strings in a pool at the end.
+   The block can be copied around (or written to disk) as is.
+
+   block layout (n chunks, f fragments):
+     header
+     uint64_t osd[f], chunk_offset[n + 1]
+     uint32_t chunk_size[n], first_fragment[n + 1],
+              version[f], length[f], crc[f], ctr[f], fnr[f]
+     uint8_t  flags[f], crc_algo[f]
+     pool: entries of (uint32_t length, bytes)
+   crc, ctr and fnr are offsets of pool entries.
+   chunk_offset[c] is where chunk c starts in the object
+   (chunk_offset[n] is the sum of all chunk sizes).
+*/
+class CompactManifest {
+public:
+  /* collects the parts of a manifest, so it can be decoded
+     straight into a CompactManifest (see llio::from2) */
+  struct builder {
+    std::string name;
+    std::string object_id;
+    std::vector<uint32_t> chunk_sizes;
+    EncodingScheme encoding_scheme;
+    compressor_t compressor = compressor_t::NO_COMPRESSION;
+    std::shared_ptr<EncryptInfo> encrypt_info;
+    algo_t checksum_algo = algo_t::NO_CHECKSUM;
+    std::string checksum_digest;
+    uint64_t size = 0;
+    uint32_t version_id = 0;
+    uint32_t max_disks_per_node = 0;
+    double timestamp = 1.0;
+    namespace_t namespace_id{0};
+
+    // fragments go in chunk after chunk
+    void add_chunk(uint32_t n_fragments);
+    void add_fragment(const boost::optional<osd_t> &osd, uint32_t version,
+                      algo_t crc_algo, const char *crc, uint32_t crc_size,
+                      uint32_t length);
+    // for the last fragment added
+    void set_ctr(const char *ctr, uint32_t size);
+    void set_fnr(const char *fnr, uint32_t size);
+    // when fragments and chunks came in last to first
+    void reverse();
+
+  private:
+    friend class CompactManifest;
+    uint32_t _add(const char *data, uint32_t size);
+
+    std::vector<uint32_t> _fragments_per_chunk;
+    std::vector<uint64_t> _osds;
+    std::vector<uint32_t> _versions, _lengths, _crcs, _ctrs, _fnrs;
+    std::vector<uint8_t> _flags, _crc_algos;
+    std::string _pool;
+  };
+
+  explicit CompactManifest(const ManifestWithNamespaceId &);
+  explicit CompactManifest(builder &&);
+
+  // from a block produced by block()
+  // (throws llio::deserialisation_exception if it doesn't add up)
+  CompactManifest(const char *block, size_t size,
+                  std::shared_ptr<EncryptInfo> encrypt_info);
+
+  CompactManifest(const CompactManifest &) = delete;
+  CompactManifest &operator=(const CompactManifest &) = delete;
+
+  const char *block() const { return _block.get(); }
+  size_t block_size() const { return _block_size; }
+  // everything this takes, the block included
+  size_t memory_size() const;
+
+  std::string name() const;
+  std::string object_id() const;
+  // the same without a copy, it points into the block
+  boost::string_ref object_id_ref() const;
+  uint64_t size() const { return _header().size; }
+  namespace_t namespace_id() const {
+    return namespace_t{_header().namespace_id};
+  }
+  uint32_t version_id() const { return _header().version_id; }
+  uint32_t max_disks_per_node() const { return _header().max_disks_per_node; }
+  double timestamp() const { return _header().timestamp; }
+  EncodingScheme encoding_scheme() const;
+  compressor_t compressor() const { return (compressor_t)_header().compressor; }
+  const std::shared_ptr<EncryptInfo> &encrypt_info() const {
+    return _encrypt_info;
+  }
+  std::unique_ptr<Checksum> checksum() const;
+
+  uint32_t n_chunks() const { return _header().n_chunks; }
+  uint32_t chunk_size(uint32_t chunk) const { return _chunk_sizes()[chunk]; }
+  uint64_t chunk_offset(uint32_t chunk) const {
+    return _chunk_offsets()[chunk];
+  }
+  // the chunk holding the byte at pos (n_chunks() if pos is past the end),
+  // a binary search on chunk_offset.
+  uint32_t chunk_at(uint64_t pos) const;
+  uint32_t n_fragments(uint32_t chunk) const {
+    return _first_fragment()[chunk + 1] - _first_fragment()[chunk];
+  }
+
+  fragment_location_t fragment_location(uint32_t chunk,
+                                        uint32_t fragment) const;
+  uint32_t fragment_length(uint32_t chunk, uint32_t fragment) const {
+    return _lengths()[_index(chunk, fragment)];
+  }
+  std::unique_ptr<Checksum> fragment_checksum(uint32_t chunk,
+                                              uint32_t fragment) const;
+  boost::optional<std::string> fragment_ctr(uint32_t chunk,
+                                            uint32_t fragment) const;
+  boost::optional<boost::string_ref> fragment_ctr_ref(uint32_t chunk,
+                                                     uint32_t fragment) const;
+  boost::optional<std::string> fragment_fnr(uint32_t chunk,
+                                            uint32_t fragment) const;
+
+  // back to the decoded form (for printing and tests)
+  std::unique_ptr<ManifestWithNamespaceId> expand() const;
+
+private:
+  struct header {
+    uint64_t size;
+    uint64_t namespace_id;
+    double timestamp;
+    uint32_t n_chunks;
+    uint32_t n_fragments;
+    uint32_t k;
+    uint32_t m;
+    uint32_t version_id;
+    uint32_t max_disks_per_node;
+    uint32_t name;
+    uint32_t object_id;
+    uint32_t checksum;
+    uint32_t pool_size;
+    uint8_t w;
+    uint8_t compressor;
+    uint8_t checksum_algo;
+    uint8_t padding[5];
+  };
+
+  std::unique_ptr<char[]> _block;
+  size_t _block_size;
+  std::shared_ptr<EncryptInfo> _encrypt_info;
+
+  // where the arrays start, for n chunks and f fragments
+  struct offsets {
+    offsets(uint32_t n, uint32_t f);
+    size_t osd, chunk_offset, chunk_size, first_fragment, version, length,
+        crc, ctr, fnr, flags, crc_algo, pool;
+  };
+
+  const header &_header() const { return *(const header *)_block.get(); }
+  template <typename T> const T *_array(size_t offset) const {
+    return (const T *)(_block.get() + offset);
+  }
+  offsets _offsets() const {
+    return offsets(_header().n_chunks, _header().n_fragments);
+  }
+  const uint64_t *_chunk_offsets() const {
+    return _array<uint64_t>(_offsets().chunk_offset);
+  }
+  const uint32_t *_chunk_sizes() const {
+    return _array<uint32_t>(_offsets().chunk_size);
+  }
+  const uint32_t *_first_fragment() const {
+    return _array<uint32_t>(_offsets().first_fragment);
+  }
+  const uint32_t *_lengths() const {
+    return _array<uint32_t>(_offsets().length);
+  }
+  uint32_t _index(uint32_t chunk, uint32_t fragment) const {
+    return _first_fragment()[chunk] + fragment;
+  }
+  boost::string_ref _pool_ref(uint32_t offset) const;
+  std::string _pool_string(uint32_t offset) const {
+    return _pool_ref(offset).to_string();
+  }
+  void _build(builder &);
+  void _validate() const;
+};
+
+std::ostream &operator<<(std::ostream &, const CompactManifest &);
+}
+}
@@ -18,7 +18,10 @@ but WITHOUT ANY WARRANTY of any kind.
 
 #pragma once
 
+#include <cstdint>
 #include <iostream>
+#include <memory>
+#include <string>
 
 namespace alba {
 namespace encryption {
@@ -71,13 +74,41 @@ public:
   virtual void print(std::ostream &os) const { os << "Encrypted()"; }
 
   virtual bool supports_partial_decrypt() const {
-    return mode == chaining_mode_t::CTR;
+    return mode == chaining_mode_t::CTR || mode == chaining_mode_t::CBC;
   }
 
+  /* decrypts the len bytes at offset in a fragment, in place.
+     CTR: ctr is the fragment's counter.
+     CBC: ctr is the iv of the block at offset, which is the (encrypted)
+     block before it, or fragment_iv at offset 0. offset and len are
+     multiples of the block size. */
   virtual bool partial_decrypt(unsigned char *buf, int len,
                                std::string &enc_key, std::string &ctr,
                                int offset) const;
 
+  // what partial_decrypt takes, with ctr the 16 bytes of the counter/iv
+  struct slice {
+    unsigned char *buf;
+    uint32_t len;
+    const unsigned char *ctr;
+    uint32_t offset;
+  };
+
+  /* partial_decrypt of n slices with the same key, in one pass: the
+     cipher (with its key schedule) is set up once, per slice only the
+     counter or iv is set. The cipher handles are kept per thread, so
+     this can be called from any number of threads at once. */
+  bool partial_decrypt(const std::string &enc_key, const slice *slices,
+                       size_t n) const;
+
+  /* the iv a fragment is CBC encrypted with, as the ocaml side's
+     Fragment_helper.get_iv makes it (not stored, derived from the key):
+     the last block of (object_id, chunk_id, fragment_id), padded and
+     encrypted. (fragment_id is 0 if the chunk is replicated, k = 1) */
+  std::string fragment_iv(const std::string &enc_key,
+                          const std::string &object_id, uint32_t chunk_id,
+                          uint32_t fragment_id) const;
+
   algo_t algo;
   chaining_mode_t mode;
   key_length_t key_length;
@@ -85,6 +116,13 @@ public:
   std::string key_identification;
 };
 
+/* the shared instance equal to ei (a copy of ei the first time it's seen).
+   The manifests of a namespace (nearly) all carry the same descriptor,
+   this way they share it. Interned descriptors live as long as the
+   process, so a plain pointer to one stays valid.
+*/
+std::shared_ptr<EncryptInfo> intern(const EncryptInfo &ei);
+
 std::ostream &operator<<(std::ostream &, const encryption_t &);
 std::ostream &operator<<(std::ostream &, const EncryptInfo &);
 std::ostream &operator<<(std::ostream &, const algo_t &);
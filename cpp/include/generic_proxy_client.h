@@ -19,6 +19,7 @@ but WITHOUT ANY WARRANTY of any kind.
 #pragma once
 
 #include "proxy_client.h"
+#include <functional>
 
 namespace alba {
 namespace proxy_client {
@@ -69,6 +70,13 @@ public:
                        const consistent_read,
                        std::vector<proxy_protocol::object_info> &,
                        alba::statistics::RoraCounter &);
+  // same, but leaves the decoding of the manifests to the caller
+  virtual void
+  read_objects_slices2(const std::string &namespace_,
+                       const std::vector<proxy_protocol::ObjectSlices> &,
+                       const consistent_read,
+                       std::vector<proxy_protocol::encoded_object_info> &,
+                       alba::statistics::RoraCounter &);
 
   virtual void write_object_fs2(const std::string &namespace_,
                                 const std::string &object_name,
@@ -135,6 +143,14 @@ protected:
   message_builder _mb;
 
   void check_status(const char *function_name);
+
+private:
+  std::vector<struct iovec> _iov;
+  // read_object_infos reads what follows the slice data in a v2 response
+  // (empty for the v1 response)
+  void _read_objects_slices_response(
+      const std::vector<proxy_protocol::ObjectSlices> &,
+      const std::function<void(message &)> &read_object_infos);
 };
 }
 }
@@ -0,0 +1,84 @@
+/*
+Copyright (C) 2016 iNuron NV
+
+This file is part of Open vStorage Open Source Edition (OSE), as available from
+
+
+    http://www.openvstorage.org and
+    http://www.openvstorage.com.
+
+This file is free software; you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License v3 (GNU AGPLv3)
+as published by the Free Software Foundation, in version 3 as it comes
+in the <LICENSE.txt> file of the Open vStorage OSE distribution.
+
+Open vStorage is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY of any kind.
+*/
+
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+
+namespace alba {
+namespace asd {
+
+struct latency_estimate {
+  std::chrono::steady_clock::duration ewma;
+  std::chrono::steady_clock::duration deviation;
+  std::chrono::steady_clock::duration p99;
+  std::chrono::steady_clock::duration timeout;
+  uint64_t samples;
+};
+
+std::ostream &operator<<(std::ostream &, const latency_estimate &);
+
+/* a streaming estimate of how long one asd takes to serve a read, and
+   the timeout that follows from it.
+   - a moving average with its mean deviation, as TCP keeps them for the
+     round trip time (gains 1/8 and 1/4)
+   - the 99th percentile from a histogram with 4 buckets per power of 2
+     (from 1us up to ~16s). Its counts are halved every 1024 samples, so
+     it follows the device when it gets faster or slower.
+   The timeout is twice the larger of p99 and average + 4 * deviation,
+   kept between floor and ceiling. Until there are 16 samples it's the
+   initial one.
+   A read that failed (timed out) counts with how long it took, which
+   moves the timeout up.
+   Not thread safe.
+*/
+class latency_tracker {
+public:
+  typedef std::chrono::steady_clock::duration duration;
+
+  latency_tracker(duration initial, duration floor, duration ceiling);
+
+  void add(duration sample);
+  duration timeout() const;
+  /* how long the fraction q (0 < q <= 1) of the reads takes at most, as
+     far as the histogram can tell (the end of a bucket). Never more than
+     the timeout, which is also what it is until there are 16 samples. */
+  duration percentile(double q) const;
+  latency_estimate estimate() const;
+
+private:
+  static const size_t _N_BUCKETS = 96;
+
+  duration _initial;
+  duration _floor;
+  duration _ceiling;
+
+  uint64_t _samples = 0;
+  // in microseconds
+  double _ewma = 0;
+  double _deviation = 0;
+
+  std::array<uint32_t, _N_BUCKETS> _buckets{};
+  uint32_t _in_buckets = 0;
+
+  double _percentile(double q) const;
+};
+}
+}
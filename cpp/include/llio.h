@@ -18,6 +18,7 @@ but WITHOUT ANY WARRANTY of any kind.
 
 #pragma once
 #include "alba_logger.h"
+#include "buffer_pool.h"
 #include "stuff.h"
 #include <boost/optional.hpp>
 #include <istream>
@@ -26,6 +27,7 @@ but WITHOUT ANY WARRANTY of any kind.
 #include <sstream>
 #include <string.h>
 #include <string>
+#include <sys/uio.h>
 #include <vector>
 
 namespace alba {
@@ -78,6 +80,11 @@ public:
     return r;
   }
 
+  // a buffer of the given size, to be filled via data(0)
+  static std::shared_ptr<message_buffer> with_size(size_t size) {
+    return std::shared_ptr<message_buffer>(new message_buffer(size));
+  }
+
   static std::shared_ptr<message_buffer> from_istream(std::istream &is) {
     uint32_t size;
     is.read((char *)&size, 4);
@@ -100,14 +107,16 @@ public:
 
   size_t size() { return _size; }
 
-  ~message_buffer() { delete[] _data; }
+  ~message_buffer() { buffer_pool::release(_data, _capacity); }
 
 private:
   char *_data;
   size_t _size;
   size_t _start;
+  size_t _capacity;
   message_buffer(size_t size) {
-    _data = new char[size];
+    _data = buffer_pool::allocate(size);
+    _capacity = buffer_pool::capacity_for(size);
     _size = size;
     _start = 0;
   }
@@ -174,17 +183,57 @@ std::ostream &operator<<(std::ostream &, const message &);
 
 class message_builder {
 public:
-  message_builder() : _size(_SIZE0), _buffer{new char[_SIZE0]}, _pos(4) {
+  message_builder(size_t size_hint = _SIZE0)
+      : _size(buffer_pool::capacity_for(size_hint)),
+        _buffer{buffer_pool::allocate(size_hint)}, _pos(4) {
     // keep valgrind happy:
     uint32_t *p = (uint32_t *)_buffer;
     p[0] = 0;
   }
 
+  message_builder(const message_builder &) = delete;
+  message_builder &operator=(const message_builder &) = delete;
+
+  // make sure there's room for at least size more bytes
+  void reserve(size_t size) noexcept {
+    if (_size - _pos < size) {
+      _grow(_pos + size);
+    }
+  }
+
   template <typename W> void output_using(W &&writer) {
-    uint32_t size = _pos - 4;
+    uint32_t size = _pos - 4 + _external_size;
     uint32_t *p = (uint32_t *)_buffer;
     p[0] = size;
-    writer(_buffer, _pos);
+    if (_externals.empty()) {
+      writer(_buffer, _pos);
+    } else {
+      std::string flat = _flatten();
+      writer(flat.data(), flat.size());
+    }
+  }
+
+  /* like output_using, but the writer gets (const struct iovec *, int)
+     and external pieces are passed by reference instead of copied */
+  template <typename W> void output_iov_using(W &&writer) {
+    uint32_t size = _pos - 4 + _external_size;
+    uint32_t *p = (uint32_t *)_buffer;
+    p[0] = size;
+    if (_externals.empty()) {
+      struct iovec one{_buffer, _pos};
+      writer(&one, 1);
+      return;
+    }
+    std::vector<struct iovec> iov;
+    iov.reserve(2 * _externals.size() + 1);
+    uint32_t from = 0;
+    for (auto &e : _externals) {
+      iov.push_back({&_buffer[from], e.pos - from});
+      iov.push_back({const_cast<char *>(e.data), e.len});
+      from = e.pos;
+    }
+    iov.push_back({&_buffer[from], _pos - from});
+    writer(iov.data(), (int)iov.size());
   }
 
   void output(std::ostream &os) {
@@ -200,39 +249,90 @@ public:
   void add_raw(const char *b, uint32_t len) noexcept {
     uint free = _size - _pos;
     if (free < len) {
-      uint new_size = _size + std::max(len, _size);
-      ALBA_LOG(DEBUG, free << " < " << len << " => grow from " << _size
-                           << " to " << new_size);
-      char *new_buffer = new char[new_size];
-      memcpy(new_buffer, _buffer, _pos);
-      _size = new_size;
-      delete[] _buffer;
-      _buffer = new_buffer;
+      _grow(_size + std::max(len, _size));
     }
     memcpy(&_buffer[_pos], b, len);
     _pos += len;
   }
 
+  /* adds len bytes from b without copying them (unless it's small):
+     b needs to stay alive until the builder is output or reset */
+  void add_external(const char *b, uint32_t len) noexcept {
+    if (len < _EXTERNAL_MIN) {
+      add_raw(b, len);
+    } else {
+      _externals.push_back(external{_pos, b, len});
+      _external_size += len;
+    }
+  }
+
   void add_type(const uint8_t i) noexcept {
     const char *ip = (const char *)(&i);
     add_raw(ip, 1);
   }
 
-  std::string as_string() noexcept { return std::string(_buffer, _pos); }
+  std::string as_string() noexcept {
+    if (_externals.empty()) {
+      return std::string(_buffer, _pos);
+    } else {
+      return _flatten();
+    }
+  }
 
   std::string as_string_no_size() noexcept {
-    return std::string(&_buffer[4], _pos - 4);
+    if (_externals.empty()) {
+      return std::string(&_buffer[4], _pos - 4);
+    } else {
+      return _flatten().substr(4);
+    }
   }
 
-  void reset() noexcept { _pos = 4; }
+  void reset() noexcept {
+    _pos = 4;
+    _externals.clear();
+    _external_size = 0;
+  }
 
-  ~message_builder() { delete[] _buffer; }
+  ~message_builder() { buffer_pool::release(_buffer, _size); }
 
 private:
   uint32_t _size;
   char *_buffer;
   uint32_t _pos = 0;
   static const uint32_t _SIZE0 = 32;
+
+  void _grow(size_t wanted) noexcept {
+    size_t new_size = buffer_pool::capacity_for(wanted);
+    ALBA_LOG(DEBUG, "grow from " << _size << " to " << new_size);
+    char *new_buffer = buffer_pool::allocate(wanted);
+    memcpy(new_buffer, _buffer, _pos);
+    buffer_pool::release(_buffer, _size);
+    _size = new_size;
+    _buffer = new_buffer;
+  }
+
+  struct external {
+    uint32_t pos; // in _buffer, where this piece goes
+    const char *data;
+    uint32_t len;
+  };
+  std::vector<external> _externals;
+  uint32_t _external_size = 0;
+  // below this, a copy is cheaper than an extra iovec
+  static const uint32_t _EXTERNAL_MIN = 4096;
+
+  std::string _flatten() const {
+    std::string r;
+    r.reserve(_pos + _external_size);
+    uint32_t from = 0;
+    for (auto &e : _externals) {
+      r.append(&_buffer[from], e.pos - from);
+      r.append(e.data, e.len);
+      from = e.pos;
+    }
+    r.append(&_buffer[from], _pos - from);
+    return r;
+  }
 };
 
 template <typename T> void to(message_builder &mb, const T &) noexcept;
@@ -23,6 +23,7 @@ but WITHOUT ANY WARRANTY of any kind.
 #include "encryption.h"
 
 #include <boost/optional.hpp>
+#include <boost/utility/string_ref.hpp>
 #include <iostream>
 #include <map>
 #include <memory>
@@ -74,9 +75,11 @@ typedef std::pair<boost::optional<osd_t>, uint32_t> fragment_location_t;
 
 template <class T> using layout = std::vector<std::vector<T>>;
 
+/* object_id and ctr point into the CompactManifest the Location was
+   resolved from, which has to stay around as long as the Location does */
 struct Location {
   namespace_t namespace_id;
-  std::string object_id;
+  boost::string_ref object_id;
   uint32_t chunk_id;
   uint32_t fragment_id;
   uint32_t offset;
@@ -84,8 +87,9 @@ struct Location {
   fragment_location_t fragment_location;
 
   bool uses_compression;
-  std::shared_ptr<EncryptInfo> encrypt_info;
-  boost::optional<std::string> ctr;
+  // the manifest's (interned) descriptor, see encryption::intern
+  const EncryptInfo *encrypt_info;
+  boost::optional<boost::string_ref> ctr;
 };
 
 struct Fragment {
@@ -22,21 +22,65 @@ but WITHOUT ANY WARRANTY of any kind.
 #include "osd_info.h"
 #include "proxy_client.h"
 #include <condition_variable>
+#include <functional>
 #include <map>
 #include <memory>
 #include <mutex>
 #include <vector>
 
 namespace alba {
+namespace executor {
+class Executor;
+}
 namespace proxy_client {
 
+// (the key isn't owned, whoever builds the slices keeps it around)
 struct asd_slice {
-  std::string key;
+  const std::string *key;
   uint32_t offset;
   uint32_t len;
   byte *target;
 };
 
+/* what needs to go to one asd to fill a set of asd_slices.
+   slices on the same fragment are sorted and merged when they overlap,
+   or when the gap between them is at most gap_tolerance bytes.
+   A merged read that serves more than one slice lands in scratch, and
+   scatter() copies the pieces to their targets afterwards.
+   (requests point into scratch, so a plan should stay put once built)
+*/
+struct asd_read_plan {
+  asd_read_plan() = default;
+  asd_read_plan(const asd_read_plan &) = delete;
+  asd_read_plan &operator=(const asd_read_plan &) = delete;
+
+  void build(const std::vector<asd_slice> &, uint32_t gap_tolerance);
+  void scatter() const;
+
+  struct copy {
+    size_t scratch_offset;
+    byte *target;
+    uint32_t len;
+  };
+
+  std::vector<asd_client::partial_get_request> requests;
+  std::vector<byte> scratch;
+  std::vector<copy> copies;
+
+private:
+  // _ranges[i] covers _sorted[first .. last[
+  struct range {
+    uint64_t offset;
+    uint64_t end;
+    size_t first;
+    size_t last;
+  };
+  // (members, so a plan that's built again doesn't allocate)
+  std::vector<const asd_slice *> _sorted;
+  std::vector<range> _ranges;
+  std::vector<std::vector<asd_protocol::slice>> _spare;
+};
+
 struct osd_access_exception : std::exception {
   osd_access_exception(uint32_t return_code, std::string what)
       : _return_code(return_code), _what(what) {}
@@ -49,10 +93,68 @@ struct osd_access_exception : std::exception {
 
 using namespace proxy_protocol;
 
+/* a read from a set of osds that races the proxy (see
+   OsdAccess::start_hedged_read). Every osd is read by a thread of the
+   executor, straight into the targets, and an osd's deadline starts when
+   its read does. When an osd misses it, the slices of the osds that
+   aren't done yet are read via the proxy while those reads go on, and
+   whichever is done first fills the targets. A late read that's still
+   going moves what's left of it into a buffer of its own the next time it
+   gets to the targets, so once it lost it doesn't touch them anymore, and
+   how long it took still counts for its asd's latency.
+*/
+class hedged_read {
+public:
+  // the result for an osd that the proxy was faster than
+  static const int LATE = -3;
+
+  hedged_read(const hedged_read &) = delete;
+  hedged_read &operator=(const hedged_read &) = delete;
+
+  /* waits until all osds are done, or until one of them misses its
+     deadline. Then hedge is called with the osds that aren't done, and
+     returns the read of their slices via the proxy (true if it worked).
+     That read runs on a thread of the executor while the osds go on (on
+     this one when none is free), and may still be running once finish
+     returned, so it only uses what it owns. finish returns when the late
+     osds are done or the proxy is, whichever is first: those that aren't
+     done then are LATE. When the proxy fails, they're waited for after
+     all. rcs gets the result for every osd (as in
+     OsdAccess::read_osds_slices, or LATE). returns -1 if an osd failed,
+     LATE if the proxy was faster for one and none failed, -2 if one was
+     disqualified (and none failed or was late), 0 if all went well. */
+  int finish(std::map<osd_t, int> &rcs,
+             const std::function<std::function<bool()>(
+                 const std::vector<osd_t> &)> &hedge);
+
+  // (the reads that aren't done by now are left to finish on their own,
+  // without touching the targets)
+  ~hedged_read();
+
+private:
+  friend class OsdAccess;
+  hedged_read() = default;
+
+  struct osd_read;
+  struct state;
+
+  std::shared_ptr<state> _state;
+};
+
 class OsdAccess {
 public:
-  static OsdAccess &getInstance(int connection_pool_size,
-                                std::chrono::steady_clock::duration timeout);
+  /* timeout is where an asd's read timeout starts, it then follows the
+     asd's latency between timeout_floor and timeout_ceiling (see
+     latency_tracker). Without those it stays where it is. */
+  static OsdAccess &
+  getInstance(int connection_pool_size,
+              std::chrono::steady_clock::duration timeout,
+              int max_parallel_osd_reads = 1, uint32_t read_gap_tolerance = 0,
+              int pipeline_depth = 1,
+              std::chrono::steady_clock::duration timeout_floor =
+                  std::chrono::steady_clock::duration::zero(),
+              std::chrono::steady_clock::duration timeout_ceiling =
+                  std::chrono::steady_clock::duration::zero());
 
   OsdAccess(OsdAccess const &) = delete;
   void operator=(OsdAccess const &) = delete;
@@ -62,16 +164,58 @@ public:
 
   int read_osds_slices(std::map<osd_t, std::vector<asd_slice>> &);
 
+  /* the same, but a failing osd doesn't stop the reads from the others:
+     rcs gets the result for every osd with slices (0, or as the return
+     value) and other entries are left alone.
+     returns -1 if an osd failed, -2 if an osd was disqualified (or isn't
+     an asd) and none failed, 0 if all went well. */
+  int read_osds_slices(std::map<osd_t, std::vector<asd_slice>> &,
+                       std::map<osd_t, int> &rcs);
+
+  /* starts reading per_osd in the background, for a read that hedges
+     with the proxy once an osd is slower than the given percentile
+     (0 < q <= 1) of its asd's latency. per_osd (and the keys and targets
+     of its slices) should stay put until finish returned. nullptr if
+     there are no threads to read on (max_parallel_osd_reads is 1). */
+  std::unique_ptr<hedged_read>
+  start_hedged_read(const std::map<osd_t, std::vector<asd_slice>> &,
+                    double percentile);
+
+  // runs f(0) .. f(n-1) on the threads that read the osds (the caller
+  // included), for cpu work that comes with a read (see
+  // executor::parallel_for)
+  int parallel_for(size_t n, const std::function<int(size_t)> &f);
+
   std::vector<alba_id_t> get_alba_levels(Proxy_client &client);
+  // the same, into a vector that's reused
+  void get_alba_levels(Proxy_client &client, std::vector<alba_id_t> &result);
+
+  osd_maps_t get_osd_maps();
+
+  // the asds' latencies and read timeouts, per long id
+  std::map<std::string, asd::latency_estimate> latency_estimates();
+
+  // installs osd maps that were saved earlier, unless there already are some
+  bool restore(osd_maps_t &&);
 
 private:
   OsdAccess(int connection_pool_size,
-            std::chrono::steady_clock::duration timeout)
-      : _connection_pool_size(connection_pool_size), _timeout(timeout),
-        _filling(false) {}
+            std::chrono::steady_clock::duration timeout,
+            int max_parallel_osd_reads, uint32_t read_gap_tolerance,
+            int pipeline_depth,
+            std::chrono::steady_clock::duration timeout_floor,
+            std::chrono::steady_clock::duration timeout_ceiling);
+  ~OsdAccess();
 
   int _connection_pool_size;
   std::chrono::steady_clock::duration _timeout;
+  std::chrono::steady_clock::duration _timeout_floor;
+  std::chrono::steady_clock::duration _timeout_ceiling;
+
+  int _max_parallel_osd_reads;
+  std::unique_ptr<executor::Executor> _executor;
+  uint32_t _read_gap_tolerance;
+  int _pipeline_depth;
 
   std::mutex _osd_maps_mutex;
   osd_maps_t _osd_maps;
@@ -80,8 +224,11 @@ private:
 
   std::shared_ptr<info_caps> _find_osd(osd_t);
 
+  // (a hedged read only touches the slices while r lets it)
   int _read_osd_slices_asd_direct_path(osd_t osd,
-                                       std::vector<asd_slice> &slices);
+                                       const std::vector<asd_slice> &slices,
+                                       hedged_read::osd_read *r = nullptr);
+  std::chrono::steady_clock::duration _hedge_delay(osd_t, double percentile);
   asd::ConnectionPools asd_connection_pools;
 
   std::atomic<bool> _filling;
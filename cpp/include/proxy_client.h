@@ -42,19 +42,93 @@ struct proxy_exception : std::exception {
   virtual const char *what() const noexcept { return _what.c_str(); }
 };
 
+// eviction policy for the manifest cache:
+// LRU, or 2Q which keeps the hot set when a namespace is scanned once
+enum class cache_policy_t { LRU, TWO_Q };
+
 struct RoraConfig {
   RoraConfig(const size_t size = 10000, const bool null_io = false,
              const int asd_connection_pool_size = 5,
-             const int asd_partial_read_timeout_milliseconds = 25)
+             const int asd_partial_read_timeout_milliseconds = 25,
+             const int max_parallel_osd_reads = 4,
+             const uint32_t asd_read_gap_tolerance = 4096,
+             const int asd_pipeline_depth = 16,
+             const size_t manifest_cache_bytes = 256 << 20,
+             const cache_policy_t manifest_cache_policy = cache_policy_t::LRU,
+             const std::string &snapshot_path = "",
+             const int snapshot_interval_seconds = 60,
+             const size_t snapshot_max_manifests = 10000,
+             const int asd_partial_read_timeout_floor_milliseconds = 5,
+             const int asd_partial_read_timeout_ceiling_milliseconds = 1000,
+             const double asd_hedge_percentile = 0,
+             const bool asd_rebuild_fragments = true,
+             const size_t decompressed_fragment_cache_bytes = 64 << 20,
+             const bool asd_verify_fragments = false)
       : manifest_cache_size(size), use_null_io(null_io),
         asd_connection_pool_size(asd_connection_pool_size),
         asd_partial_read_timeout_milliseconds(
-            asd_partial_read_timeout_milliseconds) {}
-
+            asd_partial_read_timeout_milliseconds),
+        max_parallel_osd_reads(max_parallel_osd_reads),
+        asd_read_gap_tolerance(asd_read_gap_tolerance),
+        asd_pipeline_depth(asd_pipeline_depth),
+        manifest_cache_bytes(manifest_cache_bytes),
+        manifest_cache_policy(manifest_cache_policy),
+        snapshot_path(snapshot_path),
+        snapshot_interval_seconds(snapshot_interval_seconds),
+        snapshot_max_manifests(snapshot_max_manifests),
+        asd_partial_read_timeout_floor_milliseconds(
+            asd_partial_read_timeout_floor_milliseconds),
+        asd_partial_read_timeout_ceiling_milliseconds(
+            asd_partial_read_timeout_ceiling_milliseconds),
+        asd_hedge_percentile(asd_hedge_percentile),
+        asd_rebuild_fragments(asd_rebuild_fragments),
+        decompressed_fragment_cache_bytes(decompressed_fragment_cache_bytes),
+        asd_verify_fragments(asd_verify_fragments) {}
+
+  // number of manifests cached per namespace
   size_t manifest_cache_size;
   bool use_null_io;
   int asd_connection_pool_size;
+  // what a read from an asd gets until its latency is known
   int asd_partial_read_timeout_milliseconds;
+  // number of osds a single read_objects_slices talks to concurrently
+  // (1 means one osd after the other)
+  int max_parallel_osd_reads;
+  // reads on the same fragment that are at most this many bytes apart
+  // are fetched from the asd as one range
+  uint32_t asd_read_gap_tolerance;
+  // number of partial gets on one asd connection that can be
+  // waiting for an answer (1 means request/response)
+  int asd_pipeline_depth;
+  // memory limit for the manifest cache, shared by all namespaces
+  size_t manifest_cache_bytes;
+  cache_policy_t manifest_cache_policy;
+  // if not empty, osd maps and the hottest manifests are saved here
+  // (periodically and when the client goes away) and loaded at startup,
+  // so the fast path can be taken right after a restart
+  std::string snapshot_path;
+  int snapshot_interval_seconds;
+  size_t snapshot_max_manifests;
+  // the read timeout of an asd follows its latency (a multiple of its
+  // p99), within these bounds. Equal bounds make it fixed.
+  int asd_partial_read_timeout_floor_milliseconds;
+  int asd_partial_read_timeout_ceiling_milliseconds;
+  // hedged reads: when an asd is slower than this percentile (e.g. 0.99)
+  // of its latency, its slices are also read via the proxy, and whichever
+  // answers first is used. 0 turns it off.
+  double asd_hedge_percentile;
+  // a fragment that can't be read (it's missing, or its asd failed) is
+  // rebuilt from k others of its chunk, instead of going via
+  // the proxy
+  bool asd_rebuild_fragments;
+  // memory limit for the fragments of compressed objects that are kept
+  // decompressed (shared by all clients), 0 turns it off
+  size_t decompressed_fragment_cache_bytes;
+  // fragments that are read whole from the asds (those of compressed
+  // objects, and reads that happen to be all of a fragment) are checked
+  // against their checksum in the manifest. One that doesn't match is
+  // read via the proxy instead.
+  bool asd_verify_fragments;
 
   // RoraConfig &operator=(const RoraConfig &) = delete;
   // RoraConfig(const RoraConfig&) = delete;
@@ -136,7 +210,8 @@ public:
   /* drop_cache is a hint towards the proxy that this client will (at least for
    * a while) issue no more request to this proxy for this namespace. The proxy
    * uses this hint to prefer evicting items from its caches that belong to
-   * this namespace.  */
+   * this namespace. (The rora client does the same with its manifest cache)
+   */
   virtual void drop_cache(const std::string &namespace_) = 0;
 
   /* retrieve (major,minor,patch, hash) from the remote proxy
@@ -175,6 +250,7 @@ make_proxy_client(const std::string &ip, const std::string &port,
                   const Transport &transport,
                   const boost::optional<RoraConfig> &rora = boost::none);
 
+std::ostream &operator<<(std::ostream &, const cache_policy_t &);
 std::ostream &operator<<(std::ostream &, const RoraConfig &);
 }
 }
@@ -19,6 +19,7 @@ but WITHOUT ANY WARRANTY of any kind.
 #pragma once
 
 #include "checksum.h"
+#include "compact_manifest.h"
 #include "llio.h"
 #include "manifest.h"
 #include "osd_info.h"
@@ -75,6 +76,24 @@ typedef std::tuple<std::string, alba_id_t,
                    std::unique_ptr<ManifestWithNamespaceId>>
     object_info;
 
+// as object_info, but decoded straight into the form the rora cache keeps
+typedef std::tuple<std::string, alba_id_t,
+                   std::shared_ptr<const CompactManifest>>
+    compact_object_info;
+
+// an object_info of which the manifest has not been decoded yet:
+// manifest is a view on the bytes of (manifest, namespace_id),
+// so they can be decoded independently (and in parallel).
+struct encoded_object_info {
+  std::string name;
+  alba_id_t alba_id;
+  llio::message manifest;
+};
+
+// throws llio::deserialisation_exception
+std::shared_ptr<const CompactManifest>
+decode_manifest(const encoded_object_info &);
+
 using std::string;
 using boost::optional;
 using llio::message_builder;
@@ -158,6 +177,24 @@ void read_read_objects_slices2_response(message &m, Status &status,
                                         const std::vector<ObjectSlices> &dest,
                                         std::vector<object_info> &object_infos);
 
+/* streaming decoding of read_objects_slices(2) responses, for transports
+   that can put the slice data straight into the slice buffers:
+   the caller reads the message length and the 8 bytes after it,
+   if the header says the call succeeded, it reads the slice data into
+   the slice buffers and the remaining bytes into a message for
+   read_read_objects_slices2_response_tail. Otherwise the complete message
+   goes to the non-streaming read_read_objects_slices(2)_response.
+*/
+const uint32_t READ_OBJECTS_SLICES_HEADER_SIZE = 8;
+
+// the number of slice bytes that follow the header, or -1 on failure.
+int64_t read_read_objects_slices_response_header(const char *header);
+
+void read_read_objects_slices2_response_tail(
+    message &m, std::vector<object_info> &object_infos);
+void read_read_objects_slices2_response_tail(
+    message &m, std::vector<encoded_object_info> &object_infos);
+
 void write_update_session_request(
     message_builder &mb,
     const std::vector<std::pair<std::string, boost::optional<std::string>>>
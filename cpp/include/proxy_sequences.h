@@ -125,18 +125,26 @@ public:
    * Proxy_client::apply_sequence is called.
    *
    * performance note:
-   *    when this update is serialized, there will be a copy of the data.
+   *    the data is not copied when this update is serialized,
+   *    it goes straight from the supplied buffer to the socket.
    *
    */
   UpdateUploadObject(const std::string &name, const uint8_t *data,
                      const uint32_t size, const alba::Checksum *cs_o)
       : _name(name), _data(data), _size(size), _cs_o(cs_o){};
 
+  /* the same, with the checksum (of algo) of the data computed here,
+   * for the proxy to check what it got against. */
+  UpdateUploadObject(const std::string &name, const uint8_t *data,
+                     const uint32_t size, alba::algo_t algo)
+      : _name(name), _data(data), _size(size),
+        _cs(alba::compute_checksum(algo, data, size)), _cs_o(_cs.get()){};
+
   void to(llio::message_builder &mb) const override {
     mb.add_type(2);
     llio::to(mb, _name);
     llio::to(mb, _size);
-    mb.add_raw((const char *)_data, _size); // copies
+    mb.add_external((const char *)_data, _size);
     if (_cs_o == nullptr) {
       llio::to<boost::optional<const Checksum *>>(mb, boost::none);
     } else {
@@ -147,6 +155,7 @@ public:
   std::string _name;
   const uint8_t *_data;
   const uint32_t _size;
+  std::unique_ptr<alba::Checksum> _cs;
   const alba::Checksum *_cs_o;
 };
 
@@ -210,6 +219,14 @@ public:
         std::make_shared<UpdateUploadObject>(name, data, size, cs_o));
     return *this;
   }
+
+  Sequence &add_upload(const std::string &name, const uint8_t *data,
+                       const uint32_t size, alba::algo_t algo) {
+    _updates.push_back(
+        std::make_shared<UpdateUploadObject>(name, data, size, algo));
+    return *this;
+  }
+
   Sequence &add_delete(const std::string &name) {
     _updates.push_back(std::shared_ptr<Update>(new UpdateDeleteObject(name)));
     return *this;
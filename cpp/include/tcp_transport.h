@@ -18,9 +18,27 @@ but WITHOUT ANY WARRANTY of any kind.
 
 #pragma once
 #include "transport.h"
+#include <type_traits>
 
 namespace alba {
 namespace transport {
+
+/* room for the (one) asynchronous operation in flight, so asio doesn't
+   allocate one every time (see asio's allocation example) */
+class handler_memory {
+public:
+  handler_memory() = default;
+  handler_memory(const handler_memory &) = delete;
+  handler_memory &operator=(const handler_memory &) = delete;
+
+  void *allocate(std::size_t size);
+  void deallocate(void *p);
+
+private:
+  typename std::aligned_storage<1024>::type _storage;
+  bool _in_use = false;
+};
+
 class TCP_transport : public Transport {
 
 public:
@@ -30,6 +48,11 @@ public:
   void write_exact(const char *buf, int len) override;
   void read_exact(char *buf, int len) override;
 
+  // gather/scatter: one sendmsg/recvmsg for all buffers (if the socket
+  // keeps up)
+  void write_iov(const struct iovec *iov, int iovcnt) override;
+  void read_iov(const struct iovec *iov, int iovcnt) override;
+
   void
   expires_from_now(const std::chrono::steady_clock::duration &timeout) override;
 
@@ -43,6 +66,15 @@ private:
   llio::message input();
   boost::posix_time::milliseconds _timeout;
   void _check_deadline();
+
+  // (kept from one write_iov/read_iov to the next)
+  std::vector<boost::asio::const_buffer> _write_buffers;
+  std::vector<boost::asio::mutable_buffer> _read_buffers;
+  handler_memory _write_memory;
+  handler_memory _read_memory;
+
+  template <typename Buffers> void _write(const Buffers &, std::size_t len);
+  template <typename Buffers> void _read(const Buffers &, std::size_t len);
 };
 }
 }
@@ -22,6 +22,7 @@ but WITHOUT ANY WARRANTY of any kind.
 #include "llio.h"
 
 #include <chrono>
+#include <sys/uio.h>
 
 #include <boost/asio.hpp>
 
@@ -48,6 +49,11 @@ public:
   virtual void write_exact(const char *buf, int len) = 0;
   virtual void read_exact(char *buf, int len) = 0;
 
+  /* vectored versions of the above. The defaults do one
+     write_exact/read_exact per buffer */
+  virtual void write_iov(const struct iovec *iov, int iovcnt);
+  virtual void read_iov(const struct iovec *iov, int iovcnt);
+
   virtual ~Transport(){};
 
   llio::message read_message();
@@ -27,14 +27,21 @@ but WITHOUT ANY WARRANTY of any kind.
 #include <chrono>
 #include <ctime>
 #include <fstream>
+#include <gcrypt.h>
 #include <iomanip>
+#include <limits>
 #include <mutex>
 #include <thread>
 
 #include "alba_logger.h"
+#include "asd_client.h"
+#include "checksum.h"
+#include "encryption.h"
+#include "location_resolver.h"
 #include "proxy_client.h"
 #include "statistics.h"
 #include "stuff.h"
+#include "transport_helper.h"
 
 using std::string;
 using std::cout;
@@ -253,6 +260,229 @@ void partial_read_benchmark(const string &host, const string &port,
   }
 }
 
+void asd_pipeline_benchmark(const string &host, const string &port,
+                            const std::chrono::steady_clock::duration &timeout,
+                            const alba::transport::Kind &transport,
+                            const string &key, const uint32_t value_size,
+                            const int n, const uint32_t block_size) {
+  using namespace alba::asd_client;
+  ALBA_LOG(WARNING, "asd_pipeline_benchmark(" << host << ", " << port << ", "
+                                              << transport << ", " << key
+                                              << ")");
+  auto asd = std::unique_ptr<Asd_client>(new Asd_client(
+      timeout, alba::transport::make_transport(transport, host, port, timeout),
+      boost::none));
+
+  // the number of whole blocks in the value
+  uint64_t range = value_size / block_size;
+  std::vector<alba::byte> buffer(block_size * n);
+  std::vector<partial_get_request> requests;
+  for (int i = 0; i < n; i++) {
+    uint64_t block_index = std::rand() % range;
+    slice s;
+    s.offset = block_index * block_size;
+    s.length = block_size;
+    s.target = &buffer[i * block_size];
+    requests.push_back(partial_get_request{&key, {s}});
+  }
+
+  auto report = [&](const string &what, high_resolution_clock::time_point t0) {
+    auto t1 = high_resolution_clock::now();
+    double dur = duration_cast<duration<double>>(t1 - t0).count();
+    cout << std::setw(12) << what << ": " << n << " partial gets in " << dur
+         << "s (" << (n / dur) << " /s)" << endl;
+  };
+
+  auto t0 = high_resolution_clock::now();
+  string key_ = key;
+  for (auto &request : requests) {
+    asd->partial_get(key_, request.slices);
+  }
+  report("sequential", t0);
+
+  for (size_t depth : {1, 4, 16}) {
+    t0 = high_resolution_clock::now();
+    asd->partial_gets(requests, depth);
+    report("depth=" + std::to_string(depth), t0);
+  }
+}
+
+// the chunk lookup as it was: a scan from the start
+alba::proxy_protocol::Location
+_linear_get_location(const alba::proxy_protocol::CompactManifest &mf,
+                     uint64_t pos, uint32_t len) {
+  int chunk_index = -1;
+  uint64_t total = 0;
+  while (total <= pos) {
+    chunk_index++;
+    total += mf.chunk_size(chunk_index);
+  }
+  uint32_t chunk_size = mf.chunk_size(chunk_index);
+  total -= chunk_size;
+  uint32_t fragment_length = chunk_size / mf.encoding_scheme().k;
+  uint32_t fragment_index = (pos - total) / fragment_length;
+  total += fragment_length * fragment_index;
+  alba::proxy_protocol::Location l;
+  l.chunk_id = chunk_index;
+  l.fragment_id = fragment_index;
+  l.offset = pos - total;
+  l.length = std::min(len, fragment_length - l.offset);
+  return l;
+}
+
+void location_resolver_benchmark(const int n, const uint32_t block_size) {
+  using namespace alba::proxy_protocol;
+  const uint32_t chunk_size = 1 << 20;
+  std::vector<alba::byte> buf(block_size);
+  for (uint32_t n_chunks : {1, 100, 10000}) {
+    // k=2 m=1 chunks, fragment f on osd f
+    CompactManifest::builder b;
+    b.name = "chunked";
+    b.object_id = "chunked_id";
+    b.encoding_scheme = EncodingScheme{2, 1, 8};
+    b.encrypt_info = std::make_shared<alba::encryption::NoEncryption>();
+    const uint64_t object_size = (uint64_t)n_chunks * chunk_size;
+    b.size = object_size;
+    string crc(4, '\0');
+    for (uint32_t c = 0; c < n_chunks; c++) {
+      b.chunk_sizes.push_back(chunk_size);
+      b.add_chunk(3);
+      for (uint32_t f = 0; f < 3; f++) {
+        b.add_fragment(alba::osd_t{f}, 0, alba::algo_t::CRC32c, crc.data(),
+                       crc.size(), chunk_size / 2);
+      }
+    }
+    CompactManifest mf(std::move(b));
+
+    // reads spread over the object, all to the same memory
+    std::vector<SliceDescriptor> slices;
+    for (int i = 0; i < n; i++) {
+      uint64_t offset = (object_size - block_size) / n * i;
+      slices.push_back(SliceDescriptor{&buf[0], offset, block_size});
+    }
+    std::vector<std::pair<alba::byte *, Location>> results;
+    auto t0 = high_resolution_clock::now();
+    resolve_slices(mf, slices, results);
+    auto t1 = high_resolution_clock::now();
+    size_t n_linear = 0;
+    for (auto &slice : slices) {
+      uint64_t pos = slice.offset;
+      uint32_t len = slice.size;
+      while (len > 0) {
+        auto l = _linear_get_location(mf, pos, len);
+        pos += l.length;
+        len -= l.length;
+        n_linear++;
+      }
+    }
+    auto t2 = high_resolution_clock::now();
+    cout << std::setw(6) << n_chunks << " chunks, " << n << " slices: "
+         << "resolve_slices " << duration_cast<microseconds>(t1 - t0).count()
+         << "us (" << results.size() << " locations), linear scan "
+         << duration_cast<microseconds>(t2 - t1).count() << "us ("
+         << n_linear << " locations)" << endl;
+  }
+}
+
+void partial_decrypt_benchmark(const int n, const uint32_t block_size) {
+  using namespace alba::encryption;
+  Encrypted e;
+  e.algo = algo_t::AES;
+  e.mode = chaining_mode_t::CTR;
+  e.key_length = key_length_t::L256;
+  string key(32, 'k');
+  string ctr(16, '\xff');
+  ctr[0] = 0;
+  const size_t size = (size_t)n * block_size;
+
+  std::vector<alba::byte> plain(size);
+  for (size_t i = 0; i < size; i++) {
+    plain[i] = i * 7 + (i >> 12);
+  }
+  std::vector<alba::byte> encrypted = plain;
+  gcry_cipher_hd_t hd;
+  gcry_cipher_open(&hd, GCRY_CIPHER_AES256, GCRY_CIPHER_MODE_CTR, 0);
+  gcry_cipher_setkey(hd, key.data(), key.size());
+  gcry_cipher_setctr(hd, ctr.data(), ctr.size());
+  gcry_cipher_encrypt(hd, encrypted.data(), size, nullptr, 0);
+  gcry_cipher_close(hd);
+
+  // all of it, in slices that don't start on a block (except the first)
+  std::vector<alba::byte> buf = encrypted;
+  std::vector<Encrypted::slice> slices;
+  for (int i = 0; i < n; i++) {
+    uint32_t offset = i == 0 ? 0 : i * block_size - 3;
+    uint32_t end = i + 1 == n ? size : (i + 1) * block_size - 3;
+    slices.push_back(Encrypted::slice{
+        &buf[offset], end - offset, (const unsigned char *)ctr.data(), offset});
+  }
+
+  auto report = [&](const string &what, high_resolution_clock::time_point t0) {
+    auto t1 = high_resolution_clock::now();
+    double dur = duration_cast<duration<double>>(t1 - t0).count();
+    cout << std::setw(18) << what << ": " << (size / dur / (1 << 20))
+         << " MB/s" << (plain == buf ? "" : " (WRONG)") << endl;
+  };
+
+  // a cipher set up for every slice, as it used to be
+  auto t0 = high_resolution_clock::now();
+  for (auto &sl : slices) {
+    // the counter of the block sl starts in (big endian, 128 bits)
+    unsigned char block_ctr[16];
+    memcpy(block_ctr, ctr.data(), 16);
+    uint64_t carry = sl.offset / 16;
+    for (int i = 15; i >= 0 && carry > 0; i--) {
+      carry += block_ctr[i];
+      block_ctr[i] = (unsigned char)carry;
+      carry >>= 8;
+    }
+    unsigned char burn[16];
+    gcry_cipher_open(&hd, GCRY_CIPHER_AES256, GCRY_CIPHER_MODE_CTR, 0);
+    gcry_cipher_setkey(hd, key.data(), key.size());
+    gcry_cipher_setctr(hd, block_ctr, sizeof(block_ctr));
+    if (sl.offset % 16 != 0) {
+      gcry_cipher_decrypt(hd, burn, sl.offset % 16, nullptr, 0);
+    }
+    gcry_cipher_decrypt(hd, sl.buf, sl.len, nullptr, 0);
+    gcry_cipher_close(hd);
+  }
+  report("a cipher per slice", t0);
+
+  buf = encrypted;
+  t0 = high_resolution_clock::now();
+  for (auto &sl : slices) {
+    string c = ctr;
+    e.partial_decrypt(sl.buf, sl.len, key, c, sl.offset);
+  }
+  report("one by one", t0);
+
+  buf = encrypted;
+  t0 = high_resolution_clock::now();
+  e.partial_decrypt(key, slices.data(), slices.size());
+  report("in one pass", t0);
+}
+
+void checksum_benchmark(const size_t size) {
+  std::vector<uint8_t> data(size);
+  for (size_t i = 0; i < size; i++) {
+    data[i] = i * 7 + (i >> 12);
+  }
+  auto report = [&](const string &what, high_resolution_clock::time_point t0) {
+    auto t1 = high_resolution_clock::now();
+    double dur = duration_cast<duration<double>>(t1 - t0).count();
+    cout << std::setw(7) << what << ": " << (size / dur / (1 << 20))
+         << " MB/s" << endl;
+  };
+  auto t0 = high_resolution_clock::now();
+  uint32_t crc = alba::crc32c(0, data.data(), size);
+  report("crc32c", t0);
+  t0 = high_resolution_clock::now();
+  auto digest = alba::sha1(data.data(), size);
+  report("sha1", t0);
+  cout << "crc32c " << std::hex << crc << std::dec << ", sha1 "
+       << digest.size() << " bytes" << endl;
+}
+
 int main(int argc, const char *argv[]) {
   init_log();
   alba::initialize_libgcrypt();
@@ -272,8 +502,9 @@ int main(int argc, const char *argv[]) {
       " upload-object, delete-object, list-objects, "
       " show-object, delete-namespace, create-namespace, "
       " list-namespaces, invalidata-cache, proxy-get-version"
-      " proxy-osd_info2"
-      " partial-read-benchmark")("port",
+      " proxy-osd_info2, asd-pipeline-benchmark"
+      " partial-read-benchmark, location-resolver-benchmark"
+      " partial-decrypt-benchmark, checksum-benchmark")("port",
                                  po::value<string>()->default_value("10000"),
                                  "the alba proxy port number")(
       "host", po::value<string>()->default_value("127.0.0.1"),
@@ -313,7 +544,9 @@ int main(int argc, const char *argv[]) {
           "if set, all rora partial reads come from the "
           "same object, and hit the same ASD")(
           "asd-pool-size", po::value<uint32_t>()->default_value(5),
-          "config for partial read benchmark");
+          "config for partial read benchmark")(
+          "max-parallel-osd-reads", po::value<uint32_t>()->default_value(4),
+          "number of osds read from concurrently in partial read benchmark");
 
   po::positional_options_description positionalOptions;
   positionalOptions.add("command", 1);
@@ -486,8 +719,10 @@ int main(int argc, const char *argv[]) {
     uint32_t n_clients = getRequiredArg<uint32_t>(vm, "n-clients");
     bool use_rora = getRequiredArg<bool>(vm, "use-rora");
     uint32_t asd_pool_size = getRequiredArg<uint32_t>(vm, "asd-pool-size");
+    uint32_t max_parallel_osd_reads =
+        getRequiredArg<uint32_t>(vm, "max-parallel-osd-reads");
     boost::optional<RoraConfig> rora_config =
-        RoraConfig(10000, false, asd_pool_size);
+        RoraConfig(10000, false, asd_pool_size, 25, max_parallel_osd_reads);
     ALBA_LOG(INFO, "config = " << *rora_config);
     uint32_t block_size = getRequiredArg<uint32_t>(vm, "block-size");
     bool focus = getRequiredArg<bool>(vm, "focus");
@@ -508,6 +743,46 @@ int main(int argc, const char *argv[]) {
     partial_read_benchmark(host, port, timeout, transport, ns, file, n,
                            n_clients, rora_config, focus, block_size,
                            io_pattern, invalidate_cache);
+  } else if ("asd-pipeline-benchmark" == command) {
+    // --host and --port point to the asd, --name is a key on it
+    // and --length the size of its value
+    string key = getRequiredStringArg(vm, "name");
+    uint32_t value_size = getRequiredArg<uint32_t>(vm, "length");
+    uint32_t n = getRequiredArg<uint32_t>(vm, "benchmark-size");
+    uint32_t block_size = getRequiredArg<uint32_t>(vm, "block-size");
+    if (block_size == 0 || value_size < block_size) {
+      cout << "--length should hold at least one --block-size (> 0)" << endl;
+      return 1;
+    }
+    asd_pipeline_benchmark(host, port, timeout, transport, key, value_size, n,
+                           block_size);
+  } else if ("location-resolver-benchmark" == command) {
+    // --benchmark-size slices of --block-size, over objects with ever more
+    // (1MB) chunks
+    uint32_t n = getRequiredArg<uint32_t>(vm, "benchmark-size");
+    uint32_t block_size = getRequiredArg<uint32_t>(vm, "block-size");
+    if (n == 0 || block_size == 0 || block_size > (1 << 20)) {
+      cout << "--benchmark-size should be > 0, and --block-size in ]0, 1MB]"
+           << endl;
+      return 1;
+    }
+    location_resolver_benchmark(n, block_size);
+  } else if ("partial-decrypt-benchmark" == command) {
+    // AES256 CTR decryption of --benchmark-size slices of --block-size
+    uint32_t n = getRequiredArg<uint32_t>(vm, "benchmark-size");
+    uint32_t block_size = getRequiredArg<uint32_t>(vm, "block-size");
+    if (n == 0 || block_size < 16 ||
+        (uint64_t)n * block_size > std::numeric_limits<uint32_t>::max()) {
+      cout << "--benchmark-size should be > 0, --block-size >= 16, and "
+           << "together less than 4GB" << endl;
+      return 1;
+    }
+    partial_decrypt_benchmark(n, block_size);
+  } else if ("checksum-benchmark" == command) {
+    // crc32c and sha1 over --benchmark-size blocks of --block-size
+    uint32_t n = getRequiredArg<uint32_t>(vm, "benchmark-size");
+    uint32_t block_size = getRequiredArg<uint32_t>(vm, "block-size");
+    checksum_benchmark((size_t)n * block_size);
   } else {
     cout << "got invalid command name. valid options are: "
          << "download-object, upload-object, delete-object, list-objects "
@@ -30,10 +30,14 @@ using alba::proxy_protocol::OsdInfo;
 
 #define LOCK() std::lock_guard<std::mutex> lock(_mutex)
 
-ConnectionPool::ConnectionPool(std::unique_ptr<OsdInfo> config, size_t capacity,
-                               std::chrono::steady_clock::duration timeout)
+ConnectionPool::ConnectionPool(
+    std::unique_ptr<OsdInfo> config, size_t capacity,
+    std::chrono::steady_clock::duration timeout,
+    std::chrono::steady_clock::duration timeout_floor,
+    std::chrono::steady_clock::duration timeout_ceiling)
     : config_(std::move(config)), capacity_(capacity), timeout_(timeout),
-      _fast_path_failures(0) {
+      _fast_path_failures(0),
+      _latency(timeout, timeout_floor, timeout_ceiling) {
   ALBA_LOG(INFO, "Created pool for asd client " << *config_ << ", capacity "
                                                 << capacity);
 }
@@ -72,10 +76,44 @@ std::unique_ptr<Asd_client> ConnectionPool::make_one_() const {
 }
 
 void ConnectionPool::report_failure() {
+  LOCK();
+  report_failure_();
+}
+
+void ConnectionPool::report_failure_() {
   _failure_time = std::chrono::steady_clock::now();
   _fast_path_failures++;
 }
 
+void ConnectionPool::report_latency(std::chrono::steady_clock::duration d) {
+  LOCK();
+  _latency.add(d);
+}
+
+void ConnectionPool::report_latencies(
+    const std::vector<std::chrono::steady_clock::duration> &ds, size_t n) {
+  LOCK();
+  for (size_t i = 0; i < n; i++) {
+    _latency.add(ds[i]);
+  }
+}
+
+std::chrono::steady_clock::duration ConnectionPool::read_timeout() const {
+  LOCK();
+  return _latency.timeout();
+}
+
+std::chrono::steady_clock::duration
+ConnectionPool::latency_percentile(double q) const {
+  LOCK();
+  return _latency.percentile(q);
+}
+
+latency_estimate ConnectionPool::latency() const {
+  LOCK();
+  return _latency.estimate();
+}
+
 void ConnectionPool::release_connection(std::unique_ptr<Asd_client> conn) {
   LOCK();
   if (conn) {
@@ -86,7 +124,7 @@ void ConnectionPool::release_connection(std::unique_ptr<Asd_client> conn) {
       return;
     }
   } else {
-    this->report_failure();
+    report_failure_();
   }
 }
 
@@ -153,7 +191,9 @@ void ConnectionPool::capacity(size_t cap) {
 
 ConnectionPool *ConnectionPools::get_connection_pool(
     const proxy_protocol::OsdInfo &osd_info, int connection_pool_size,
-    std::chrono::steady_clock::duration timeout) {
+    std::chrono::steady_clock::duration timeout,
+    std::chrono::steady_clock::duration timeout_floor,
+    std::chrono::steady_clock::duration timeout_ceiling) {
   if (!osd_info.kind_asd) {
     return nullptr;
   }
@@ -170,10 +210,20 @@ ConnectionPool *ConnectionPools::get_connection_pool(
         osd_info.long_id,
         std::unique_ptr<ConnectionPool>(new ConnectionPool(
             std::unique_ptr<proxy_protocol::OsdInfo>(osd_info_copy),
-            connection_pool_size, timeout)));
+            connection_pool_size, timeout, timeout_floor, timeout_ceiling)));
     it = connection_pools_.find(osd_info.long_id);
   }
   return it->second.get();
 }
+
+std::map<std::string, latency_estimate>
+ConnectionPools::latency_estimates() const {
+  std::map<std::string, latency_estimate> result;
+  LOCK();
+  for (auto &item : connection_pools_) {
+    result[item.first] = item.second->latency();
+  }
+  return result;
+}
 }
 }
@@ -17,6 +17,7 @@ but WITHOUT ANY WARRANTY of any kind.
 */
 
 #include "asd_client.h"
+#include <algorithm>
 #include <thread>
 
 namespace alba {
@@ -80,17 +81,135 @@ void Asd_client::partial_get(string &key, vector<slice> &slices) {
   asd_protocol::write_partial_get_request(_mb, key, slices);
   _transport->output(_mb);
   _mb.reset();
-  message response = _transport->read_message();
+  _read_partial_get_response(slices);
+
+  _transport->expires_from_now(std::chrono::steady_clock::duration::max());
+}
+
+void Asd_client::partial_gets(vector<partial_get_request> &requests,
+                              size_t max_in_flight) {
+  partial_gets(requests, max_in_flight, _timeout);
+}
+
+void Asd_client::partial_gets(
+    vector<partial_get_request> &requests, size_t max_in_flight,
+    const std::chrono::steady_clock::duration &timeout,
+    requests_hook *hook) {
+  _transport->expires_from_now(timeout);
+
+  const size_t n = requests.size();
+  if (max_in_flight == 0) {
+    max_in_flight = n;
+  }
+  _written_at.resize(n);
+  _response_times.clear();
+  auto last_response = std::chrono::steady_clock::time_point::min();
+  size_t written = 0;
+  for (size_t read = 0; read < n; read++) {
+    size_t window_end = std::min(n, read + max_in_flight);
+    if (written < window_end) {
+      if (hook) {
+        hook->using_requests(requests, written);
+      }
+      try {
+        _write_partial_get_requests(requests, written, window_end);
+      } catch (...) {
+        if (hook) {
+          hook->done_with_requests();
+        }
+        throw;
+      }
+      if (hook) {
+        hook->done_with_requests();
+      }
+      auto now = std::chrono::steady_clock::now();
+      for (size_t i = written; i < window_end; i++) {
+        _written_at[i] = now;
+      }
+      written = window_end;
+    }
+    auto since = std::max(_written_at[read], last_response);
+    try {
+      _transport->expires_from_now(timeout);
+      // (waiting for the asd doesn't count as using the requests,
+      // only what comes after the response is there)
+      _read_partial_get_response_header();
+      if (hook) {
+        hook->using_requests(requests, read);
+      }
+      _read_partial_get_data(requests[read].slices);
+      if (hook) {
+        hook->done_with_requests();
+      }
+    } catch (...) {
+      if (hook) {
+        hook->done_with_requests();
+      }
+      _response_times.push_back(std::chrono::steady_clock::now() - since);
+      throw;
+    }
+    last_response = std::chrono::steady_clock::now();
+    _response_times.push_back(last_response - since);
+  }
+
+  _transport->expires_from_now(std::chrono::steady_clock::duration::max());
+}
+
+void Asd_client::_write_partial_get_requests(
+    vector<partial_get_request> &requests, size_t first, size_t last) {
+  if (last - first == 1) {
+    auto &request = requests[first];
+    asd_protocol::write_partial_get_request(_mb, *request.key,
+                                            request.slices);
+    _transport->output(_mb);
+    _mb.reset();
+    return;
+  }
+  _requests.clear();
+  for (size_t i = first; i < last; i++) {
+    auto &request = requests[i];
+    asd_protocol::write_partial_get_request(_mb, *request.key,
+                                            request.slices);
+    _mb.output_using([&](const char *buffer, const int len) -> void {
+      _requests.insert(_requests.end(), buffer, buffer + len);
+    });
+    _mb.reset();
+  }
+  _transport->write_exact(_requests.data(), _requests.size());
+}
+
+void Asd_client::_read_partial_get_response(vector<slice> &slices) {
+  _read_partial_get_response_header();
+  _read_partial_get_data(slices);
+}
+
+void Asd_client::_read_partial_get_response_header() {
+  // the response itself is small (the data comes after it),
+  // it goes into a buffer that's kept from one response to the next
+  uint32_t size;
+  _transport->read_exact((char *)&size, 4);
+  if (!_response || _response->size() < size) {
+    _response = llio::message_buffer::with_size(size);
+  }
+  _transport->read_exact(_response->data(0), size);
+  message response(_response, 0, size);
   bool success;
   asd_protocol::read_partial_get_response(response, _status, success);
 
   check_status(__PRETTY_FUNCTION__);
+  if (!success) {
+    // the asd doesn't have the key, and sends no data
+    throw asd_exception(asd_protocol::return_code::UNKNOWN,
+                        "partial_get: key not found");
+  }
+}
 
+void Asd_client::_read_partial_get_data(vector<slice> &slices) {
+  _iov.clear();
   for (auto &slice : slices) {
-    _transport->read_exact((char *)slice.target, slice.length);
+    _iov.push_back({slice.target, slice.length});
   }
-
-  _transport->expires_from_now(std::chrono::steady_clock::duration::max());
+  _transport->read_iov(_iov.data(), _iov.size());
 }
 
 void Asd_client::set_slowness(asd_protocol::slowness_t &slowness) {
@@ -38,8 +38,8 @@ void make_prologue(message_builder &mb, boost::optional<string> long_id) {
   to(mb, long_id);
 }
 
-void write_partial_get_request(message_builder &mb, string &key,
-                               vector<slice> &slices) {
+void write_partial_get_request(message_builder &mb, const string &key,
+                               const vector<slice> &slices) {
   to<uint32_t>(mb, 11);
   to(mb, key);
   to<uint32_t>(mb, slices.size());
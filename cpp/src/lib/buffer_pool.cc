@@ -0,0 +1,162 @@
+/*
+Copyright (C) 2016 iNuron NV
+
+This file is part of Open vStorage Open Source Edition (OSE), as available from
+
+
+    http://www.openvstorage.org and
+    http://www.openvstorage.com.
+
+This file is free software; you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License v3 (GNU AGPLv3)
+as published by the Free Software Foundation, in version 3 as it comes
+in the <LICENSE.txt> file of the Open vStorage OSE distribution.
+
+Open vStorage is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY of any kind.
+*/
+
+#include "buffer_pool.h"
+
+#include <array>
+#include <mutex>
+#include <vector>
+
+namespace alba {
+namespace llio {
+namespace buffer_pool {
+
+namespace {
+
+const size_t N_CLASSES = 18; // 64B .. 8MiB
+
+// don't hold on to more than this many bytes per class in a free list
+const size_t LOCAL_BYTES_PER_CLASS = 4 << 20;
+const size_t LOCAL_MAX_COUNT = 16;
+const size_t GLOBAL_FACTOR = 4;
+
+size_t _class_of(size_t capacity) {
+  size_t c = 0;
+  size_t s = MIN_CAPACITY;
+  while (s < capacity) {
+    s <<= 1;
+    c++;
+  }
+  return c;
+}
+
+size_t _max_count(size_t capacity) {
+  size_t n = LOCAL_BYTES_PER_CLASS / capacity;
+  if (n < 1) {
+    return 1;
+  }
+  return (n < LOCAL_MAX_COUNT) ? n : LOCAL_MAX_COUNT;
+}
+
+typedef std::array<std::vector<char *>, N_CLASSES> free_lists;
+
+struct global_pool {
+  std::mutex mutex;
+  free_lists lists;
+};
+
+global_pool &_global() {
+  static global_pool *pool = new global_pool; // lives as long as the process
+  return *pool;
+}
+
+// buffers can still be released by destructors of other thread locals
+thread_local bool _local_gone = false;
+
+struct local_pool {
+  free_lists lists;
+
+  // a thread that goes away hands over what it has (where there's room)
+  ~local_pool() {
+    _local_gone = true;
+    auto &global = _global();
+    std::lock_guard<std::mutex> lock(global.mutex);
+    size_t capacity = MIN_CAPACITY;
+    for (size_t c = 0; c < N_CLASSES; c++, capacity <<= 1) {
+      auto &global_list = global.lists[c];
+      for (char *b : lists[c]) {
+        if (global_list.size() < GLOBAL_FACTOR * _max_count(capacity)) {
+          global_list.push_back(b);
+        } else {
+          delete[] b;
+        }
+      }
+    }
+  }
+};
+
+thread_local local_pool _local;
+}
+
+size_t capacity_for(size_t size) {
+  if (size > MAX_CAPACITY) {
+    // not pooled, so no point in rounding up
+    return size;
+  }
+  size_t capacity = MIN_CAPACITY;
+  while (capacity < size) {
+    capacity <<= 1;
+  }
+  return capacity;
+}
+
+char *allocate(size_t size) {
+  if (size > MAX_CAPACITY) {
+    return new char[size];
+  }
+  size_t capacity = capacity_for(size);
+  size_t c = _class_of(capacity);
+  if (!_local_gone) {
+    auto &local = _local.lists[c];
+    if (!local.empty()) {
+      char *b = local.back();
+      local.pop_back();
+      return b;
+    }
+  }
+  {
+    auto &global = _global();
+    std::lock_guard<std::mutex> lock(global.mutex);
+    auto &list = global.lists[c];
+    if (!list.empty()) {
+      char *b = list.back();
+      list.pop_back();
+      return b;
+    }
+  }
+  return new char[capacity];
+}
+
+void release(char *buffer, size_t capacity) {
+  if (capacity > MAX_CAPACITY) {
+    delete[] buffer;
+    return;
+  }
+  size_t c = _class_of(capacity);
+  size_t max_count = _max_count(capacity);
+  if (!_local_gone) {
+    auto &local = _local.lists[c];
+    if (local.size() < max_count) {
+      local.push_back(buffer);
+      return;
+    }
+  }
+  {
+    auto &global = _global();
+    std::lock_guard<std::mutex> lock(global.mutex);
+    auto &list = global.lists[c];
+    if (list.size() < GLOBAL_FACTOR * max_count) {
+      list.push_back(buffer);
+      return;
+    }
+  }
+  delete[] buffer;
+}
+}
+}
+}
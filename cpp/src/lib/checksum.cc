@@ -17,9 +17,95 @@ but WITHOUT ANY WARRANTY of any kind.
 */
 
 #include "checksum.h"
+#include <gcrypt.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#define ALBA_CRC32C_X86 1
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define ALBA_CRC32C_ARM 1
+#endif
 
 namespace alba {
 
+namespace {
+// the reflected Castagnoli polynomial
+const uint32_t _CRC32C_POLY = 0x82f63b78;
+
+struct crc32c_table {
+  uint32_t t[256];
+
+  crc32c_table() {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for (int b = 0; b < 8; b++) {
+        c = (c >> 1) ^ (_CRC32C_POLY & (0 - (c & 1)));
+      }
+      t[i] = c;
+    }
+  }
+};
+
+// (crc is the register, without the inversions)
+uint32_t _crc32c_portable(uint32_t crc, const uint8_t *data, size_t size) {
+  static const crc32c_table table;
+  for (size_t i = 0; i < size; i++) {
+    crc = table.t[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  }
+  return crc;
+}
+
+#ifdef ALBA_CRC32C_X86
+__attribute__((target("sse4.2"))) uint32_t
+_crc32c_sse42(uint32_t crc, const uint8_t *data, size_t size) {
+  uint64_t c = crc;
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    memcpy(&word, data + i, 8);
+    c = _mm_crc32_u64(c, word);
+  }
+  uint32_t c32 = c;
+  for (; i < size; i++) {
+    c32 = _mm_crc32_u8(c32, data[i]);
+  }
+  return c32;
+}
+#endif
+
+#ifdef ALBA_CRC32C_ARM
+uint32_t _crc32c_armv8(uint32_t crc, const uint8_t *data, size_t size) {
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    memcpy(&word, data + i, 8);
+    crc = __crc32cd(crc, word);
+  }
+  for (; i < size; i++) {
+    crc = __crc32cb(crc, data[i]);
+  }
+  return crc;
+}
+#endif
+
+typedef uint32_t (*crc32c_t)(uint32_t, const uint8_t *, size_t);
+
+crc32c_t _pick_crc32c() {
+#ifdef ALBA_CRC32C_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse4.2")) {
+    return _crc32c_sse42;
+  }
+#endif
+#ifdef ALBA_CRC32C_ARM
+  return _crc32c_armv8;
+#endif
+  return _crc32c_portable;
+}
+}
+
 void Sha1::print(std::ostream &os) const {
   os << "Sha1(`";
   for (char c : _digest) {
@@ -64,6 +150,44 @@ bool verify(const Checksum &c0, const Checksum &c1) {
   return false;
 }
 
+uint32_t crc32c(uint32_t crc, const uint8_t *data, size_t size) {
+  static const crc32c_t kernel = _pick_crc32c();
+  return ~kernel(~crc, data, size);
+}
+
+std::string sha1(const uint8_t *data, size_t size) {
+  std::string digest(SHA_SIZE, '\0');
+  gcry_md_hash_buffer(GCRY_MD_SHA1, &digest[0], data, size);
+  return digest;
+}
+
+std::unique_ptr<Checksum> compute_checksum(algo_t algo, const uint8_t *data,
+                                           size_t size) {
+  switch (algo) {
+  case algo_t::NO_CHECKSUM:
+    return std::unique_ptr<Checksum>(new NoChecksum());
+  case algo_t::SHA1: {
+    std::string digest = sha1(data, size);
+    return std::unique_ptr<Checksum>(new Sha1(digest));
+  }
+  case algo_t::CRC32c:
+    return std::unique_ptr<Checksum>(new Crc32c(crc32c(0, data, size)));
+  }
+  return nullptr;
+}
+
+bool verify(const Checksum &c, const uint8_t *data, size_t size) {
+  switch (c.get_algo()) {
+  case algo_t::NO_CHECKSUM:
+    return true;
+  case algo_t::SHA1:
+    return ((const Sha1 &)c)._digest == sha1(data, size);
+  case algo_t::CRC32c:
+    return ((const Crc32c &)c)._digest == crc32c(0, data, size);
+  }
+  return false;
+}
+
 std::ostream &operator<<(std::ostream &os, const algo_t &algo) {
   switch (algo) {
   case algo_t::NO_CHECKSUM:
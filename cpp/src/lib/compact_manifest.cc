@@ -0,0 +1,439 @@
+/*
+Copyright (C) 2016 iNuron NV
+
+This file is part of Open vStorage Open Source Edition (OSE), as available from
+
+
+    http://www.openvstorage.org and
+    http://www.openvstorage.com.
+
+This file is free software; you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License v3 (GNU AGPLv3)
+as published by the Free Software Foundation, in version 3 as it comes
+in the <LICENSE.txt> file of the Open vStorage OSE distribution.
+
+Open vStorage is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY of any kind.
+*/
+
+#include "compact_manifest.h"
+#include <algorithm>
+#include <cstring>
+
+namespace alba {
+namespace proxy_protocol {
+
+namespace {
+const uint8_t _HAS_OSD = 1;
+const uint8_t _HAS_CTR = 2;
+const uint8_t _HAS_FNR = 4;
+
+// pool offset for 'none'
+const uint32_t _NONE = 0xffffffff;
+
+size_t _align8(size_t x) { return (x + 7) & ~(size_t)7; }
+
+std::string _digest(const Checksum *c) {
+  if (c == nullptr) {
+    return std::string();
+  }
+  switch (c->get_algo()) {
+  case algo_t::SHA1:
+    return static_cast<const Sha1 *>(c)->_digest;
+  case algo_t::CRC32c: {
+    uint32_t d = static_cast<const Crc32c *>(c)->_digest;
+    return std::string((const char *)&d, sizeof(d));
+  }
+  case algo_t::NO_CHECKSUM:
+    break;
+  }
+  return std::string();
+}
+
+std::unique_ptr<Checksum> _checksum(uint8_t algo, std::string digest) {
+  switch ((algo_t)algo) {
+  case algo_t::SHA1:
+    return std::unique_ptr<Checksum>(new Sha1(digest));
+  case algo_t::CRC32c: {
+    uint32_t d;
+    memcpy(&d, digest.data(), sizeof(d));
+    return std::unique_ptr<Checksum>(new Crc32c(d));
+  }
+  case algo_t::NO_CHECKSUM:
+    break;
+  }
+  return std::unique_ptr<Checksum>(new NoChecksum());
+}
+
+}
+
+CompactManifest::offsets::offsets(uint32_t n, uint32_t f) {
+  osd = sizeof(header);
+  chunk_offset = osd + 8 * f;
+  chunk_size = chunk_offset + 8 * (n + 1);
+  first_fragment = chunk_size + 4 * n;
+  version = first_fragment + 4 * (n + 1);
+  length = version + 4 * f;
+  crc = length + 4 * f;
+  ctr = crc + 4 * f;
+  fnr = ctr + 4 * f;
+  flags = fnr + 4 * f;
+  crc_algo = flags + f;
+  pool = crc_algo + f;
+}
+
+uint32_t CompactManifest::builder::_add(const char *data, uint32_t size) {
+  uint32_t offset = _pool.size();
+  _pool.append((const char *)&size, sizeof(size));
+  _pool.append(data, size);
+  return offset;
+}
+
+void CompactManifest::builder::add_chunk(uint32_t n_fragments) {
+  _fragments_per_chunk.push_back(n_fragments);
+}
+
+void CompactManifest::builder::add_fragment(
+    const boost::optional<osd_t> &osd, uint32_t version, algo_t crc_algo,
+    const char *crc, uint32_t crc_size, uint32_t length) {
+  _osds.push_back(osd == boost::none ? 0 : osd->i);
+  _flags.push_back(osd == boost::none ? 0 : _HAS_OSD);
+  _versions.push_back(version);
+  _lengths.push_back(length);
+  _crc_algos.push_back((uint8_t)crc_algo);
+  _crcs.push_back(_add(crc, crc_size));
+  _ctrs.push_back(_NONE);
+  _fnrs.push_back(_NONE);
+}
+
+void CompactManifest::builder::set_ctr(const char *ctr, uint32_t size) {
+  _ctrs.back() = _add(ctr, size);
+  _flags.back() |= _HAS_CTR;
+}
+
+void CompactManifest::builder::set_fnr(const char *fnr, uint32_t size) {
+  _fnrs.back() = _add(fnr, size);
+  _flags.back() |= _HAS_FNR;
+}
+
+void CompactManifest::builder::reverse() {
+  std::reverse(_fragments_per_chunk.begin(), _fragments_per_chunk.end());
+  std::reverse(_osds.begin(), _osds.end());
+  std::reverse(_versions.begin(), _versions.end());
+  std::reverse(_lengths.begin(), _lengths.end());
+  std::reverse(_crcs.begin(), _crcs.end());
+  std::reverse(_ctrs.begin(), _ctrs.end());
+  std::reverse(_fnrs.begin(), _fnrs.end());
+  std::reverse(_flags.begin(), _flags.end());
+  std::reverse(_crc_algos.begin(), _crc_algos.end());
+}
+
+CompactManifest::CompactManifest(const ManifestWithNamespaceId &mf) {
+  builder b;
+  b.name = mf.name;
+  b.object_id = mf.object_id;
+  b.chunk_sizes = mf.chunk_sizes;
+  b.encoding_scheme = mf.encoding_scheme;
+  b.compressor = mf.compression->get_compressor();
+  b.encrypt_info = mf.encrypt_info;
+  if (mf.checksum) {
+    b.checksum_algo = mf.checksum->get_algo();
+    b.checksum_digest = _digest(mf.checksum.get());
+  }
+  b.size = mf.size;
+  b.version_id = mf.version_id;
+  b.max_disks_per_node = mf.max_disks_per_node;
+  b.timestamp = mf.timestamp;
+  b.namespace_id = mf.namespace_id;
+  for (auto &chunk : mf.fragments) {
+    b.add_chunk(chunk.size());
+    for (auto &fragment : chunk) {
+      std::string crc = _digest(fragment->crc.get());
+      b.add_fragment(fragment->loc.first, fragment->loc.second,
+                     fragment->crc ? fragment->crc->get_algo()
+                                   : algo_t::NO_CHECKSUM,
+                     crc.data(), crc.size(), fragment->len);
+      if (fragment->ctr != boost::none) {
+        b.set_ctr(fragment->ctr->data(), fragment->ctr->size());
+      }
+      if (fragment->fnr != boost::none) {
+        b.set_fnr(fragment->fnr->data(), fragment->fnr->size());
+      }
+    }
+  }
+  _build(b);
+}
+
+CompactManifest::CompactManifest(builder &&b) { _build(b); }
+
+void CompactManifest::_build(builder &b) {
+  uint32_t n = b._fragments_per_chunk.size();
+  uint32_t f = b._osds.size();
+  if (b.chunk_sizes.size() != n) {
+    throw llio::deserialisation_exception(
+        "CompactManifest: chunk_sizes do not match fragments");
+  }
+  _encrypt_info = encryption::intern(*b.encrypt_info);
+
+  header h;
+  memset(&h, 0, sizeof(h));
+  h.size = b.size;
+  h.namespace_id = b.namespace_id.i;
+  h.timestamp = b.timestamp;
+  h.n_chunks = n;
+  h.n_fragments = f;
+  h.k = b.encoding_scheme.k;
+  h.m = b.encoding_scheme.m;
+  h.w = b.encoding_scheme.w;
+  h.version_id = b.version_id;
+  h.max_disks_per_node = b.max_disks_per_node;
+  h.compressor = (uint8_t)b.compressor;
+  h.name = b._add(b.name.data(), b.name.size());
+  h.object_id = b._add(b.object_id.data(), b.object_id.size());
+  h.checksum_algo = (uint8_t)b.checksum_algo;
+  h.checksum = b._add(b.checksum_digest.data(), b.checksum_digest.size());
+  h.pool_size = b._pool.size();
+
+  offsets o(n, f);
+  _block_size = _align8(o.pool + h.pool_size);
+  _block = std::unique_ptr<char[]>(new char[_block_size]);
+  char *block = _block.get();
+  memset(block, 0, _block_size);
+  memcpy(block, &h, sizeof(h));
+
+  uint32_t *first_fragment = (uint32_t *)(block + o.first_fragment);
+  uint32_t i = 0;
+  for (uint32_t c = 0; c < n; c++) {
+    first_fragment[c] = i;
+    i += b._fragments_per_chunk[c];
+  }
+  first_fragment[n] = i;
+  if (i != f) {
+    throw llio::deserialisation_exception(
+        "CompactManifest: fragment count mismatch");
+  }
+  memcpy(block + o.osd, b._osds.data(), 8 * f);
+  uint64_t *chunk_offset = (uint64_t *)(block + o.chunk_offset);
+  chunk_offset[0] = 0;
+  for (uint32_t c = 0; c < n; c++) {
+    chunk_offset[c + 1] = chunk_offset[c] + b.chunk_sizes[c];
+  }
+  memcpy(block + o.chunk_size, b.chunk_sizes.data(), 4 * n);
+  memcpy(block + o.version, b._versions.data(), 4 * f);
+  memcpy(block + o.length, b._lengths.data(), 4 * f);
+  memcpy(block + o.crc, b._crcs.data(), 4 * f);
+  memcpy(block + o.ctr, b._ctrs.data(), 4 * f);
+  memcpy(block + o.fnr, b._fnrs.data(), 4 * f);
+  memcpy(block + o.flags, b._flags.data(), f);
+  memcpy(block + o.crc_algo, b._crc_algos.data(), f);
+  memcpy(block + o.pool, b._pool.data(), h.pool_size);
+}
+
+CompactManifest::CompactManifest(const char *block, size_t size,
+                                 std::shared_ptr<EncryptInfo> encrypt_info)
+    : _block(new char[size]), _block_size(size),
+      _encrypt_info(encryption::intern(*encrypt_info)) {
+  memcpy(_block.get(), block, size);
+  _validate();
+}
+
+void CompactManifest::_validate() const {
+  auto fail = [](const char *what) {
+    throw llio::deserialisation_exception(std::string("CompactManifest: ") +
+                                          what);
+  };
+  if (_block_size < sizeof(header)) {
+    fail("block too small");
+  }
+  const header &h = _header();
+  // keep the size computation below from overflowing
+  if (h.n_chunks > _block_size || h.n_fragments > _block_size) {
+    fail("bad counts");
+  }
+  offsets o = _offsets();
+  if (_align8(o.pool + h.pool_size) != _block_size) {
+    fail("bad block size");
+  }
+  const uint32_t *first = _first_fragment();
+  if (first[0] != 0 || first[h.n_chunks] != h.n_fragments) {
+    fail("bad fragment index");
+  }
+  const uint64_t *chunk_offsets = _chunk_offsets();
+  if (chunk_offsets[0] != 0) {
+    fail("bad chunk index");
+  }
+  for (uint32_t c = 0; c < h.n_chunks; c++) {
+    if (first[c] > first[c + 1]) {
+      fail("bad fragment index");
+    }
+    if (chunk_offsets[c + 1] != chunk_offsets[c] + _chunk_sizes()[c]) {
+      fail("bad chunk index");
+    }
+  }
+  auto check_entry = [&](uint32_t offset) {
+    uint32_t len;
+    if (offset > h.pool_size || h.pool_size - offset < sizeof(len)) {
+      fail("bad pool offset");
+    }
+    memcpy(&len, _block.get() + o.pool + offset, sizeof(len));
+    if (h.pool_size - offset - sizeof(len) < len) {
+      fail("bad pool entry");
+    }
+  };
+  check_entry(h.name);
+  check_entry(h.object_id);
+  check_entry(h.checksum);
+  const uint8_t *flags = _array<uint8_t>(o.flags);
+  const uint32_t *crcs = _array<uint32_t>(o.crc);
+  const uint32_t *ctrs = _array<uint32_t>(o.ctr);
+  const uint32_t *fnrs = _array<uint32_t>(o.fnr);
+  for (uint32_t i = 0; i < h.n_fragments; i++) {
+    check_entry(crcs[i]);
+    if (flags[i] & _HAS_CTR) {
+      check_entry(ctrs[i]);
+    }
+    if (flags[i] & _HAS_FNR) {
+      check_entry(fnrs[i]);
+    }
+  }
+}
+
+uint32_t CompactManifest::chunk_at(uint64_t pos) const {
+  const uint64_t *begin = _chunk_offsets() + 1;
+  const uint64_t *end = begin + n_chunks();
+  return std::upper_bound(begin, end, pos) - begin;
+}
+
+size_t CompactManifest::memory_size() const {
+  // the object itself and its shared_ptr control block
+  return sizeof(CompactManifest) + 2 * sizeof(void *) + 16 + _block_size;
+}
+
+boost::string_ref CompactManifest::_pool_ref(uint32_t offset) const {
+  const char *p = _block.get() + _offsets().pool + offset;
+  uint32_t len;
+  memcpy(&len, p, sizeof(len));
+  return boost::string_ref(p + sizeof(len), len);
+}
+
+std::string CompactManifest::name() const {
+  return _pool_string(_header().name);
+}
+
+std::string CompactManifest::object_id() const {
+  return _pool_string(_header().object_id);
+}
+
+boost::string_ref CompactManifest::object_id_ref() const {
+  return _pool_ref(_header().object_id);
+}
+
+EncodingScheme CompactManifest::encoding_scheme() const {
+  const header &h = _header();
+  return EncodingScheme{h.k, h.m, h.w};
+}
+
+std::unique_ptr<Checksum> CompactManifest::checksum() const {
+  return _checksum(_header().checksum_algo, _pool_string(_header().checksum));
+}
+
+fragment_location_t
+CompactManifest::fragment_location(uint32_t chunk, uint32_t fragment) const {
+  offsets o = _offsets();
+  uint32_t i = _index(chunk, fragment);
+  boost::optional<osd_t> osd;
+  if (_array<uint8_t>(o.flags)[i] & _HAS_OSD) {
+    osd = osd_t{_array<uint64_t>(o.osd)[i]};
+  }
+  return fragment_location_t(osd, _array<uint32_t>(o.version)[i]);
+}
+
+std::unique_ptr<Checksum>
+CompactManifest::fragment_checksum(uint32_t chunk, uint32_t fragment) const {
+  offsets o = _offsets();
+  uint32_t i = _index(chunk, fragment);
+  return _checksum(_array<uint8_t>(o.crc_algo)[i],
+                   _pool_string(_array<uint32_t>(o.crc)[i]));
+}
+
+boost::optional<std::string>
+CompactManifest::fragment_ctr(uint32_t chunk, uint32_t fragment) const {
+  offsets o = _offsets();
+  uint32_t i = _index(chunk, fragment);
+  if (!(_array<uint8_t>(o.flags)[i] & _HAS_CTR)) {
+    return boost::none;
+  }
+  return _pool_string(_array<uint32_t>(o.ctr)[i]);
+}
+
+boost::optional<boost::string_ref>
+CompactManifest::fragment_ctr_ref(uint32_t chunk, uint32_t fragment) const {
+  offsets o = _offsets();
+  uint32_t i = _index(chunk, fragment);
+  if (!(_array<uint8_t>(o.flags)[i] & _HAS_CTR)) {
+    return boost::none;
+  }
+  return _pool_ref(_array<uint32_t>(o.ctr)[i]);
+}
+
+boost::optional<std::string>
+CompactManifest::fragment_fnr(uint32_t chunk, uint32_t fragment) const {
+  offsets o = _offsets();
+  uint32_t i = _index(chunk, fragment);
+  if (!(_array<uint8_t>(o.flags)[i] & _HAS_FNR)) {
+    return boost::none;
+  }
+  return _pool_string(_array<uint32_t>(o.fnr)[i]);
+}
+
+std::unique_ptr<ManifestWithNamespaceId> CompactManifest::expand() const {
+  std::unique_ptr<ManifestWithNamespaceId> mf(new ManifestWithNamespaceId());
+  mf->name = name();
+  mf->object_id = object_id();
+  uint32_t n = n_chunks();
+  for (uint32_t c = 0; c < n; c++) {
+    mf->chunk_sizes.push_back(chunk_size(c));
+  }
+  mf->encoding_scheme = encoding_scheme();
+  switch (compressor()) {
+  case compressor_t::NO_COMPRESSION:
+    mf->compression.reset(new NoCompression());
+    break;
+  case compressor_t::SNAPPY:
+    mf->compression.reset(new SnappyCompression());
+    break;
+  case compressor_t::BZIP2:
+    mf->compression.reset(new BZip2Compression());
+    break;
+  case compressor_t::TEST:
+    mf->compression.reset(new TestCompression());
+    break;
+  }
+  mf->encrypt_info = _encrypt_info;
+  mf->checksum = checksum();
+  mf->size = size();
+  mf->fragments.resize(n);
+  for (uint32_t c = 0; c < n; c++) {
+    for (uint32_t f = 0; f < n_fragments(c); f++) {
+      std::shared_ptr<Fragment> fragment(new Fragment());
+      fragment->loc = fragment_location(c, f);
+      fragment->crc = fragment_checksum(c, f);
+      fragment->len = fragment_length(c, f);
+      fragment->ctr = fragment_ctr(c, f);
+      fragment->fnr = fragment_fnr(c, f);
+      mf->fragments[c].push_back(std::move(fragment));
+    }
+  }
+  mf->version_id = version_id();
+  mf->max_disks_per_node = max_disks_per_node();
+  mf->timestamp = timestamp();
+  mf->namespace_id = namespace_id();
+  return mf;
+}
+
+std::ostream &operator<<(std::ostream &os, const CompactManifest &mf) {
+  os << *mf.expand();
+  return os;
+}
+}
+}
@@ -19,7 +19,12 @@ but WITHOUT ANY WARRANTY of any kind.
 #include "encryption.h"
 #include "llio.h"
 
+#include <algorithm>
 #include <gcrypt.h>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
 
 namespace alba {
 namespace llio {
@@ -86,17 +91,14 @@ template <> void from(message &m, Encrypted &awk) {
 template <> void from(message &m, std::shared_ptr<EncryptInfo> &p) {
   uint8_t type;
   from(m, type);
-  EncryptInfo *r;
   switch (type) {
   case 1: {
-    r = new NoEncryption();
-    p.reset(r);
+    p = intern(NoEncryption());
   }; break;
   case 2: {
-    Encrypted *awk = new Encrypted();
-    r = awk;
-    p.reset(r);
-    from(m, *awk);
+    Encrypted awk;
+    from(m, awk);
+    p = intern(awk);
   }; break;
   default: {
     ALBA_LOG(WARNING, "unknown encryption scheme: type=" << type);
@@ -110,84 +112,225 @@ template <> void from(message &m, std::shared_ptr<EncryptInfo> &p) {
 namespace alba {
 namespace encryption {
 
-bool Encrypted::partial_decrypt(unsigned char *buf, int len,
-                                std::string &enc_key, std::string &ctr,
-                                int offset) const {
+std::shared_ptr<EncryptInfo> intern(const EncryptInfo &ei) {
+  static std::mutex mutex;
+  static const std::shared_ptr<EncryptInfo> no_encryption =
+      std::make_shared<NoEncryption>();
+  static std::map<std::string, std::shared_ptr<EncryptInfo>> encrypted;
 
-  if (mode != chaining_mode_t::CTR) {
-    return false;
+  switch (ei.get_encryption()) {
+  case encryption_t::NO_ENCRYPTION:
+    break;
+  case encryption_t::ENCRYPTED: {
+    auto &e = static_cast<const Encrypted &>(ei);
+    std::string key;
+    key.reserve(3 + e.key_identification.size());
+    key.push_back((char)e.algo);
+    key.push_back((char)e.mode);
+    key.push_back((char)e.key_length);
+    key.append(e.key_identification);
+
+    std::lock_guard<std::mutex> g(mutex);
+    auto it = encrypted.find(key);
+    if (it == encrypted.end()) {
+      it = encrypted
+               .emplace(std::move(key), std::make_shared<Encrypted>(e))
+               .first;
+    }
+    return it->second;
   }
-
-  uint64_t block_len = 16;
-
-  if (ctr.size() != block_len) {
-    assert(false);
   }
+  return no_encryption;
+}
 
-  uint64_t skip_blocks = offset / block_len;
+namespace {
+const size_t _BLOCK_LEN = 16;
+// cipher handles a thread keeps around
+const size_t _MAX_HANDLES = 4;
 
-  auto ctr_msg = llio::message(llio::message_buffer::from_string(ctr));
+// Padding.pad of the ocaml side: always 1 .. block_len bytes of value n
+void _pad(std::string &s) {
+  size_t n = _BLOCK_LEN - s.size() % _BLOCK_LEN;
+  s.append(n, (char)n);
+}
 
-  uint64_t high, low;
-  from_be(ctr_msg, high);
-  from_be(ctr_msg, low);
+/* the AES256 cipher handles (in CBC or CTR mode) a thread used last, with
+   their key schedules. Opening a handle and setting its key costs more
+   than decrypting a 4K slice, now that's done once per key and thread.
+   Only the iv or counter is set per slice. */
+class cipher_handles {
+public:
+  cipher_handles() = default;
+  cipher_handles(const cipher_handles &) = delete;
+  cipher_handles &operator=(const cipher_handles &) = delete;
+
+  ~cipher_handles() {
+    for (auto &e : _entries) {
+      gcry_cipher_close(e.hd);
+    }
+  }
+
+  // nullptr if it can't be had
+  gcry_cipher_hd_t get(int mode, const std::string &key) {
+    for (size_t i = 0; i < _entries.size(); i++) {
+      if (_entries[i].mode == mode && _entries[i].key == key) {
+        // (most recently used last)
+        std::rotate(_entries.begin() + i, _entries.begin() + i + 1,
+                    _entries.end());
+        return _entries.back().hd;
+      }
+    }
 
-  uint64_t low2 = low + skip_blocks;
-  uint64_t high2 = high;
-  if (std::numeric_limits<uint64_t>::max() - low < skip_blocks) {
-    // low2 overflowed
-    high2 += 1;
+    gcry_cipher_hd_t hd;
+    int gcrypt_result = gcry_cipher_open(&hd, GCRY_CIPHER_AES256, mode, 0);
+    if (gcrypt_result != 0) {
+      ALBA_LOG(WARNING, "gcry_cipher_open returned " << gcrypt_result);
+      return nullptr;
+    }
+    gcrypt_result = gcry_cipher_setkey(hd, key.c_str(), key.size());
+    if (gcrypt_result != 0) {
+      ALBA_LOG(WARNING, "gcry_cipher_setkey returned " << gcrypt_result);
+      gcry_cipher_close(hd);
+      return nullptr;
+    }
+    if (_entries.size() == _MAX_HANDLES) {
+      gcry_cipher_close(_entries.front().hd);
+      _entries.erase(_entries.begin());
+    }
+    _entries.push_back(entry{mode, key, hd});
+    return hd;
   }
 
-  llio::message_builder mb;
-  to_be(mb, high2);
-  to_be(mb, low2);
+private:
+  struct entry {
+    int mode;
+    std::string key;
+    gcry_cipher_hd_t hd;
+  };
+  std::vector<entry> _entries;
+};
 
-  std::string ctr_with_offset = mb.as_string_no_size();
+cipher_handles &_handles() {
+  static thread_local cipher_handles handles;
+  return handles;
+}
 
-  int gcrypt_result;
+// the counter of the block at offset, from the fragment's counter
+// (a 128 bit big endian number)
+void _ctr_at(const unsigned char *ctr, uint64_t offset, unsigned char *out) {
+  uint64_t high = 0;
+  uint64_t low = 0;
+  for (size_t i = 0; i < 8; i++) {
+    high = (high << 8) | ctr[i];
+    low = (low << 8) | ctr[8 + i];
+  }
+  uint64_t low2 = low + offset / _BLOCK_LEN;
+  if (low2 < low) {
+    high++;
+  }
+  for (size_t i = 0; i < 8; i++) {
+    out[7 - i] = (unsigned char)(high >> (8 * i));
+    out[15 - i] = (unsigned char)(low2 >> (8 * i));
+  }
+}
 
-  gcry_cipher_hd_t hd;
-  gcrypt_result =
-      gcry_cipher_open(&hd, GCRY_CIPHER_AES, GCRY_CIPHER_MODE_CTR, 0);
-  if (gcrypt_result != 0) {
-    ALBA_LOG(WARNING, "gcry_cipher_open returned " << gcrypt_result);
+// (encrypt or decrypt) len bytes of buf in place with AES256 CBC
+bool _cbc(bool encrypt, unsigned char *buf, size_t len,
+          const std::string &enc_key, const unsigned char *iv) {
+  gcry_cipher_hd_t hd = _handles().get(GCRY_CIPHER_MODE_CBC, enc_key);
+  if (hd == nullptr) {
     return false;
   }
-
-  gcrypt_result = gcry_cipher_setkey(hd, enc_key.c_str(), enc_key.size());
+  int gcrypt_result = gcry_cipher_setiv(hd, iv, _BLOCK_LEN);
+  if (gcrypt_result == 0) {
+    gcrypt_result = encrypt
+                        ? gcry_cipher_encrypt(hd, buf, len, nullptr, 0)
+                        : gcry_cipher_decrypt(hd, buf, len, nullptr, 0);
+  }
   if (gcrypt_result != 0) {
-    ALBA_LOG(WARNING, "gcry_cipher_setkey returned " << gcrypt_result);
-    gcry_cipher_close(hd);
-    return false;
+    ALBA_LOG(WARNING, "AES256 CBC returned " << gcrypt_result);
   }
+  return gcrypt_result == 0;
+}
+}
 
-  gcrypt_result = gcry_cipher_setctr(hd, ctr_with_offset.c_str(), block_len);
-  if (gcrypt_result != 0) {
-    ALBA_LOG(WARNING, "gcry_cipher_setctr returned " << gcrypt_result);
-    gcry_cipher_close(hd);
+std::string Encrypted::fragment_iv(const std::string &enc_key,
+                                   const std::string &object_id,
+                                   uint32_t chunk_id,
+                                   uint32_t fragment_id) const {
+  llio::message_builder mb;
+  llio::to(mb, object_id);
+  llio::to(mb, chunk_id);
+  llio::to(mb, fragment_id);
+  std::string s = mb.as_string_no_size();
+  _pad(s);
+  // (gcrypt's iv is all zeroes until it's set)
+  const unsigned char zeroes[_BLOCK_LEN] = {0};
+  if (!_cbc(true, (unsigned char *)&s[0], s.size(), enc_key, zeroes)) {
+    throw std::runtime_error("can't make the iv of a fragment");
+  }
+  return s.substr(s.size() - _BLOCK_LEN);
+}
+
+bool Encrypted::partial_decrypt(unsigned char *buf, int len,
+                                std::string &enc_key, std::string &ctr,
+                                int offset) const {
+  if (ctr.size() != _BLOCK_LEN) {
+    ALBA_LOG(WARNING, "partial decrypt with a " << ctr.size()
+                                                << " byte counter or iv");
     return false;
   }
+  slice s{buf, (uint32_t)len, (const unsigned char *)ctr.data(),
+          (uint32_t)offset};
+  return partial_decrypt(enc_key, &s, 1);
+}
 
-  uint64_t to_burn = offset % block_len;
-  if (to_burn > 0) {
-    char burn_buf[to_burn];
-    gcrypt_result = gcry_cipher_decrypt(hd, burn_buf, to_burn, nullptr, 0);
-    if (gcrypt_result != 0) {
-      ALBA_LOG(WARNING, "gcry_cipher_setctr returned " << gcrypt_result);
-      gcry_cipher_close(hd);
-      return false;
+bool Encrypted::partial_decrypt(const std::string &enc_key,
+                                const slice *slices, size_t n) const {
+  if (mode == chaining_mode_t::CBC) {
+    for (size_t i = 0; i < n; i++) {
+      auto &s = slices[i];
+      if (s.offset % _BLOCK_LEN != 0 || s.len % _BLOCK_LEN != 0) {
+        ALBA_LOG(WARNING, "CBC partial decrypt of " << s.len << " bytes at "
+                                                    << s.offset);
+        return false;
+      }
+      if (!_cbc(false, s.buf, s.len, enc_key, s.ctr)) {
+        return false;
+      }
     }
+    return true;
   }
 
-  gcrypt_result = gcry_cipher_decrypt(hd, buf, len, nullptr, 0);
-  if (gcrypt_result != 0) {
-    ALBA_LOG(WARNING, "gcry_cipher_setctr returned " << gcrypt_result);
-    gcry_cipher_close(hd);
+  gcry_cipher_hd_t hd = _handles().get(GCRY_CIPHER_MODE_CTR, enc_key);
+  if (hd == nullptr) {
     return false;
   }
-
-  gcry_cipher_close(hd);
+  for (size_t i = 0; i < n; i++) {
+    auto &s = slices[i];
+    unsigned char ctr[_BLOCK_LEN];
+    _ctr_at(s.ctr, s.offset, ctr);
+    int gcrypt_result = gcry_cipher_setctr(hd, ctr, _BLOCK_LEN);
+    if (gcrypt_result != 0) {
+      ALBA_LOG(WARNING, "gcry_cipher_setctr returned " << gcrypt_result);
+      return false;
+    }
+    // the start of the block that's before offset
+    uint32_t to_burn = s.offset % _BLOCK_LEN;
+    if (to_burn > 0) {
+      unsigned char burn[_BLOCK_LEN];
+      gcrypt_result = gcry_cipher_decrypt(hd, burn, to_burn, nullptr, 0);
+      if (gcrypt_result != 0) {
+        ALBA_LOG(WARNING, "gcry_cipher_decrypt returned " << gcrypt_result);
+        return false;
+      }
+    }
+    gcrypt_result = gcry_cipher_decrypt(hd, s.buf, s.len, nullptr, 0);
+    if (gcrypt_result != 0) {
+      ALBA_LOG(WARNING, "gcry_cipher_decrypt returned " << gcrypt_result);
+      return false;
+    }
+  }
   return true;
 }
 
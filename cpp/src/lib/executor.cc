@@ -0,0 +1,195 @@
+/*
+Copyright (C) 2016 iNuron NV
+
+This file is part of Open vStorage Open Source Edition (OSE), as available from
+
+
+    http://www.openvstorage.org and
+    http://www.openvstorage.com.
+
+This file is free software; you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License v3 (GNU AGPLv3)
+as published by the Free Software Foundation, in version 3 as it comes
+in the <LICENSE.txt> file of the Open vStorage OSE distribution.
+
+Open vStorage is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY of any kind.
+*/
+
+#include "executor.h"
+#include "alba_logger.h"
+
+#include <atomic>
+#include <exception>
+#include <memory>
+
+namespace alba {
+namespace executor {
+
+Executor::Executor(int n_threads) : _idle(0), _stopping(false) {
+  ALBA_LOG(INFO, "Executor(n_threads=" << n_threads << ")");
+  for (int i = 0; i < n_threads; i++) {
+    _threads.emplace_back([this] { this->_run(); });
+  }
+}
+
+Executor::~Executor() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stopping = true;
+  }
+  _cond.notify_all();
+  for (auto &t : _threads) {
+    t.join();
+  }
+}
+
+void Executor::submit(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _tasks.push_back(std::move(task));
+  }
+  _cond.notify_one();
+}
+
+bool Executor::submit_if_idle(std::function<void()> &task) {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    // (every queued task already has a waiting worker spoken for)
+    if ((size_t)_idle <= _tasks.size()) {
+      return false;
+    }
+    _tasks.push_back(std::move(task));
+  }
+  _cond.notify_one();
+  return true;
+}
+
+void Executor::_run() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _idle++;
+      _cond.wait(lock, [this] { return _stopping || !_tasks.empty(); });
+      _idle--;
+      if (_tasks.empty()) {
+        return;
+      }
+      task = std::move(_tasks.front());
+      _tasks.pop_front();
+    }
+    try {
+      task();
+    } catch (std::exception &e) {
+      ALBA_LOG(WARNING, "Executor: task threw " << e.what());
+    }
+  }
+}
+
+namespace {
+struct loop_state {
+  loop_state(size_t n)
+      : n(n), next(0), rc(0), failed(false), active(0), closed(false) {}
+
+  const size_t n;
+  std::atomic<size_t> next;
+  std::atomic<int> rc;
+  std::atomic<bool> failed;
+
+  std::mutex mutex;
+  std::condition_variable cond;
+  int active;
+  bool closed;
+  std::exception_ptr error;
+};
+
+/* keeps a helper accounted for in active for as long as it may touch f,
+   even when f throws */
+struct active_guard {
+  active_guard(loop_state &s) : s(s) {}
+  ~active_guard() {
+    {
+      std::lock_guard<std::mutex> lock(s.mutex);
+      s.active--;
+    }
+    s.cond.notify_all();
+  }
+  loop_state &s;
+};
+
+/* closes the loop for late helpers and waits for the running ones,
+   also when the caller leaves parallel_for by an exception */
+struct join_guard {
+  join_guard(loop_state &s) : s(s) {}
+  ~join_guard() {
+    std::unique_lock<std::mutex> lock(s.mutex);
+    s.closed = true;
+    s.cond.wait(lock, [this] { return s.active == 0; });
+  }
+  loop_state &s;
+};
+
+void _drain(loop_state &s, const std::function<int(size_t)> &f) {
+  size_t i;
+  try {
+    while (s.rc.load() == 0 && !s.failed.load() &&
+           (i = s.next.fetch_add(1)) < s.n) {
+      int r = f(i);
+      if (r) {
+        int expected = 0;
+        s.rc.compare_exchange_strong(expected, r);
+      }
+    }
+  } catch (...) {
+    std::lock_guard<std::mutex> lock(s.mutex);
+    if (!s.error) {
+      s.error = std::current_exception();
+    }
+    s.failed = true;
+  }
+}
+}
+
+int parallel_for(Executor &executor, size_t n, size_t max_parallel,
+                 const std::function<int(size_t)> &f) {
+  size_t helpers = std::min(n, max_parallel);
+  helpers = std::min(helpers, (size_t)executor.size() + 1);
+  if (helpers <= 1) {
+    int rc = 0;
+    for (size_t i = 0; i < n && rc == 0; i++) {
+      rc = f(i);
+    }
+    return rc;
+  }
+  helpers--; // the caller is one of them
+
+  // helpers that only get scheduled after the caller finished must not touch
+  // f anymore, so they only hold on to the state.
+  auto state = std::make_shared<loop_state>(n);
+  {
+    join_guard join(*state);
+    for (size_t h = 0; h < helpers; h++) {
+      executor.submit([state, &f] {
+        {
+          std::lock_guard<std::mutex> lock(state->mutex);
+          if (state->closed) {
+            return;
+          }
+          state->active++;
+        }
+        active_guard g(*state);
+        _drain(*state, f);
+      });
+    }
+
+    _drain(*state, f);
+  }
+
+  if (state->error) {
+    std::rethrow_exception(state->error);
+  }
+  return state->rc.load();
+}
+}
+}
@@ -0,0 +1,72 @@
+/*
+Copyright (C) 2016 iNuron NV
+
+This file is part of Open vStorage Open Source Edition (OSE), as available from
+
+
+    http://www.openvstorage.org and
+    http://www.openvstorage.com.
+
+This file is free software; you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License v3 (GNU AGPLv3)
+as published by the Free Software Foundation, in version 3 as it comes
+in the <LICENSE.txt> file of the Open vStorage OSE distribution.
+
+Open vStorage is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY of any kind.
+*/
+
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace alba {
+namespace executor {
+
+/* a fixed set of worker threads draining a shared queue of tasks.
+   tasks should not block on other tasks of the same executor:
+   callers are expected to do a share of the work themselves
+   (see parallel_for) so they make progress even when all
+   workers are busy.
+*/
+class Executor {
+public:
+  explicit Executor(int n_threads);
+  ~Executor();
+
+  Executor(const Executor &) = delete;
+  Executor &operator=(const Executor &) = delete;
+
+  void submit(std::function<void()> task);
+
+  // submits task only when a worker is free to start on it right away,
+  // false (and task is left alone) when there's none
+  bool submit_if_idle(std::function<void()> &task);
+
+  int size() const { return _threads.size(); }
+
+private:
+  void _run();
+
+  std::mutex _mutex;
+  std::condition_variable _cond;
+  std::deque<std::function<void()>> _tasks;
+  int _idle; // workers waiting for a task
+  bool _stopping;
+  std::vector<std::thread> _threads;
+};
+
+/* runs f(0) .. f(n-1) on at most max_parallel threads, the calling thread
+   included. As soon as one f(i) returns non zero, items that have not been
+   started yet are skipped. Returns the first non zero result, or 0.
+   If an f(i) throws, the remaining items are skipped as well and the
+   first exception is rethrown in the caller once all threads let go of f.
+*/
+int parallel_for(Executor &executor, size_t n, size_t max_parallel,
+                 const std::function<int(size_t)> &f);
+}
+}
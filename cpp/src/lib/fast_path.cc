@@ -0,0 +1,601 @@
+/*
+Copyright (C) 2016 iNuron NV
+
+This file is part of Open vStorage Open Source Edition (OSE), as available from
+
+
+    http://www.openvstorage.org and
+    http://www.openvstorage.com.
+
+This file is free software; you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License v3 (GNU AGPLv3)
+as published by the Free Software Foundation, in version 3 as it comes
+in the <LICENSE.txt> file of the Open vStorage OSE distribution.
+
+Open vStorage is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY of any kind.
+*/
+
+#include "fast_path.h"
+#include "alba_logger.h"
+#include "reed_solomon.h"
+#include <algorithm>
+#include <string.h>
+
+namespace alba {
+namespace proxy_client {
+
+using llio::to;
+
+namespace {
+bool _via_proxy(const Location &l) {
+  return !l.encrypt_info->supports_partial_decrypt();
+}
+
+bool _cbc(const Location &l) {
+  return l.encrypt_info->get_encryption() == encryption_t::ENCRYPTED &&
+         static_cast<const encryption::Encrypted *>(l.encrypt_info)->mode ==
+             encryption::chaining_mode_t::CBC;
+}
+
+const uint32_t _CBC_BLOCK = 16;
+
+// the fragment_id a fragment's iv is made with (see fragment_iv):
+// a copy of l with 0 there if the chunk is replicated
+Location _iv_location(const Location &l, const CompactManifest &mf) {
+  Location r = l;
+  if (mf.encoding_scheme().k == 1) {
+    r.fragment_id = 0;
+  }
+  return r;
+}
+
+// the fragment of l, read whole into data, has the checksum mf has for it
+// (a replica's fragment_id can be 0 here, see _iv_location: the replicas
+//  are the same bytes)
+bool _verify(const CompactManifest &mf, const Location &l, const byte *data) {
+  auto checksum = mf.fragment_checksum(l.chunk_id, l.fragment_id);
+  if (verify(*checksum, data, l.length)) {
+    return true;
+  }
+  ALBA_LOG(WARNING, "fast_path_plan: fragment "
+                        << l.fragment_id << " of chunk " << l.chunk_id
+                        << " doesn't match its checksum " << *checksum);
+  return false;
+}
+
+void _append(std::string &s, uint32_t i) {
+  // as llio::to does it
+  s.append((const char *)&i, sizeof(i));
+}
+}
+
+const size_t fast_path_plan::NONE;
+
+void fast_path_plan::build(const std::vector<alba_id_t> &alba_levels,
+                           const std::string &namespace_,
+                           const std::vector<ObjectSlices> &slices,
+                           bool rebuild) {
+  locations.clear();
+  for (auto &item : per_osd) {
+    item.second.clear();
+  }
+  for (auto &item : rebuild_per_osd) {
+    item.second.clear();
+  }
+  rebuild_results.clear();
+  via_proxy.clear();
+  _objects.clear();
+  _location_manifests.clear();
+  _fragments.clear();
+  _location_fragments.clear();
+  _windows.clear();
+  _rebuilds.clear();
+  _sources.clear();
+  _n_buffers = 0;
+  _manifests.clear();
+  _n_keys = 0;
+  _prefix_object_id = nullptr;
+
+  for (size_t i = 0; i < slices.size(); i++) {
+    const size_t first = locations.size();
+    const size_t first_fragment = _fragments.size();
+    const size_t first_window = _windows.size();
+    const size_t first_rebuild = _rebuilds.size();
+    const size_t first_source = _sources.size();
+    const size_t n_buffers = _n_buffers;
+    const size_t n_keys = _n_keys;
+    bool ok = _resolve(alba_levels, 0, namespace_, slices[i]);
+    _location_fragments.resize(locations.size(), NONE);
+    for (size_t j = first; ok && j < locations.size(); j++) {
+      const Location &l = locations[j].second;
+      if (_via_proxy(l)) {
+        ok = false;
+      } else if (l.uses_compression) {
+        ok = _add_compressed(j, first_fragment);
+      } else if (_cbc(l)) {
+        ok = _add_window(j);
+      } else {
+        ok = l.fragment_location.first != boost::none ||
+             (rebuild && _add_rebuild(j, false));
+      }
+    }
+    if (!ok) {
+      locations.erase(locations.begin() + first, locations.end());
+      _location_manifests.resize(first);
+      _location_fragments.resize(first);
+      _fragments.resize(first_fragment);
+      _windows.resize(first_window);
+      _rebuilds.resize(first_rebuild);
+      _sources.resize(first_source);
+      _n_buffers = n_buffers;
+      _n_keys = n_keys;
+      via_proxy.push_back(i);
+    } else {
+      _objects.push_back(object_locations{i, first, locations.size()});
+    }
+  }
+  _filled.assign(locations.size(), false);
+  _corrupt.assign(locations.size(), false);
+
+  for (auto &bl : locations) {
+    const Location &l = bl.second;
+    if (l.uses_compression || _cbc(l) ||
+        l.fragment_location.first == boost::none) {
+      continue;
+    }
+    asd_slice slice{&_fragment_key(l), l.offset, l.length, bl.first};
+    per_osd[*l.fragment_location.first].push_back(slice);
+  }
+  for (auto &w : _fragments) {
+    if (w.data == nullptr) {
+      const Location &l = w.location;
+      asd_slice slice{w.key, l.offset, l.length, _buffers[w.buffer].data()};
+      per_osd[*l.fragment_location.first].push_back(slice);
+    }
+  }
+  for (auto &w : _windows) {
+    const Location &l = w.blocks;
+    asd_slice slice{w.key, l.offset - w.iv_size, l.length + w.iv_size,
+                    _buffers[w.buffer].data()};
+    per_osd[*l.fragment_location.first].push_back(slice);
+  }
+  for (auto &r : _rebuilds) {
+    _read_rebuild(r, per_osd);
+  }
+}
+
+bool fast_path_plan::read_ok(const Location &l) const {
+  if (l.fragment_location.first == boost::none) {
+    return false;
+  }
+  auto it = osd_results.find(*l.fragment_location.first);
+  return it != osd_results.end() && it->second == 0;
+}
+
+bool fast_path_plan::direct(size_t i) const {
+  const Location &l = locations[i].second;
+  return !l.uses_compression && !_cbc(l) && read_ok(l) && !_corrupt[i];
+}
+
+size_t fast_path_plan::verify_direct() {
+  size_t n = 0;
+  for (size_t j = 0; j < locations.size(); j++) {
+    auto &bl = locations[j];
+    const Location &l = bl.second;
+    const CompactManifest &mf = *_location_manifests[j];
+    if (l.offset != 0 || !direct(j) ||
+        l.length != mf.fragment_length(l.chunk_id, l.fragment_id)) {
+      continue;
+    }
+    if (!_verify(mf, l, bl.first)) {
+      _corrupt[j] = true;
+      n++;
+    }
+  }
+  return n;
+}
+
+bool fast_path_plan::plan_rebuilds() {
+  for (auto &item : rebuild_per_osd) {
+    item.second.clear();
+  }
+  const size_t first = _rebuilds.size();
+  for (size_t j = 0; j < locations.size(); j++) {
+    // (the ones without a fragment have theirs already)
+    // (and the ones on late osds went via the proxy)
+    const Location &l = locations[j].second;
+    if (l.fragment_location.first != boost::none && !read_ok(l) &&
+        !_late(l)) {
+      _add_rebuild(j, true);
+    }
+  }
+  for (size_t i = first; i < _rebuilds.size(); i++) {
+    _read_rebuild(_rebuilds[i], rebuild_per_osd);
+  }
+  return _rebuilds.size() > first;
+}
+
+size_t fast_path_plan::rebuild(
+    const std::function<void(byte *, const Location &)> &decrypt) {
+  size_t n = 0;
+  for (auto &r : _rebuilds) {
+    if (!_rebuild_results_ok(r)) {
+      continue;
+    }
+    auto &bl = locations[r.location];
+    const Location &l = bl.second;
+    auto es = _location_manifests[r.location]->encoding_scheme();
+    _source_ids.clear();
+    _inputs.clear();
+    for (uint32_t i = 0; i < r.k; i++) {
+      const Location &source = _sources[r.first + i];
+      byte *buf = &_buffers[r.buffer][i * l.length];
+      decrypt(buf, source);
+      _source_ids.push_back(source.fragment_id);
+      _inputs.push_back(buf);
+    }
+    if (!erasure::decoding_coefficients(es.k, es.m, _source_ids,
+                                        l.fragment_id, _coefficients)) {
+      ALBA_LOG(WARNING, "fast_path_plan: can't rebuild fragment "
+                            << l.fragment_id << " of chunk " << l.chunk_id);
+      continue;
+    }
+    erasure::combine(_coefficients.data(), _inputs.data(), r.k, bl.first,
+                     l.length);
+    _filled[r.location] = true;
+    n++;
+  }
+  return n;
+}
+
+size_t fast_path_plan::decompress(
+    const std::function<void(byte *, const Location &)> &decrypt,
+    bool verify) {
+  for (auto &w : _fragments) {
+    if (w.data != nullptr || !read_ok(w.location)) {
+      continue;
+    }
+    byte *buf = _buffers[w.buffer].data();
+    if (verify && !_verify(*w.manifest, w.location, buf)) {
+      continue;
+    }
+    decrypt(buf, w.location);
+    size_t size = w.location.length;
+    if (_cbc(w.location)) {
+      // Padding.unpad
+      uint32_t n = size == 0 ? 0 : buf[size - 1];
+      if (n == 0 || n > _CBC_BLOCK || n > size) {
+        ALBA_LOG(WARNING, "fast_path_plan: bad padding in fragment "
+                              << w.location.fragment_id << " of chunk "
+                              << w.location.chunk_id);
+        continue;
+      }
+      size -= n;
+    }
+    // (the fragment's share of its chunk, as the location resolver has it)
+    const Location &l = w.location;
+    size_t max_size =
+        w.manifest->chunk_size(l.chunk_id) / w.manifest->encoding_scheme().k;
+    auto data = std::make_shared<std::vector<byte>>();
+    if (!decompress_fragment(w.compressor, buf, size, max_size, *data)) {
+      ALBA_LOG(WARNING, "fast_path_plan: can't decompress fragment "
+                            << w.location.fragment_id << " of chunk "
+                            << w.location.chunk_id);
+      continue;
+    }
+    w.data = std::move(data);
+    DecompressedFragmentCache::getInstance().add(*w.key, w.data);
+  }
+
+  size_t n = 0;
+  for (size_t j = 0; j < locations.size(); j++) {
+    size_t f = _location_fragments[j];
+    if (f == NONE || _fragments[f].data == nullptr) {
+      continue;
+    }
+    auto &bl = locations[j];
+    const Location &l = bl.second;
+    auto &data = *_fragments[f].data;
+    if ((size_t)l.offset + l.length > data.size()) {
+      ALBA_LOG(WARNING, "fast_path_plan: fragment "
+                            << l.fragment_id << " of chunk " << l.chunk_id
+                            << " is " << data.size() << " bytes decompressed");
+      continue;
+    }
+    memcpy(bl.first, &data[l.offset], l.length);
+    _filled[j] = true;
+    n++;
+  }
+  return n;
+}
+
+size_t fast_path_plan::decrypt_windows(
+    const std::function<void(byte *, const Location &)> &decrypt) {
+  size_t n = 0;
+  for (auto &w : _windows) {
+    if (!read_ok(w.blocks)) {
+      continue;
+    }
+    auto &bl = locations[w.location];
+    const Location &l = bl.second;
+    byte *blocks = _buffers[w.buffer].data() + w.iv_size;
+    decrypt(blocks, w.blocks);
+    memcpy(bl.first, blocks + (l.offset - w.blocks.offset), l.length);
+    _filled[w.location] = true;
+    n++;
+  }
+  return n;
+}
+
+void fast_path_plan::failed_slices(const std::vector<ObjectSlices> &slices,
+                                   std::vector<ObjectSlices> &result) const {
+  _slices_with(slices, result, [this](size_t j) { return !done(j); });
+}
+
+void fast_path_plan::slices_on(const std::vector<osd_t> &osds,
+                               const std::vector<ObjectSlices> &slices,
+                               std::vector<ObjectSlices> &result) const {
+  auto on = [&osds](const Location &l) {
+    if (l.fragment_location.first == boost::none) {
+      return false;
+    }
+    uint64_t osd = l.fragment_location.first->i;
+    return std::any_of(osds.begin(), osds.end(),
+                       [osd](const osd_t &o) { return o.i == osd; });
+  };
+  std::vector<bool> needs(locations.size());
+  for (size_t j = 0; j < locations.size(); j++) {
+    needs[j] = on(locations[j].second);
+  }
+  for (auto &r : _rebuilds) {
+    for (uint32_t i = 0; i < r.k; i++) {
+      if (on(_sources[r.first + i])) {
+        needs[r.location] = true;
+      }
+    }
+  }
+  _slices_with(slices, result, [&needs](size_t j) { return needs[j]; });
+}
+
+bool fast_path_plan::_late(const Location &l) const {
+  auto it = osd_results.find(*l.fragment_location.first);
+  return it != osd_results.end() && it->second == hedged_read::LATE;
+}
+
+void fast_path_plan::_slices_with(
+    const std::vector<ObjectSlices> &slices, std::vector<ObjectSlices> &result,
+    const std::function<bool(size_t)> &location_pred) const {
+  for (auto &o : _objects) {
+    auto &object_slices = slices[o.object];
+    std::vector<SliceDescriptor> failed;
+    for (auto &slice : object_slices.slices) {
+      // a slice's pieces land in its part of the target buffer
+      const byte *begin = slice.buf;
+      const byte *end = slice.buf + slice.size;
+      for (size_t j = o.first; j < o.last; j++) {
+        auto &bl = locations[j];
+        if (location_pred(j) && bl.first < end &&
+            begin < bl.first + bl.second.length) {
+          failed.push_back(slice);
+          break;
+        }
+      }
+    }
+    if (!failed.empty()) {
+      result.push_back(ObjectSlices{object_slices.object_name, failed});
+    }
+  }
+}
+
+void fast_path_plan::direct_slices(const std::vector<ObjectSlices> &slices,
+                                   std::vector<ObjectSlices> &result) const {
+  for (auto &o : _objects) {
+    result.push_back(slices[o.object]);
+  }
+}
+
+bool fast_path_plan::_resolve(const std::vector<alba_id_t> &alba_levels,
+                              size_t level, const std::string &namespace_,
+                              const ObjectSlices &object_slices) {
+  auto &alba_id = alba_levels[level];
+  auto mf = ManifestCache::getInstance().find(namespace_, alba_id,
+                                              object_slices.object_name);
+  if (mf == nullptr) {
+    ALBA_LOG(DEBUG, "manifest for alba_id=" << alba_id << ", obj_slices="
+                                            << object_slices << " not found");
+    return false;
+  }
+
+  if (level + 1 == alba_levels.size()) {
+    if (!resolve_slices(*mf, object_slices.slices, locations, _sorted)) {
+      ALBA_LOG(WARNING, "slices " << object_slices << " don't fit in "
+                                  << mf->name());
+      return false;
+    }
+    _location_manifests.resize(locations.size(), mf.get());
+    _manifests.push_back(std::move(mf));
+    return true;
+  }
+
+  // a fragment cache level: its fragments are objects one level down
+  std::vector<std::pair<byte *, Location>> level_locations;
+  if (!resolve_slices(*mf, object_slices.slices, level_locations)) {
+    ALBA_LOG(WARNING, "slices " << object_slices << " don't fit in "
+                                << mf->name());
+    return false;
+  }
+  for (auto &bl : level_locations) {
+    auto &l = bl.second;
+    llio::message_builder mb;
+    to(mb, l.object_id.to_string());
+    to(mb, l.chunk_id);
+    to(mb, l.fragment_id);
+    std::string fragment_cache_object_name = mb.as_string_no_size();
+    std::vector<SliceDescriptor> fragment_slices{
+        SliceDescriptor{bl.first, l.offset, l.length}};
+    ObjectSlices next{fragment_cache_object_name, fragment_slices};
+    ALBA_LOG(DEBUG, "fast_path_plan::_resolve: obj_slices=" << next);
+    if (!_resolve(alba_levels, level + 1, namespace_, next)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+size_t fast_path_plan::_buffer(size_t size) {
+  if (_n_buffers == _buffers.size()) {
+    _buffers.emplace_back();
+  }
+  _buffers[_n_buffers].resize(size);
+  return _n_buffers++;
+}
+
+bool fast_path_plan::_add_compressed(size_t location, size_t first_fragment) {
+  const Location &l = locations[location].second;
+  const CompactManifest &mf = *_location_manifests[location];
+  const std::string &key = _fragment_key(l);
+  // (locations of an object in the same fragment share its read)
+  for (size_t f = first_fragment; f < _fragments.size(); f++) {
+    if (*_fragments[f].key == key) {
+      _n_keys--;
+      _location_fragments[location] = f;
+      return true;
+    }
+  }
+
+  whole_fragment w{_iv_location(l, mf), &mf, &key, mf.compressor(), 0,
+                   DecompressedFragmentCache::getInstance().find(key)};
+  if (w.data == nullptr) {
+    if (l.fragment_location.first == boost::none) {
+      return false;
+    }
+    w.location.offset = 0;
+    w.location.length = mf.fragment_length(l.chunk_id, l.fragment_id);
+    w.buffer = _buffer(w.location.length);
+  }
+  _location_fragments[location] = _fragments.size();
+  _fragments.push_back(std::move(w));
+  return true;
+}
+
+bool fast_path_plan::_add_window(size_t location) {
+  const Location &l = locations[location].second;
+  if (l.fragment_location.first == boost::none) {
+    return false;
+  }
+  cbc_window w{location, _iv_location(l, *_location_manifests[location]),
+               &_fragment_key(l), 0, 0};
+  // (the fragment is padded up to a whole block, so the last one is there)
+  uint32_t end = l.offset + l.length;
+  w.blocks.offset = l.offset - l.offset % _CBC_BLOCK;
+  w.blocks.length = end + (_CBC_BLOCK - end % _CBC_BLOCK) % _CBC_BLOCK -
+                    w.blocks.offset;
+  w.iv_size = w.blocks.offset == 0 ? 0 : _CBC_BLOCK;
+  w.buffer = _buffer(w.iv_size + w.blocks.length);
+  _windows.push_back(w);
+  return true;
+}
+
+bool fast_path_plan::_add_rebuild(size_t location, bool second_read) {
+  const Location &l = locations[location].second;
+  const CompactManifest &mf = *_location_manifests[location];
+  auto es = mf.encoding_scheme();
+  // (compressed or CBC encrypted fragments can't be rebuilt by the range)
+  if (l.uses_compression || _cbc(l) || es.w != erasure::W8 || es.m == 0 ||
+      mf.n_fragments(l.chunk_id) != es.k + es.m) {
+    return false;
+  }
+
+  /* the fragments on osds that were read fine last time first, then the
+     ones on osds that weren't read yet. Osds that failed their last read
+     are left out. (data fragments before parity in both) */
+  _source_ids.clear();
+  for (int pass = 0; pass < 2 && _source_ids.size() < es.k; pass++) {
+    for (uint32_t f = 0; f < es.k + es.m && _source_ids.size() < es.k; f++) {
+      auto fl = mf.fragment_location(l.chunk_id, f);
+      if (f == l.fragment_id || fl.first == boost::none) {
+        continue;
+      }
+      auto it = osd_results.find(*fl.first);
+      bool known = it != osd_results.end();
+      if ((pass == 0 && known && it->second == 0) || (pass == 1 && !known)) {
+        _source_ids.push_back(f);
+      }
+    }
+  }
+  if (_source_ids.size() < es.k) {
+    return false;
+  }
+
+  _rebuilds.push_back(rebuild_info{location, _sources.size(), es.k,
+                                   _buffer((size_t)es.k * l.length),
+                                   second_read});
+  for (uint32_t f : _source_ids) {
+    Location source = l;
+    source.fragment_id = f;
+    source.fragment_location = mf.fragment_location(l.chunk_id, f);
+    source.ctr = mf.fragment_ctr_ref(l.chunk_id, f);
+    _sources.push_back(source);
+  }
+  ALBA_LOG(DEBUG, "fast_path_plan: fragment "
+                      << l.fragment_id << " of chunk " << l.chunk_id
+                      << " is rebuilt from " << es.k << " others");
+  return true;
+}
+
+void fast_path_plan::_read_rebuild(
+    const rebuild_info &r, std::map<osd_t, std::vector<asd_slice>> &osds) {
+  for (uint32_t i = 0; i < r.k; i++) {
+    const Location &source = _sources[r.first + i];
+    asd_slice slice{&_fragment_key(source), source.offset, source.length,
+                    &_buffers[r.buffer][i * source.length]};
+    osds[*source.fragment_location.first].push_back(slice);
+  }
+}
+
+bool fast_path_plan::_rebuild_results_ok(const rebuild_info &r) const {
+  auto &results = r.second_read ? rebuild_results : osd_results;
+  for (uint32_t i = 0; i < r.k; i++) {
+    auto it = results.find(*_sources[r.first + i].fragment_location.first);
+    if (it == results.end() || it->second != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// 'p' 0 'n' namespace_id 'o' object_id chunk_id fragment_id version_id
+const std::string &fast_path_plan::_fragment_key(const Location &l) {
+  if (l.object_id.data() != _prefix_object_id) {
+    _prefix.reset();
+    char instance_content_prefix = 'p';
+    _prefix.add_raw(&instance_content_prefix, 1);
+    uint32_t zero = 0;
+    to(_prefix, zero);
+    char namespace_char = 'n';
+    _prefix.add_raw(&namespace_char, 1);
+    alba::to_be(_prefix, l.namespace_id);
+    char object_char = 'o';
+    _prefix.add_raw(&object_char, 1);
+    uint32_t size = l.object_id.size();
+    to(_prefix, size);
+    _prefix.add_raw(l.object_id.data(), size);
+    _prefix_object_id = l.object_id.data();
+  }
+
+  if (_n_keys == _keys.size()) {
+    _keys.emplace_back();
+  }
+  std::string &key = _keys[_n_keys++];
+  _prefix.output_using([&key](const char *buffer, const int len) {
+    // (without the size)
+    key.assign(buffer + 4, len - 4);
+  });
+  _append(key, l.chunk_id);
+  _append(key, l.fragment_id);
+  _append(key, l.fragment_location.second);
+  return key;
+}
+}
+}
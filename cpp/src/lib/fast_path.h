@@ -0,0 +1,247 @@
+/*
+Copyright (C) 2016 iNuron NV
+
+This file is part of Open vStorage Open Source Edition (OSE), as available from
+
+
+    http://www.openvstorage.org and
+    http://www.openvstorage.com.
+
+This file is free software; you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License v3 (GNU AGPLv3)
+as published by the Free Software Foundation, in version 3 as it comes
+in the <LICENSE.txt> file of the Open vStorage OSE distribution.
+
+Open vStorage is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY of any kind.
+*/
+
+#pragma once
+#include "llio.h"
+#include "fragment_decompression.h"
+#include "location_resolver.h"
+#include "manifest_cache.h"
+#include "osd_access.h"
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace alba {
+namespace proxy_client {
+
+/* what the rora client's fast path does for one read_objects_slices:
+   the locations of the slices that can be read straight from the asds,
+   grouped per osd, and which objects have to go via the proxy instead.
+
+   A plan keeps everything it has from one build to the next: vectors are
+   cleared but not freed, osds stay in per_osd (with an empty vector)
+   and fragment keys are overwritten in place. So once a plan has seen a
+   read of some shape, building it again for such a read with all the
+   manifests in the cache doesn't allocate.
+   (with a single alba level that is: reading through a fragment cache
+    level builds the names of the objects one level down)
+
+   A location that can't be read from its own fragment (it has none, or
+   its osd failed) can be rebuilt from the same range of k other
+   fragments of its chunk (see reed_solomon.h). Fragments on osds that
+   were read without trouble are taken first, then the data fragments.
+
+   A fragment of an object with compression is read as a whole (there's
+   no telling where a range of it is before it's decompressed), once per
+   plan however many locations are in it. Its locations are filled in by
+   decompress, which keeps the fragment in the DecompressedFragmentCache.
+   When that has it already, nothing is read at all.
+
+   CBC decryption of a block needs the (encrypted) block before it, so a
+   location of a CBC encrypted object is read as the blocks it's in and
+   the one before those (the first block has the fragment's iv instead).
+   decrypt_windows decrypts those and fills in the location. Such a
+   location isn't rebuilt.
+   decrypt is called with a block aligned Location then, and (unless it
+   starts the fragment) the block before buf is the iv.
+
+   What's read as a whole fragment (a compressed one, or a location that
+   happens to be all of its fragment) can be checked against the
+   fragment's checksum in the manifest, which is over what's stored.
+   A fragment that doesn't match is left to the proxy.
+
+   When hedging, the locations on osds that were late aren't rebuilt:
+   those were read via the proxy already.
+
+   The locations and per_osd point into the plan (and the manifests it
+   holds on to), so they're good until the next build.
+   Not thread safe.
+*/
+class fast_path_plan {
+public:
+  fast_path_plan() = default;
+  fast_path_plan(const fast_path_plan &) = delete;
+  fast_path_plan &operator=(const fast_path_plan &) = delete;
+
+  // rebuild: locations without a fragment are rebuilt from others
+  // (if not, their objects go via the proxy)
+  void build(const std::vector<alba_id_t> &alba_levels,
+             const std::string &namespace_,
+             const std::vector<ObjectSlices> &slices, bool rebuild = false);
+
+  std::vector<std::pair<byte *, Location>> locations;
+  // (osds without anything to read in this plan have an empty vector)
+  std::map<osd_t, std::vector<asd_slice>> per_osd;
+  // indexes (in build's slices) of the objects that go via the proxy
+  std::vector<size_t> via_proxy;
+  // how the read from each osd went (see OsdAccess::read_osds_slices)
+  std::map<osd_t, int> osd_results;
+
+  // the location was read (osd_results has 0 for its osd)
+  bool read_ok(const Location &) const;
+
+  // the location (by index) was read straight into its target
+  // (it still has to be decrypted)
+  bool direct(size_t i) const;
+
+  /* checks the locations read straight into their target that are all
+     of their fragment against its checksum (before they're decrypted).
+     Those that don't match aren't direct anymore. returns how many
+     didn't match. */
+  size_t verify_direct();
+
+  /* after a read where some osds failed: plans rebuilds for the locations
+     on those osds (that don't have one yet), from fragments on osds that
+     didn't fail. What they need is in rebuild_per_osd, the read of which
+     goes in rebuild_results. false if there's nothing to read. */
+  bool plan_rebuilds();
+  std::map<osd_t, std::vector<asd_slice>> rebuild_per_osd;
+  std::map<osd_t, int> rebuild_results;
+
+  /* rebuilds the locations whose fragments could all be read, decrypt is
+     called on each of those first (with the location of the fragment).
+     returns how many were rebuilt. (once per read) */
+  size_t rebuild(const std::function<void(byte *, const Location &)> &decrypt);
+
+  /* decrypts and decompresses the compressed fragments that could be
+     read, and fills in their locations (and those of the fragments that
+     were in the cache). returns how many locations were filled in.
+     verify: fragments that were read are checked against their checksum
+     first. */
+  size_t
+  decompress(const std::function<void(byte *, const Location &)> &decrypt,
+             bool verify = false);
+
+  /* decrypts the blocks read for the CBC encrypted locations that could
+     be read, and fills them in. returns how many were filled in. */
+  size_t decrypt_windows(
+      const std::function<void(byte *, const Location &)> &decrypt);
+
+  // the location (by index) was read, rebuilt, decompressed or decrypted
+  bool done(size_t i) const { return _filled[i] || direct(i); }
+
+  /* after a read where some osds failed: the slices (of build's slices)
+     with a piece on such an osd that wasn't rebuilt, per object. Those
+     are to be read via the proxy, the others are filled in already. */
+  void failed_slices(const std::vector<ObjectSlices> &slices,
+                     std::vector<ObjectSlices> &result) const;
+
+  // the slices (of build's slices) with a piece that needs a read from one
+  // of osds, per object (what to hedge with the proxy when they're late)
+  void slices_on(const std::vector<osd_t> &osds,
+                 const std::vector<ObjectSlices> &slices,
+                 std::vector<ObjectSlices> &result) const;
+
+  // the objects (of build's slices) that were to be read from the asds
+  void direct_slices(const std::vector<ObjectSlices> &slices,
+                     std::vector<ObjectSlices> &result) const;
+
+private:
+  // the objects that have their locations in locations[first .. last[
+  struct object_locations {
+    size_t object;
+    size_t first;
+    size_t last;
+  };
+  std::vector<object_locations> _objects;
+  // per location: its manifest, and whether it was filled in otherwise
+  // than by a read straight into its target
+  std::vector<const CompactManifest *> _location_manifests;
+  std::vector<bool> _filled;
+  // per location: read straight into its target, but its fragment
+  // doesn't match its checksum
+  std::vector<bool> _corrupt;
+
+  // a compressed fragment, read whole (location) into buffer, unless
+  // the cache had it (data)
+  struct whole_fragment {
+    Location location;
+    const CompactManifest *manifest;
+    const std::string *key;
+    compressor_t compressor;
+    size_t buffer;
+    decompressed_fragment data;
+  };
+  std::vector<whole_fragment> _fragments;
+  // per location: its index in _fragments (NONE if it's not compressed)
+  std::vector<size_t> _location_fragments;
+  static const size_t NONE = (size_t)-1;
+
+  // location is read with its blocks (read into buffer, after iv_size
+  // bytes of the block before them)
+  struct cbc_window {
+    size_t location;
+    Location blocks;
+    const std::string *key;
+    size_t buffer;
+    uint32_t iv_size;
+  };
+  std::vector<cbc_window> _windows;
+
+  // location is rebuilt from k fragments: _sources[first .. first + k[,
+  // read into buffer (one after the other)
+  struct rebuild_info {
+    size_t location;
+    size_t first;
+    uint32_t k;
+    size_t buffer;
+    bool second_read;
+  };
+  std::vector<rebuild_info> _rebuilds;
+  std::vector<Location> _sources;
+  // buffers, _buffers[0 .. _n_buffers[ are in use
+  std::deque<std::vector<byte>> _buffers;
+  size_t _n_buffers = 0;
+  std::vector<uint8_t> _coefficients;
+  std::vector<uint32_t> _source_ids;
+  std::vector<const byte *> _inputs;
+
+  // the manifests the locations point into
+  std::vector<manifest_cache_entry> _manifests;
+  std::vector<const SliceDescriptor *> _sorted;
+
+  // fragment keys, _keys[0 .. _n_keys[ are in use
+  std::deque<std::string> _keys;
+  size_t _n_keys = 0;
+  // the start of the fragment keys of the object the last key was for
+  llio::message_builder _prefix;
+  const char *_prefix_object_id = nullptr;
+
+  bool _resolve(const std::vector<alba_id_t> &alba_levels, size_t level,
+                const std::string &namespace_,
+                const ObjectSlices &object_slices);
+  const std::string &_fragment_key(const Location &);
+  // the index of a buffer (from _buffers) of size bytes
+  size_t _buffer(size_t size);
+  bool _add_compressed(size_t location, size_t first_fragment);
+  bool _add_window(size_t location);
+  bool _add_rebuild(size_t location, bool second_read);
+  void _read_rebuild(const rebuild_info &,
+                     std::map<osd_t, std::vector<asd_slice>> &);
+  bool _rebuild_results_ok(const rebuild_info &) const;
+  // the location's osd was late, and the proxy read what was on it
+  bool _late(const Location &) const;
+  void _slices_with(const std::vector<ObjectSlices> &slices,
+                    std::vector<ObjectSlices> &result,
+                    const std::function<bool(size_t)> &location_pred) const;
+};
+}
+}
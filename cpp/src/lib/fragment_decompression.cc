@@ -0,0 +1,154 @@
+/*
+Copyright (C) 2016 iNuron NV
+
+This file is part of Open vStorage Open Source Edition (OSE), as available from
+
+
+    http://www.openvstorage.org and
+    http://www.openvstorage.com.
+
+This file is free software; you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License v3 (GNU AGPLv3)
+as published by the Free Software Foundation, in version 3 as it comes
+in the <LICENSE.txt> file of the Open vStorage OSE distribution.
+
+Open vStorage is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY of any kind.
+*/
+
+#include "fragment_decompression.h"
+#include "alba_logger.h"
+#include "snappy.h"
+#include <bzlib.h>
+#include <string.h>
+
+namespace alba {
+namespace proxy_client {
+
+namespace {
+// the cache is limited in bytes, this only bounds its index
+const size_t _MAX_ENTRIES = 1 << 20;
+
+bool _too_large(size_t length, size_t max_size) {
+  if (length > max_size) {
+    ALBA_LOG(WARNING, "fragment says it's " << length
+                                            << " bytes decompressed, not "
+                                            << max_size << " at most");
+    return true;
+  }
+  return false;
+}
+
+bool _snappy(const byte *data, size_t size, size_t max_size,
+             std::vector<byte> &result) {
+  size_t length;
+  if (!snappy::GetUncompressedLength((const char *)data, size, &length) ||
+      _too_large(length, max_size)) {
+    return false;
+  }
+  result.resize(length);
+  return snappy::RawUncompress((const char *)data, size,
+                               (char *)result.data());
+}
+
+bool _bzip2(const byte *data, size_t size, size_t max_size,
+            std::vector<byte> &result) {
+  uint32_t length;
+  if (size < sizeof(length)) {
+    return false;
+  }
+  memcpy(&length, data, sizeof(length));
+  if (_too_large(length, max_size)) {
+    return false;
+  }
+  result.resize(length);
+  unsigned int result_length = length;
+  int rc = BZ2_bzBuffToBuffDecompress(
+      (char *)result.data(), &result_length,
+      (char *)(data + sizeof(length)), size - sizeof(length), 0, 0);
+  if (rc != BZ_OK) {
+    ALBA_LOG(DEBUG, "BZ2_bzBuffToBuffDecompress returned " << rc);
+    return false;
+  }
+  return result_length == length;
+}
+
+// hash of the key, as manifest_cache_hash does it (FNV-1a)
+uint64_t _hash(const std::string &key) {
+  uint64_t h = 14695981039346656037ULL;
+  for (unsigned char c : key) {
+    h ^= c;
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+}
+
+bool decompress_fragment(compressor_t compressor, const byte *data,
+                         size_t size, size_t max_size,
+                         std::vector<byte> &result) {
+  const size_t test_header = 8;
+  switch (compressor) {
+  case compressor_t::NO_COMPRESSION:
+    result.assign(data, data + size);
+    return true;
+  case compressor_t::SNAPPY:
+    return _snappy(data, size, max_size, result);
+  case compressor_t::BZIP2:
+    return _bzip2(data, size, max_size, result);
+  case compressor_t::TEST:
+    return size >= test_header &&
+           _bzip2(data + test_header, size - test_header, max_size, result);
+  }
+  return false;
+}
+
+DecompressedFragmentCache &DecompressedFragmentCache::getInstance() {
+  static DecompressedFragmentCache instance;
+  return instance;
+}
+
+DecompressedFragmentCache::DecompressedFragmentCache()
+    : _cache(_MAX_ENTRIES) {}
+
+void DecompressedFragmentCache::set_capacity(size_t max_bytes) {
+  std::lock_guard<std::mutex> g(_mutex);
+  _max_bytes = max_bytes;
+  while (_cache.weight() > max_bytes) {
+    _cache.pop_lru();
+  }
+}
+
+decompressed_fragment
+DecompressedFragmentCache::find(const std::string &key) {
+  if (_max_bytes == 0) {
+    return nullptr;
+  }
+  std::lock_guard<std::mutex> g(_mutex);
+  auto r = _cache.find(_hash(key),
+                       [&key](const std::string &k) { return k == key; });
+  if (r == boost::none) {
+    return nullptr;
+  }
+  return *r;
+}
+
+void DecompressedFragmentCache::add(const std::string &key,
+                                    decompressed_fragment fragment) {
+  size_t weight = fragment->size() + key.size();
+  std::lock_guard<std::mutex> g(_mutex);
+  if (weight > _max_bytes) {
+    return;
+  }
+  _cache.insert(_hash(key), std::string(key), fragment, weight);
+  while (_cache.weight() > _max_bytes) {
+    _cache.pop_lru();
+  }
+}
+
+size_t DecompressedFragmentCache::bytes() {
+  std::lock_guard<std::mutex> g(_mutex);
+  return _cache.weight();
+}
+}
+}
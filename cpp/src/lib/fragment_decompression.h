@@ -0,0 +1,83 @@
+/*
+Copyright (C) 2016 iNuron NV
+
+This file is part of Open vStorage Open Source Edition (OSE), as available from
+
+
+    http://www.openvstorage.org and
+    http://www.openvstorage.com.
+
+This file is free software; you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License v3 (GNU AGPLv3)
+as published by the Free Software Foundation, in version 3 as it comes
+in the <LICENSE.txt> file of the Open vStorage OSE distribution.
+
+Open vStorage is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY of any kind.
+*/
+
+#pragma once
+#include "lru_cache.h"
+#include "manifest.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace alba {
+namespace proxy_client {
+
+using namespace proxy_protocol;
+
+/* the fragments of an object with compression are compressed one by one
+   (before they're encrypted), as the ocaml side's Compressors has it:
+   - Snappy: a raw snappy block
+   - Bzip2: the uncompressed length (4 bytes, little endian), then the
+     bzip2 stream
+   - Test: 8 bytes (a timestamp), then the same as Bzip2
+   false if data isn't that, or if it says it's more than max_size bytes
+   decompressed (the fragment's share of its chunk): the length comes
+   from the fragment's bytes, so it's checked before anything is
+   allocated for it. (NO_COMPRESSION is a plain copy)
+*/
+bool decompress_fragment(compressor_t, const byte *data, size_t size,
+                         size_t max_size, std::vector<byte> &result);
+
+typedef std::shared_ptr<const std::vector<byte>> decompressed_fragment;
+
+/* decompressed fragments, so reading a slice of a compressed fragment
+   after another one doesn't cost a read of the whole fragment (and its
+   decompression) again. Keyed on the fragment's key on its asd, which
+   has the version in it: a fragment that's written again is another one.
+   One for the process, like the manifest cache, an LRU within a byte
+   budget. Thread safe.
+*/
+class DecompressedFragmentCache {
+public:
+  static DecompressedFragmentCache &getInstance();
+
+  // 0 turns it off (what's in it is dropped)
+  void set_capacity(size_t max_bytes);
+
+  DecompressedFragmentCache(DecompressedFragmentCache const &) = delete;
+  void operator=(DecompressedFragmentCache const &) = delete;
+
+  // nullptr if it isn't there
+  decompressed_fragment find(const std::string &key);
+  // (a fragment larger than the whole budget isn't kept)
+  void add(const std::string &key, decompressed_fragment);
+
+  size_t bytes();
+
+private:
+  DecompressedFragmentCache();
+
+  typedef ovs::HashedLRUCache<std::string, decompressed_fragment> cache;
+
+  std::mutex _mutex;
+  cache _cache;
+  std::atomic<size_t> _max_bytes{64 << 20};
+};
+}
+}
@@ -47,8 +47,8 @@ void GenericProxy_client::init_() {
   int32_t magic{1148837403};
   int32_t version{1};
 
-  _transport->write_exact((const char *)(&magic), 4);
-  _transport->write_exact((const char *)(&version), 4);
+  struct iovec iov[] = {{&magic, 4}, {&version, 4}};
+  _transport->write_iov(iov, 2);
 
   _transport->expires_from_now(std::chrono::steady_clock::duration::max());
 }
@@ -225,8 +225,7 @@ void GenericProxy_client::read_objects_slices(
       _mb, namespace_, slices, BooleanEnumTrue(consistent_read));
   _output();
 
-  message response = _input();
-  proxy_protocol::read_read_objects_slices_response(response, _status, slices);
+  _read_objects_slices_response(slices, nullptr);
   cntr.slow_path += slices.size();
 
   check_status(__PRETTY_FUNCTION__);
@@ -248,14 +247,90 @@ void GenericProxy_client::read_objects_slices2(
       _mb, namespace_, slices, BooleanEnumTrue(consistent_read));
   _output();
 
-  message response = _input();
-  proxy_protocol::read_read_objects_slices2_response(response, _status, slices,
-                                                     object_infos);
+  _read_objects_slices_response(slices, [&object_infos](message &m) {
+    proxy_protocol::read_read_objects_slices2_response_tail(m, object_infos);
+  });
+  cntr.slow_path += slices.size();
+
+  check_status(__PRETTY_FUNCTION__);
+}
+
+void GenericProxy_client::read_objects_slices2(
+    const string &namespace_,
+    const vector<proxy_protocol::ObjectSlices> &slices,
+    const consistent_read consistent_read,
+    vector<proxy_protocol::encoded_object_info> &object_infos,
+    alba::statistics::RoraCounter &cntr) {
+
+  if (slices.size() == 0) {
+    return;
+  }
+  _expires_from_now(_timeout);
+
+  proxy_protocol::write_read_objects_slices2_request(
+      _mb, namespace_, slices, BooleanEnumTrue(consistent_read));
+  _output();
+
+  _read_objects_slices_response(slices, [&object_infos](message &m) {
+    proxy_protocol::read_read_objects_slices2_response_tail(m, object_infos);
+  });
   cntr.slow_path += slices.size();
 
   check_status(__PRETTY_FUNCTION__);
 }
 
+void GenericProxy_client::_read_objects_slices_response(
+    const vector<proxy_protocol::ObjectSlices> &slices,
+    const std::function<void(message &)> &read_object_infos) {
+  using proxy_protocol::READ_OBJECTS_SLICES_HEADER_SIZE;
+  char header[4 + READ_OBJECTS_SLICES_HEADER_SIZE];
+  _transport->read_exact(header, sizeof(header));
+  uint32_t message_size;
+  memcpy(&message_size, header, 4);
+  int64_t data_size =
+      proxy_protocol::read_read_objects_slices_response_header(&header[4]);
+
+  uint64_t slices_size = 0;
+  for (auto &object_slices : slices) {
+    for (auto &slice : object_slices.slices) {
+      slices_size += slice.size;
+    }
+  }
+
+  if (data_size >= 0 && (uint64_t)data_size == slices_size &&
+      message_size >= READ_OBJECTS_SLICES_HEADER_SIZE + data_size) {
+    // the slice data goes straight to the caller's buffers,
+    // only what comes after it is buffered.
+    uint32_t tail_size =
+        message_size - READ_OBJECTS_SLICES_HEADER_SIZE - data_size;
+    auto tail = llio::message_buffer::with_size(tail_size);
+    _iov.clear();
+    for (auto &object_slices : slices) {
+      for (auto &slice : object_slices.slices) {
+        _iov.push_back({slice.buf, slice.size});
+      }
+    }
+    _iov.push_back({tail->data(0), tail_size});
+    _transport->read_iov(_iov.data(), _iov.size());
+
+    _status.set_rc(0);
+    if (read_object_infos) {
+      message m(tail);
+      read_object_infos(m);
+    }
+  } else {
+    auto buffer = llio::message_buffer::with_size(message_size);
+    memcpy(buffer->data(0), &header[4], READ_OBJECTS_SLICES_HEADER_SIZE);
+    _transport->read_exact(buffer->data(READ_OBJECTS_SLICES_HEADER_SIZE),
+                           message_size - READ_OBJECTS_SLICES_HEADER_SIZE);
+    message m(buffer);
+    proxy_protocol::read_read_objects_slices_response(m, _status, slices);
+    if (_status.is_ok() && read_object_infos) {
+      read_object_infos(m);
+    }
+  }
+}
+
 void GenericProxy_client::write_object_fs2(
     const string &namespace_, const string &object_name,
     const string &input_file, const allow_overwrite allow_overwrite,
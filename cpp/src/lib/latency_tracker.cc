@@ -0,0 +1,130 @@
+/*
+Copyright (C) 2016 iNuron NV
+
+This file is part of Open vStorage Open Source Edition (OSE), as available from
+
+
+    http://www.openvstorage.org and
+    http://www.openvstorage.com.
+
+This file is free software; you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License v3 (GNU AGPLv3)
+as published by the Free Software Foundation, in version 3 as it comes
+in the <LICENSE.txt> file of the Open vStorage OSE distribution.
+
+Open vStorage is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY of any kind.
+*/
+
+#include "latency_tracker.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace alba {
+namespace asd {
+
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+
+namespace {
+const uint64_t _MIN_SAMPLES = 16;
+const uint32_t _DECAY = 1024;
+const double _BUCKETS_PER_DOUBLING = 4;
+
+double _us(latency_tracker::duration d) {
+  return duration_cast<std::chrono::duration<double, std::micro>>(d).count();
+}
+
+latency_tracker::duration _from_us(double us) {
+  return duration_cast<latency_tracker::duration>(
+      std::chrono::duration<double, std::micro>(us));
+}
+
+// bucket 0 is below 1us, bucket i > 0 ends at 2^(i/4) us
+size_t _bucket(double us, size_t n_buckets) {
+  if (us < 1) {
+    return 0;
+  }
+  double i = std::floor(_BUCKETS_PER_DOUBLING * std::log2(us)) + 1;
+  return std::min((size_t)i, n_buckets - 1);
+}
+
+double _bucket_end(size_t i) {
+  return std::exp2(i / _BUCKETS_PER_DOUBLING);
+}
+}
+
+latency_tracker::latency_tracker(duration initial, duration floor,
+                                 duration ceiling)
+    : _initial(initial), _floor(floor), _ceiling(std::max(floor, ceiling)) {}
+
+void latency_tracker::add(duration sample) {
+  double us = _us(sample);
+  if (_samples == 0) {
+    _ewma = us;
+    _deviation = us / 2;
+  } else {
+    _deviation = 0.75 * _deviation + 0.25 * std::fabs(_ewma - us);
+    _ewma = 0.875 * _ewma + 0.125 * us;
+  }
+  _samples++;
+
+  _buckets[_bucket(us, _N_BUCKETS)]++;
+  _in_buckets++;
+  if (_in_buckets >= _DECAY) {
+    _in_buckets = 0;
+    for (auto &b : _buckets) {
+      // (rounding up, so the tail isn't forgotten all at once)
+      b = (b + 1) / 2;
+      _in_buckets += b;
+    }
+  }
+}
+
+double latency_tracker::_percentile(double q) const {
+  if (_in_buckets == 0) {
+    return 0;
+  }
+  uint32_t wanted = std::max(1u, (uint32_t)std::ceil(q * _in_buckets));
+  uint32_t seen = 0;
+  for (size_t i = 0; i < _N_BUCKETS; i++) {
+    seen += _buckets[i];
+    if (seen >= wanted) {
+      return _bucket_end(i);
+    }
+  }
+  return _bucket_end(_N_BUCKETS - 1);
+}
+
+latency_tracker::duration latency_tracker::timeout() const {
+  if (_samples < _MIN_SAMPLES) {
+    return _initial;
+  }
+  double us = 2 * std::max(_percentile(0.99), _ewma + 4 * _deviation);
+  return std::min(_ceiling, std::max(_floor, _from_us(us)));
+}
+
+latency_tracker::duration latency_tracker::percentile(double q) const {
+  if (_samples < _MIN_SAMPLES) {
+    return timeout();
+  }
+  return std::min(timeout(), _from_us(_percentile(q)));
+}
+
+latency_estimate latency_tracker::estimate() const {
+  return latency_estimate{_from_us(_ewma), _from_us(_deviation),
+                          _from_us(_percentile(0.99)), timeout(), _samples};
+}
+
+std::ostream &operator<<(std::ostream &os, const latency_estimate &e) {
+  os << "latency_estimate{ ewma= "
+     << duration_cast<microseconds>(e.ewma).count()
+     << "us, deviation= " << duration_cast<microseconds>(e.deviation).count()
+     << "us, p99= " << duration_cast<microseconds>(e.p99).count()
+     << "us, timeout= " << duration_cast<microseconds>(e.timeout).count()
+     << "us, samples= " << e.samples << " }";
+  return os;
+}
+}
+}
@@ -0,0 +1,143 @@
+/*
+Copyright (C) 2016 iNuron NV
+
+This file is part of Open vStorage Open Source Edition (OSE), as available from
+
+
+    http://www.openvstorage.org and
+    http://www.openvstorage.com.
+
+This file is free software; you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License v3 (GNU AGPLv3)
+as published by the Free Software Foundation, in version 3 as it comes
+in the <LICENSE.txt> file of the Open vStorage OSE distribution.
+
+Open vStorage is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY of any kind.
+*/
+
+#include "location_resolver.h"
+#include <algorithm>
+
+namespace alba {
+namespace proxy_client {
+
+namespace {
+struct piece {
+  uint32_t chunk;
+  uint32_t fragment;
+  uint32_t offset;
+  uint32_t length;
+};
+
+// pos must lie in chunk
+piece _piece(const CompactManifest &mf, uint32_t chunk, uint32_t k,
+             uint64_t pos, uint64_t len) {
+  uint32_t fragment_length = mf.chunk_size(chunk) / k;
+  uint32_t pos_in_chunk = pos - mf.chunk_offset(chunk);
+  uint32_t fragment = pos_in_chunk / fragment_length;
+  uint32_t offset = pos_in_chunk - fragment * fragment_length;
+  uint32_t length = std::min(len, (uint64_t)(fragment_length - offset));
+  return piece{chunk, fragment, offset, length};
+}
+
+Location _location(const CompactManifest &mf, boost::string_ref object_id,
+                   const piece &p) {
+  Location l;
+  l.namespace_id = mf.namespace_id();
+  l.object_id = object_id;
+  l.chunk_id = p.chunk;
+  l.fragment_id = p.fragment;
+  l.fragment_location = mf.fragment_location(p.chunk, p.fragment);
+  l.offset = p.offset;
+  l.length = p.length;
+  l.uses_compression = mf.compressor() != compressor_t::NO_COMPRESSION;
+  l.encrypt_info = mf.encrypt_info().get();
+  l.ctr = mf.fragment_ctr_ref(p.chunk, p.fragment);
+  return l;
+}
+}
+
+Location get_location(const CompactManifest &mf, uint64_t pos, uint32_t len) {
+  uint32_t chunk = mf.chunk_at(pos);
+  return _location(mf, mf.object_id_ref(),
+                   _piece(mf, chunk, mf.encoding_scheme().k, pos, len));
+}
+
+bool resolve_slices(const CompactManifest &mf,
+                    const std::vector<SliceDescriptor> &slices,
+                    std::vector<std::pair<byte *, Location>> &results) {
+  std::vector<const SliceDescriptor *> sorted;
+  return resolve_slices(mf, slices, results, sorted);
+}
+
+bool resolve_slices(const CompactManifest &mf,
+                    const std::vector<SliceDescriptor> &slices,
+                    std::vector<std::pair<byte *, Location>> &results,
+                    std::vector<const SliceDescriptor *> &sorted) {
+  uint64_t object_size = mf.chunk_offset(mf.n_chunks());
+  sorted.clear();
+  sorted.reserve(slices.size());
+  for (auto &slice : slices) {
+    if (slice.offset > object_size ||
+        slice.size > object_size - slice.offset) {
+      return false;
+    }
+    sorted.push_back(&slice);
+  }
+  // stable (sorted starts out in slices' order), but unlike stable_sort
+  // this doesn't need a temporary buffer
+  std::sort(sorted.begin(), sorted.end(),
+            [](const SliceDescriptor *a, const SliceDescriptor *b) {
+              return a->offset < b->offset || (a->offset == b->offset && a < b);
+            });
+
+  const size_t first = results.size();
+  const uint32_t k = mf.encoding_scheme().k;
+  const boost::string_ref object_id = mf.object_id_ref();
+  uint32_t chunk = 0;
+  const SliceDescriptor *previous = nullptr;
+  for (auto *slice : sorted) {
+    if (previous != nullptr && previous->offset == slice->offset &&
+        previous->size == slice->size && previous->buf == slice->buf) {
+      continue;
+    }
+    previous = slice;
+    uint64_t pos = slice->offset;
+    uint64_t len = slice->size;
+    byte *target = slice->buf;
+    while (len > 0) {
+      if (pos >= mf.chunk_offset(chunk + 1)) {
+        // usually the next one
+        chunk++;
+        if (pos >= mf.chunk_offset(chunk + 1)) {
+          chunk = mf.chunk_at(pos);
+        }
+      } else if (pos < mf.chunk_offset(chunk)) {
+        // (overlaps can go back a bit)
+        chunk = mf.chunk_at(pos);
+      }
+      piece p = _piece(mf, chunk, k, pos, len);
+      bool coalesced = false;
+      if (results.size() > first) {
+        auto &last = results.back();
+        Location &l = last.second;
+        if (l.chunk_id == p.chunk && l.fragment_id == p.fragment &&
+            l.offset + l.length == p.offset &&
+            last.first + l.length == target) {
+          l.length += p.length;
+          coalesced = true;
+        }
+      }
+      if (!coalesced) {
+        results.emplace_back(target, _location(mf, object_id, p));
+      }
+      pos += p.length;
+      len -= p.length;
+      target += p.length;
+    }
+  }
+  return true;
+}
+}
+}
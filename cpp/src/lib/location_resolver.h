@@ -0,0 +1,53 @@
+/*
+Copyright (C) 2016 iNuron NV
+
+This file is part of Open vStorage Open Source Edition (OSE), as available from
+
+
+    http://www.openvstorage.org and
+    http://www.openvstorage.com.
+
+This file is free software; you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License v3 (GNU AGPLv3)
+as published by the Free Software Foundation, in version 3 as it comes
+in the <LICENSE.txt> file of the Open vStorage OSE distribution.
+
+Open vStorage is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY of any kind.
+*/
+
+#pragma once
+#include "compact_manifest.h"
+#include "proxy_protocol.h"
+#include <utility>
+#include <vector>
+
+namespace alba {
+namespace proxy_client {
+
+using namespace proxy_protocol;
+
+// where the len bytes (or the first part of them) at pos in the object are
+Location get_location(const CompactManifest &mf, uint64_t pos, uint32_t len);
+
+/* appends the locations of all the slices of one object to results.
+   The slices are visited in offset order, so finding the next chunk is a
+   step forward in the manifest's chunk index (or a binary search on it
+   for a jump). Consecutive pieces in one fragment that also follow each
+   other in the target buffer become one Location. Overlapping slices are
+   fine: identical ones are resolved once, the others each get their
+   locations and the osd read plan merges what's read twice.
+   Returns false (and leaves results as they were) if a slice doesn't
+   fit in the object.
+*/
+bool resolve_slices(const CompactManifest &mf,
+                    const std::vector<SliceDescriptor> &slices,
+                    std::vector<std::pair<byte *, Location>> &results);
+
+// the same, with the room to sort the slices in passed in (and reused)
+bool resolve_slices(const CompactManifest &mf,
+                    const std::vector<SliceDescriptor> &slices,
+                    std::vector<std::pair<byte *, Location>> &results,
+                    std::vector<const SliceDescriptor *> &sorted);
+}
+}
@@ -15,113 +15,272 @@
 
 #pragma once
 
-#include <boost/bimap.hpp>
-#include <boost/bimap/list_of.hpp>
-#include <boost/bimap/set_of.hpp>
-#include <boost/bimap/unordered_set_of.hpp>
+#include <algorithm>
+#include <atomic>
 #include <boost/optional.hpp>
-#include <mutex>
-/*
-nicked from volumedriver's LRUCacheToo, but
-
-- changed namespace
-- removed VERIFY & logging
-- removed name attribute
-- removed include sandwich and replaced with #pragma once
-- changed the name
-- added a safe version
-*/
+#include <list>
+#include <stdexcept>
+#include <unordered_map>
+
 namespace ovs {
 
-// This LRU cache contains objects whereas the other one (LRUCache.h) references
-// to objects (e.g. files on disk) which require special steps on eviction
-// (remove the file).
-// Better naming suggestions / ideas for unification welcome.
-template <typename K, typename V,
-          template <typename...> class Set = boost::bimaps::unordered_set_of>
-class UnsafeLRUCache {
+enum class eviction_policy {
+  LRU,
+  // 2Q (Johnson & Shasha): new entries go to a small FIFO and only move to
+  // the main LRU when they're asked for again after having been pushed out
+  // of it (remembered in a ghost queue of hashes). A sequential scan then
+  // only churns the FIFO and leaves the hot set alone.
+  TWO_Q
+};
+
+// LRU (or 2Q) on a precomputed hash. Entries with the same hash are told
+// apart by a predicate on the key, so a lookup doesn't need to build a K
+// (nor allocate).
+// Every entry carries a weight (1 by default); the sum is kept in weight().
+// Given a clock, shared by several caches, entries are stamped with it
+// whenever they go to the back of the line, so victim_stamp() tells which
+// of those caches holds the coldest entry.
+// Not thread safe (apart from the clock).
+template <typename K, typename V> class HashedLRUCache {
 public:
-  UnsafeLRUCache( // const std::string& name,
-      size_t capacity)
-      : capacity_(capacity) {
+  HashedLRUCache(size_t capacity,
+                 eviction_policy policy = eviction_policy::LRU,
+                 std::atomic<uint64_t> *clock = nullptr)
+      : capacity_(capacity), policy_(policy), clock_(clock),
+        probation_capacity_(std::max((size_t)1, capacity / 4)),
+        ghost_capacity_(std::max((size_t)1, capacity / 2)) {
     if (capacity_ == 0) {
-      throw std::logic_error("UnsafeLRUCache capacity should be > 0");
+      throw std::logic_error("HashedLRUCache capacity should be > 0");
     }
   }
 
-  ~UnsafeLRUCache() = default;
+  HashedLRUCache(const HashedLRUCache &) = delete;
 
-  UnsafeLRUCache(const UnsafeLRUCache &) = delete;
+  HashedLRUCache &operator=(const HashedLRUCache &) = delete;
 
-  UnsafeLRUCache &operator=(const UnsafeLRUCache &) = delete;
-
-  boost::optional<V> find(const K &k) {
-    auto it = bimap_.left.find(k);
-    if (it != bimap_.left.end()) {
-      bimap_.right.relocate(bimap_.right.end(), bimap_.project_right(it));
-      return it->second;
-    } else {
+  template <typename Eq> boost::optional<V> find(uint64_t hash, Eq &&eq) {
+    auto it = find_(hash, eq);
+    if (it == index_.end()) {
       return boost::none;
     }
+    touch_(it->second);
+    return it->second->value;
   }
 
-  void insert(const K &k, const V &v) {
-    if (bimap_.size() >= capacity_) {
-      bimap_.right.erase(bimap_.right.begin());
+  void insert(uint64_t hash, K &&k, const V &v, size_t weight = 1) {
+    auto it = find_(hash, [&k](const K &k2) { return k == k2; });
+    if (it != index_.end()) {
+      auto &e = *it->second;
+      weight_ = weight_ - e.weight + weight;
+      e.value = v;
+      e.weight = weight;
+      touch_(it->second);
+      return;
     }
-
-    auto r(bimap_.insert(typename Bimap::value_type(k, v)));
-    if (not r.second) {
-      bimap_.left.erase(k);
-      r = bimap_.insert(typename Bimap::value_type(k, v));
+    if (size() >= capacity_) {
+      pop_lru();
     }
+    bool to_main = true;
+    if (policy_ == eviction_policy::TWO_Q) {
+      auto g = ghost_index_.find(hash);
+      if (g == ghost_index_.end()) {
+        to_main = false;
+      } else {
+        ghost_.erase(g->second);
+        ghost_index_.erase(g);
+      }
+    }
+    Lru &lru = to_main ? main_ : probation_;
+    lru.push_back(
+        entry{hash, std::move(k), v, weight, to_main, false, tick_()});
+    index_.emplace(hash, std::prev(lru.end()));
+    weight_ += weight;
   }
 
-  bool erase(const K &k) { return bimap_.left.erase(k); }
+  // drops the entry that's next in line to go, returns its weight
+  size_t pop_lru() {
+    if (empty()) {
+      return 0;
+    }
+    bool from_probation = victim_in_probation_();
+    auto it = from_probation ? probation_.begin() : main_.begin();
+    size_t w = it->weight;
+    if (from_probation && !it->demoted &&
+        policy_ == eviction_policy::TWO_Q) {
+      remember_(it->hash);
+    }
+    erase_(it);
+    return w;
+  }
 
-  std::vector<K> keys() const {
-    std::vector<K> keys;
-    keys.reserve(bimap_.size());
+  template <typename Eq> bool erase(uint64_t hash, Eq &&eq) {
+    auto it = find_(hash, eq);
+    if (it == index_.end()) {
+      return false;
+    }
+    auto lit = it->second;
+    index_.erase(it);
+    unlink_(lit);
+    return true;
+  }
 
-    for (const auto &v : bimap_.right) {
-      keys.push_back(v.second);
+  // everything currently in here is evicted before anything else, unless
+  // it's asked for again.
+  void demote_all() {
+    for (auto *lru : {&main_, &probation_}) {
+      for (auto &e : *lru) {
+        if (!e.demoted) {
+          e.demoted = true;
+          demoted_++;
+        }
+        e.in_main = false;
+      }
     }
+    probation_.splice(probation_.begin(), main_);
+  }
 
-    return keys;
+  // from the most to the least valuable entry
+  template <typename F> void visit(F &&f) const {
+    for (auto *lru : {&main_, &probation_}) {
+      for (auto it = lru->rbegin(); it != lru->rend(); ++it) {
+        if (!f(it->key, it->value)) {
+          return;
+        }
+      }
+    }
   }
 
-  void clear() { bimap_.clear(); }
+  void clear() {
+    index_.clear();
+    main_.clear();
+    probation_.clear();
+    ghost_index_.clear();
+    ghost_.clear();
+    weight_ = 0;
+    demoted_ = 0;
+  }
 
-  bool empty() const { return bimap_.empty(); }
+  bool empty() const { return main_.empty() && probation_.empty(); }
 
-  size_t size() const { return bimap_.size(); }
+  size_t size() const { return main_.size() + probation_.size(); }
 
   size_t capacity() const { return capacity_; }
 
+  size_t weight() const { return weight_; }
+
+  size_t demoted() const { return demoted_; }
+
+  // clock stamp of the entry pop_lru would drop (UINT64_MAX when empty)
+  uint64_t victim_stamp() const {
+    if (empty()) {
+      return UINT64_MAX;
+    }
+    return victim_in_probation_() ? probation_.front().stamp
+                                  : main_.front().stamp;
+  }
+
+  eviction_policy policy() const { return policy_; }
+
 private:
-  using Bimap = boost::bimaps::bimap<Set<K>, boost::bimaps::list_of<V>>;
-  Bimap bimap_;
+  struct entry {
+    uint64_t hash;
+    K key;
+    V value;
+    size_t weight;
+    bool in_main;
+    bool demoted;
+    uint64_t stamp;
+  };
+  using Lru = std::list<entry>; // next to be evicted at the front
+  struct identity {
+    size_t operator()(uint64_t h) const { return h; }
+  };
+  using Index =
+      std::unordered_multimap<uint64_t, typename Lru::iterator, identity>;
+  using Ghost = std::list<uint64_t>;
+
+  Lru main_;
+  Lru probation_; // 2Q's A1in, and demoted entries
+  Index index_;
+  Ghost ghost_; // 2Q's A1out
+  std::unordered_map<uint64_t, typename Ghost::iterator, identity>
+      ghost_index_;
   const size_t capacity_;
-};
+  const eviction_policy policy_;
+  std::atomic<uint64_t> *const clock_;
+  const size_t probation_capacity_;
+  const size_t ghost_capacity_;
+  size_t weight_ = 0;
+  size_t demoted_ = 0;
+
+  template <typename Eq>
+  typename Index::iterator find_(uint64_t hash, const Eq &eq) {
+    auto range = index_.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (eq(it->second->key)) {
+        return it;
+      }
+    }
+    return index_.end();
+  }
 
-template <typename K, typename V,
-          template <typename...> class Set = boost::bimaps::unordered_set_of>
+  uint64_t tick_() {
+    return clock_ == nullptr
+               ? 0
+               : clock_->fetch_add(1, std::memory_order_relaxed);
+  }
 
-class SafeLRUCache {
-public:
-  SafeLRUCache(size_t capacity) : _cache(capacity) {}
-  void insert(const K &k, const V &v) {
-    std::lock_guard<std::mutex> lock(_mutex);
-    _cache.insert(k, v);
+  bool victim_in_probation_() const {
+    return !probation_.empty() &&
+           (main_.empty() || probation_.front().demoted ||
+            probation_.size() > probation_capacity_);
   }
 
-  boost::optional<V> find(const K &k) {
-    std::lock_guard<std::mutex> lock(_mutex);
-    return _cache.find(k);
+  void touch_(typename Lru::iterator it) {
+    if (it->in_main) {
+      it->stamp = tick_();
+      main_.splice(main_.end(), main_, it);
+    } else if (it->demoted || policy_ == eviction_policy::LRU) {
+      if (it->demoted) {
+        it->demoted = false;
+        demoted_--;
+      }
+      it->in_main = true;
+      it->stamp = tick_();
+      main_.splice(main_.end(), probation_, it);
+    }
+    // a 2Q hit in the FIFO leaves it where it is
   }
 
-private:
-  UnsafeLRUCache<K, V> _cache;
-  std::mutex _mutex;
+  void remember_(uint64_t hash) {
+    if (ghost_index_.find(hash) != ghost_index_.end()) {
+      return;
+    }
+    if (ghost_.size() >= ghost_capacity_) {
+      ghost_index_.erase(ghost_.front());
+      ghost_.pop_front();
+    }
+    ghost_.push_back(hash);
+    ghost_index_.emplace(hash, std::prev(ghost_.end()));
+  }
+
+  void unlink_(typename Lru::iterator it) {
+    weight_ -= it->weight;
+    if (it->demoted) {
+      demoted_--;
+    }
+    (it->in_main ? main_ : probation_).erase(it);
+  }
+
+  void erase_(typename Lru::iterator it) {
+    auto range = index_.equal_range(it->hash);
+    for (auto i = range.first; i != range.second; ++i) {
+      if (i->second == it) {
+        index_.erase(i);
+        break;
+      }
+    }
+    unlink_(it);
+  }
 };
 }
@@ -16,6 +16,7 @@ Open vStorage is distributed in the hope that it will be useful,
 but WITHOUT ANY WARRANTY of any kind.
 */
 
+#include "compact_manifest.h"
 #include "llio.h"
 #include "proxy_protocol.h"
 #include "snappy.h"
@@ -63,14 +64,26 @@ template <> void from(message &m, std::unique_ptr<Compression> &p) {
   p.reset(r);
 }
 
+// snappy straight into a (pooled) message buffer
+std::shared_ptr<message_buffer> _uncompress(const char *compressed,
+                                            size_t compressed_size) {
+  size_t size;
+  if (!snappy::GetUncompressedLength(compressed, compressed_size, &size)) {
+    throw deserialisation_exception("corrupt snappy data in manifest");
+  }
+  auto buffer = message_buffer::with_size(size);
+  if (!snappy::RawUncompress(compressed, compressed_size, buffer->data(0))) {
+    throw deserialisation_exception("corrupt snappy data in manifest");
+  }
+  return buffer;
+}
+
 void _from_version1(message &m, Manifest &mf, bool &ok_to_continue) {
   ALBA_LOG(DEBUG, "_from_version1");
-  std::string compressed;
-  from(m, compressed);
-
-  std::string real;
-  snappy::Uncompress(compressed.data(), compressed.size(), &real);
-  auto buffer = message_buffer::from_string(real);
+  uint32_t compressed_size;
+  from(m, compressed_size);
+  auto buffer = _uncompress(m.current(compressed_size), compressed_size);
+  m.skip(compressed_size);
   ok_to_continue = true;
   message m2(buffer);
   from(m2, mf.name);
@@ -213,14 +226,8 @@ void _from_version2(message &m, Manifest &mf, bool &ok_to_continue) {
   ALBA_LOG(DEBUG, "_from_version2");
   uint32_t compressed_size;
   from(m, compressed_size);
-  auto m_compressed = m.get_nested_message(compressed_size);
+  auto buffer = _uncompress(m.current(compressed_size), compressed_size);
   m.skip(compressed_size);
-
-  std::string real;
-  snappy::Uncompress(m_compressed.current(compressed_size), compressed_size,
-                     &real);
-
-  auto buffer = message_buffer::from_string(real); // TODO:copies
   ok_to_continue = true;
   message m2(buffer);
   from(m2, mf.name);
@@ -300,6 +307,198 @@ template <> void from(message &m, ManifestWithNamespaceId &mfid) {
   bool dont_care = false;
   from2(m, mfid, dont_care);
 }
+
+compressor_t _compressor_from(message &m) {
+  uint8_t type;
+  from(m, type);
+  switch (type) {
+  case 1:
+    return compressor_t::NO_COMPRESSION;
+  case 2:
+    return compressor_t::SNAPPY;
+  case 3:
+    return compressor_t::BZIP2;
+  case 4:
+    return compressor_t::TEST;
+  default:
+    ALBA_LOG(WARNING, "unknown compression type " << (int)type);
+    throw deserialisation_exception("unknown compression type");
+  }
+}
+
+// a checksum as (algo, digest bytes) without building a Checksum
+algo_t _checksum_from(message &m, const char *&digest, uint32_t &digest_size) {
+  uint8_t type;
+  from(m, type);
+  switch (type) {
+  case 1: {
+    digest = nullptr;
+    digest_size = 0;
+    return algo_t::NO_CHECKSUM;
+  }
+  case 2: {
+    from(m, digest_size);
+    digest = m.current(digest_size);
+    m.skip(digest_size);
+    return algo_t::SHA1;
+  }
+  case 3: {
+    digest_size = sizeof(uint32_t);
+    digest = m.current(digest_size);
+    m.skip(digest_size);
+    return algo_t::CRC32c;
+  }
+  default:
+    throw deserialisation_exception("unknown checksum type");
+  }
+}
+
+void _small_string_from(message &m, const char *&s, uint32_t &size) {
+  varint_t v;
+  from(m, v);
+  size = v.j;
+  s = m.current(size);
+  m.skip(size);
+}
+
+void _fragment_from(message &m, CompactManifest::builder &b) {
+  varint_t fragment_s_size;
+  from(m, fragment_s_size);
+  auto m2 = m.get_nested_message(fragment_s_size.j);
+  m.skip(fragment_s_size.j);
+
+  uint8_t version;
+  from(m2, version);
+  if (version != 1) {
+    throw deserialisation_exception("unexpected Fragment version");
+  }
+  // (not via the noexcept pair/optional templates: this may be truncated)
+  boost::optional<osd_t> osd;
+  bool has_osd;
+  from(m2, has_osd);
+  if (has_osd) {
+    osd_t o;
+    from(m2, o);
+    osd = o;
+  }
+  uint32_t version_id;
+  from(m2, version_id);
+  const char *crc;
+  uint32_t crc_size;
+  algo_t crc_algo = _checksum_from(m2, crc, crc_size);
+  uint32_t len;
+  from(m2, len);
+  b.add_fragment(osd, version_id, crc_algo, crc, crc_size, len);
+
+  const char *s;
+  uint32_t size;
+  if (m.get_pos() > m2.get_pos()) {
+    bool has_ctr;
+    from(m2, has_ctr);
+    if (has_ctr) {
+      _small_string_from(m2, s, size);
+      b.set_ctr(s, size);
+    }
+  }
+  if (m.get_pos() > m2.get_pos()) {
+    bool has_fnr;
+    from(m2, has_fnr);
+    if (has_fnr) {
+      _small_string_from(m2, s, size);
+      b.set_fnr(s, size);
+    }
+  }
+}
+
+/* version 2 manifests are decoded straight into a CompactManifest:
+   no Fragment, Checksum or string per fragment on the way. */
+void _compact_from_version2(message &m, CompactManifest::builder &b,
+                            bool &ok_to_continue) {
+  ALBA_LOG(DEBUG, "_compact_from_version2");
+  uint32_t compressed_size;
+  from(m, compressed_size);
+  auto buffer = _uncompress(m.current(compressed_size), compressed_size);
+  m.skip(compressed_size);
+  ok_to_continue = true;
+  message m2(buffer);
+  from(m2, b.name);
+  from(m2, b.object_id);
+  uint32_t n_chunk_sizes;
+  from(m2, n_chunk_sizes);
+  m2.current(sizeof(uint32_t) * n_chunk_sizes); // throws if it's not there
+  b.chunk_sizes.resize(n_chunk_sizes);
+  for (int32_t c = n_chunk_sizes - 1; c >= 0; --c) {
+    from(m2, b.chunk_sizes[c]);
+  }
+
+  uint8_t version2;
+  from(m2, version2);
+  if (version2 != 1) {
+    throw deserialisation_exception("unexpected version2");
+  }
+
+  from(m2, b.encoding_scheme);
+  b.compressor = _compressor_from(m2);
+  from(m2, b.encrypt_info);
+  const char *digest;
+  uint32_t digest_size;
+  b.checksum_algo = _checksum_from(m2, digest, digest_size);
+  b.checksum_digest.assign(digest, digest_size);
+  from(m2, b.size);
+  uint8_t layout_tag;
+  from(m2, layout_tag);
+  if (layout_tag != 1) {
+    throw deserialisation_exception("unexpected layout tag");
+  }
+
+  // chunks, and the fragments in them, come last to first
+  uint32_t n_chunks;
+  from(m2, n_chunks);
+  for (uint32_t c = 0; c < n_chunks; c++) {
+    uint32_t n_fragments;
+    from(m2, n_fragments);
+    b.add_chunk(n_fragments);
+    for (uint32_t f = 0; f < n_fragments; f++) {
+      _fragment_from(m2, b);
+    }
+  }
+  b.reverse();
+}
+
+template <>
+void from2(message &m, std::shared_ptr<const CompactManifest> &cmf,
+           bool &ok_to_continue) {
+  ok_to_continue = false;
+  std::unique_ptr<ManifestWithNamespaceId> mfid;
+  CompactManifest::builder b;
+  try {
+    uint8_t version;
+    from(m, version);
+    switch (version) {
+    case 1: {
+      mfid.reset(new ManifestWithNamespaceId());
+      _from_version1(m, *mfid, ok_to_continue);
+    }; break;
+    case 2: {
+      _compact_from_version2(m, b, ok_to_continue);
+    }; break;
+    default:
+      throw deserialisation_exception("unexpecteded Manifest version");
+    }
+    from(m, b.namespace_id);
+  } catch (deserialisation_exception &e) {
+    if (ok_to_continue) {
+      from(m, b.namespace_id);
+    };
+    throw;
+  }
+  if (mfid) {
+    mfid->namespace_id = b.namespace_id;
+    cmf = std::make_shared<const CompactManifest>(*mfid);
+  } else {
+    cmf = std::make_shared<const CompactManifest>(std::move(b));
+  }
+}
 }
 
 namespace proxy_protocol {
@@ -17,6 +17,8 @@ but WITHOUT ANY WARRANTY of any kind.
 */
 
 #include "manifest_cache.h"
+#include <algorithm>
+#include <random>
 
 namespace alba {
 namespace proxy_client {
@@ -28,13 +30,98 @@ ManifestCache &ManifestCache::getInstance() {
   return instance;
 }
 
-void ManifestCache::set_capacity(size_t capacity) {
-  std::lock_guard<std::mutex> lock(_level1_mutex);
-  _manifest_cache_capacity = capacity;
+void ManifestCache::set_capacity(size_t capacity, size_t max_bytes,
+                                 ovs::eviction_policy policy) {
+  {
+    std::unique_lock<std::shared_timed_mutex> lock(_level1_mutex);
+    _manifest_cache_capacity = capacity;
+    _policy = policy;
+    _max_bytes = max_bytes;
+  }
+  _evict();
+}
+
+namespace {
+// FNV-1a
+const uint64_t _FNV_OFFSET = 14695981039346656037ULL;
+const uint64_t _FNV_PRIME = 1099511628211ULL;
+
+uint64_t _fnv1a(uint64_t h, const string &s) {
+  for (unsigned char c : s) {
+    h ^= c;
+    h *= _FNV_PRIME;
+  }
+  return h;
+}
+}
+
+uint64_t manifest_cache_hash(const string &alba_id, const string &object_name) {
+  return _fnv1a(_fnv1a(_FNV_OFFSET, alba_id), object_name);
+}
+
+size_t manifest_cache_weight(const CompactManifest &mf) {
+  return mf.memory_size();
 }
 
-string make_key(const string alba_id, const string object_name) {
-  return alba_id + object_name;
+std::ostream &operator<<(std::ostream &os, const manifest_cache_usage &u) {
+  os << "manifest_cache_usage{ bytes= " << u.bytes
+     << ", max_bytes= " << u.max_bytes << ", entries= " << u.entries
+     << ", namespaces= " << u.namespaces << " }";
+  return os;
+}
+
+ManifestCache::namespace_cache::namespace_cache(size_t capacity,
+                                                ovs::eviction_policy policy,
+                                                std::atomic<uint64_t> *clock) {
+  size_t n = std::max((size_t)1, std::min(N_SHARDS, capacity));
+  shards.reserve(n);
+  for (size_t i = 0; i < n; i++) {
+    // the first (capacity % n) shards get one more
+    size_t shard_capacity = capacity / n + ((i < capacity % n) ? 1 : 0);
+    shards.emplace_back(
+        new shard(std::max((size_t)1, shard_capacity), policy, clock));
+  }
+}
+
+ManifestCache::shard &ManifestCache::namespace_cache::shard_for(uint64_t hash) {
+  // bits 32.. of FNV-1a hardly depend on the last bytes of the key (names
+  // that only differ in their last digits shared one or two shards), so
+  // mix all bits in first (Fibonacci hashing).
+  uint64_t h = hash * 0x9E3779B97F4A7C15ULL;
+  return *shards[(h >> 32) % shards.size()];
+}
+
+ManifestCache::namespace_cache *ManifestCache::_namespace_cache(
+    const string &namespace_,
+    std::shared_lock<std::shared_timed_mutex> &lock) {
+  auto it1 = _level1.find(namespace_);
+  if (it1 != _level1.end()) {
+    ALBA_LOG(DEBUG, "ManifestCache::add namespace:'"
+                        << namespace_ << "' : existing manifest cache");
+    return it1->second.get();
+  }
+  lock.unlock();
+  {
+    std::unique_lock<std::shared_timed_mutex> ulock(_level1_mutex);
+    it1 = _level1.find(namespace_);
+    if (it1 == _level1.end()) {
+      ALBA_LOG(INFO, "ManifestCache::add namespace:'"
+                         << namespace_ << "' : new manifest cache");
+      auto nc = std::unique_ptr<namespace_cache>(
+          new namespace_cache(_manifest_cache_capacity, _policy, &_clock));
+      for (auto &s : nc->shards) {
+        _shards.push_back(s.get());
+      }
+      _level1.emplace(namespace_, std::move(nc));
+    }
+  }
+  lock.lock();
+  it1 = _level1.find(namespace_);
+  if (it1 == _level1.end()) {
+    // invalidated in the mean time
+    return nullptr;
+  }
+  return it1->second.get();
 }
 
 void ManifestCache::add(string namespace_, string alba_id,
@@ -43,67 +130,274 @@ void ManifestCache::add(string namespace_, string alba_id,
                                                   << ", alba_id=" << alba_id
                                                   << ", mfp=" << *mfp);
 
-  std::shared_ptr<manifest_cache> mcp = nullptr;
-  std::shared_ptr<std::mutex> mp = nullptr;
+  string name = mfp->name();
+  uint64_t hash = manifest_cache_hash(alba_id, name);
+  size_t weight = manifest_cache_weight(*mfp);
+  manifest_cache_key key{std::move(alba_id), std::move(name)};
   {
-    std::lock_guard<std::mutex> lock(_level1_mutex);
-    auto it1 = _level1.find(namespace_);
+    std::shared_lock<std::shared_timed_mutex> lock(_level1_mutex);
+    namespace_cache *nc = _namespace_cache(namespace_, lock);
+    if (nc == nullptr) {
+      return;
+    }
+    shard &shard = nc->shard_for(hash);
+    std::lock_guard<std::mutex> g(shard.mutex);
+    int64_t weight0 = shard.cache.weight();
+    int64_t size0 = shard.cache.size();
+    shard.cache.insert(hash, std::move(key), std::move(mfp), weight);
+    _bytes += (int64_t)shard.cache.weight() - weight0;
+    _entries += (int64_t)shard.cache.size() - size0;
+  }
+  _evict();
+}
 
-    if (it1 == _level1.end()) {
-      ALBA_LOG(INFO, "ManifestCache::add namespace:'"
-                         << namespace_ << "' : new manifest cache");
-      std::shared_ptr<manifest_cache> mc(
-          new manifest_cache(_manifest_cache_capacity));
-      std::shared_ptr<std::mutex> mm(new std::mutex);
-      auto p = std::make_pair(mc, mm);
-      _level1[namespace_] = std::move(p);
-      it1 = _level1.find(namespace_);
-    } else {
-      ALBA_LOG(DEBUG, "ManifestCache::add namespace:'"
-                          << namespace_ << "' : existing manifest cache");
+void ManifestCache::add(
+    const string &namespace_,
+    std::vector<std::pair<alba_id_t, manifest_cache_entry>> &&entries) {
+  ALBA_LOG(DEBUG, "ManifestCache::add namespace=" << namespace_ << ", "
+                                                  << entries.size()
+                                                  << " manifests");
+  if (entries.empty()) {
+    return;
+  }
+  struct item {
+    shard *shard_;
+    uint64_t hash;
+    size_t i;
+  };
+  std::vector<item> items;
+  items.reserve(entries.size());
+  {
+    std::shared_lock<std::shared_timed_mutex> lock(_level1_mutex);
+    namespace_cache *nc = _namespace_cache(namespace_, lock);
+    if (nc == nullptr) {
+      return;
+    }
+    for (size_t i = 0; i < entries.size(); i++) {
+      uint64_t hash =
+          manifest_cache_hash(entries[i].first, entries[i].second->name());
+      items.push_back(item{&nc->shard_for(hash), hash, i});
+    }
+    // one lock per shard, whatever the number of manifests in it
+    std::stable_sort(items.begin(), items.end(),
+                     [](const item &a, const item &b) {
+                       return a.shard_ < b.shard_;
+                     });
+    auto it = items.begin();
+    while (it != items.end()) {
+      shard &shard = *it->shard_;
+      std::lock_guard<std::mutex> g(shard.mutex);
+      int64_t weight0 = shard.cache.weight();
+      int64_t size0 = shard.cache.size();
+      for (; it != items.end() && it->shard_ == &shard; ++it) {
+        auto &entry = entries[it->i];
+        size_t weight = manifest_cache_weight(*entry.second);
+        manifest_cache_key key{std::move(entry.first), entry.second->name()};
+        shard.cache.insert(it->hash, std::move(key), std::move(entry.second),
+                           weight);
+      }
+      _bytes += (int64_t)shard.cache.weight() - weight0;
+      _entries += (int64_t)shard.cache.size() - size0;
     }
-    const auto &v = it1->second;
-    mcp = v.first;
-    mp = v.second;
   }
+  _evict();
+}
+
+namespace {
+// shards compared per evicted entry
+const size_t EVICTION_SAMPLES = 16;
 
-  manifest_cache &manifest_cache = *mcp;
-  manifest_cache.insert(make_key(alba_id, mfp->name), std::move(mfp));
+size_t _random_index(size_t n) {
+  thread_local std::minstd_rand rng{std::random_device{}()};
+  return rng() % n;
+}
+}
+
+void ManifestCache::_evict() {
+  if (_bytes <= (int64_t)_max_bytes) {
+    return;
+  }
+  std::shared_lock<std::shared_timed_mutex> lock(_level1_mutex);
+  if (_shards.empty()) {
+    return;
+  }
+  // demoted entries go first
+  while (_bytes > (int64_t)_max_bytes) {
+    shard *s;
+    {
+      std::lock_guard<std::mutex> dg(_demoted_mutex);
+      if (_demoted_shards.empty()) {
+        break;
+      }
+      s = _demoted_shards.back();
+    }
+    std::lock_guard<std::mutex> g(s->mutex);
+    while (_bytes > (int64_t)_max_bytes && s->cache.demoted() > 0) {
+      _bytes -= s->cache.pop_lru();
+      _entries--;
+    }
+    if (s->cache.demoted() == 0) {
+      std::lock_guard<std::mutex> dg(_demoted_mutex);
+      auto it = std::find(_demoted_shards.begin(), _demoted_shards.end(), s);
+      if (it != _demoted_shards.end()) {
+        _demoted_shards.erase(it);
+      }
+    }
+  }
+  while (_bytes > (int64_t)_max_bytes && _evict_one()) {
+  }
+  ALBA_LOG(DEBUG, "ManifestCache::_evict => " << _bytes << " bytes");
+}
+
+// The shard holding the coldest entry (by the shared clock) pays. With a
+// handful of namespaces all shards are compared, otherwise a random sample
+// of them: that approximates a single LRU over all namespaces at a cost per
+// evicted entry that doesn't grow with the number of namespaces.
+// Caller holds _level1_mutex (shared).
+bool ManifestCache::_evict_one() {
+  const size_t n = _shards.size();
+  const bool sample = n > 4 * EVICTION_SAMPLES;
+  const size_t tries = sample ? 4 * EVICTION_SAMPLES : n;
+  shard *victim = nullptr;
+  uint64_t coldest = UINT64_MAX;
+  size_t sampled = 0;
+  for (size_t i = 0; i < tries; i++) {
+    shard *s = _shards[sample ? _random_index(n) : i];
+    std::lock_guard<std::mutex> g(s->mutex);
+    uint64_t stamp = s->cache.victim_stamp();
+    if (stamp == UINT64_MAX) {
+      continue; // empty
+    }
+    if (stamp < coldest) {
+      coldest = stamp;
+      victim = s;
+    }
+    if (sample && ++sampled == EVICTION_SAMPLES) {
+      break;
+    }
+  }
+  if (victim == nullptr && sample) {
+    // (nearly) all shards are empty, look for one that isn't
+    size_t start = _random_index(n);
+    for (size_t i = 0; i < n && victim == nullptr; i++) {
+      shard *s = _shards[(start + i) % n];
+      std::lock_guard<std::mutex> g(s->mutex);
+      if (!s->cache.empty()) {
+        victim = s;
+      }
+    }
+  }
+  if (victim == nullptr) {
+    return false;
+  }
+  std::lock_guard<std::mutex> g(victim->mutex);
+  if (!victim->cache.empty()) {
+    _bytes -= victim->cache.pop_lru();
+    _entries--;
+  }
+  return true;
 }
 
 manifest_cache_entry ManifestCache::find(const string &namespace_,
                                          const string &alba_id,
                                          const string &object_name) {
-  std::pair<std::shared_ptr<manifest_cache>, std::shared_ptr<std::mutex>> vp;
-  {
-    std::lock_guard<std::mutex> g(_level1_mutex);
-    auto it = _level1.find(namespace_);
-    if (it == _level1.end()) {
-      return nullptr;
-    } else {
-      vp = it->second;
-    }
+  uint64_t hash = manifest_cache_hash(alba_id, object_name);
+
+  std::shared_lock<std::shared_timed_mutex> lock(_level1_mutex);
+  auto it = _level1.find(namespace_);
+  if (it == _level1.end()) {
+    return nullptr;
   }
-  auto &map = *vp.first;
-  auto &mm = *vp.second;
-  {
-    std::lock_guard<std::mutex> g(mm);
-    const auto &maybe_elem = map.find(make_key(alba_id, object_name));
-    if (boost::none == maybe_elem) {
-      return nullptr;
-    } else {
-      return *maybe_elem;
-    }
+  shard &shard = it->second->shard_for(hash);
+  std::lock_guard<std::mutex> g(shard.mutex);
+  const auto &maybe_elem =
+      shard.cache.find(hash, [&](const manifest_cache_key &key) {
+        return key.object_name == object_name && key.alba_id == alba_id;
+      });
+  if (boost::none == maybe_elem) {
+    return nullptr;
+  } else {
+    return *maybe_elem;
   }
 }
 
 void ManifestCache::invalidate_namespace(const string &namespace_) {
   ALBA_LOG(DEBUG, "ManifestCache::invalidate_namespace(" << namespace_ << ")");
-  std::lock_guard<std::mutex> g(_level1_mutex);
+  std::unique_lock<std::shared_timed_mutex> g(_level1_mutex);
   auto it = _level1.find(namespace_);
   if (it != _level1.end()) {
+    // shard mutexes are only taken under the shared lock
+    for (auto &s : it->second->shards) {
+      _bytes -= s->cache.weight();
+      _entries -= s->cache.size();
+      _shards.erase(std::find(_shards.begin(), _shards.end(), s.get()));
+      auto it = std::find(_demoted_shards.begin(), _demoted_shards.end(),
+                          s.get());
+      if (it != _demoted_shards.end()) {
+        _demoted_shards.erase(it);
+      }
+    }
     _level1.erase(it);
   }
 }
+
+void ManifestCache::demote_namespace(const string &namespace_) {
+  ALBA_LOG(DEBUG, "ManifestCache::demote_namespace(" << namespace_ << ")");
+  std::shared_lock<std::shared_timed_mutex> lock(_level1_mutex);
+  auto it = _level1.find(namespace_);
+  if (it != _level1.end()) {
+    for (auto &s : it->second->shards) {
+      {
+        std::lock_guard<std::mutex> g(s->mutex);
+        s->cache.demote_all();
+      }
+      std::lock_guard<std::mutex> dg(_demoted_mutex);
+      if (std::find(_demoted_shards.begin(), _demoted_shards.end(),
+                    s.get()) == _demoted_shards.end()) {
+        _demoted_shards.push_back(s.get());
+      }
+    }
+  }
+}
+
+std::vector<cached_manifest> ManifestCache::hottest(size_t max_entries) {
+  std::vector<std::vector<cached_manifest>> per_shard;
+  {
+    std::shared_lock<std::shared_timed_mutex> lock(_level1_mutex);
+    for (auto &p : _level1) {
+      for (auto &s : p.second->shards) {
+        std::vector<cached_manifest> entries;
+        std::lock_guard<std::mutex> g(s->mutex);
+        s->cache.visit([&](const manifest_cache_key &key,
+                           const manifest_cache_entry &mf) {
+          entries.push_back(cached_manifest{p.first, key.alba_id, mf});
+          return entries.size() < max_entries;
+        });
+        per_shard.push_back(std::move(entries));
+      }
+    }
+  }
+  // take the shards in turn so all namespaces get their share
+  std::vector<cached_manifest> result;
+  for (size_t i = 0; result.size() < max_entries; i++) {
+    bool more = false;
+    for (auto &entries : per_shard) {
+      if (i < entries.size() && result.size() < max_entries) {
+        result.push_back(std::move(entries[i]));
+        more = true;
+      }
+    }
+    if (!more) {
+      break;
+    }
+  }
+  return result;
+}
+
+manifest_cache_usage ManifestCache::usage() {
+  std::shared_lock<std::shared_timed_mutex> lock(_level1_mutex);
+  return manifest_cache_usage{(size_t)_bytes.load(), _max_bytes.load(),
+                              (size_t)_entries.load(), _level1.size()};
+}
 }
 }
@@ -17,23 +17,61 @@ but WITHOUT ANY WARRANTY of any kind.
 */
 
 #pragma once
+#include "compact_manifest.h"
 #include "lru_cache.h"
-#include "manifest.h"
+#include <atomic>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <shared_mutex>
 #include <string>
 #include <utility>
+#include <vector>
 namespace alba {
 namespace proxy_client {
 
 using namespace proxy_protocol;
-typedef std::shared_ptr<ManifestWithNamespaceId> manifest_cache_entry;
-typedef ovs::SafeLRUCache<std::string, manifest_cache_entry> manifest_cache;
+typedef std::shared_ptr<const CompactManifest> manifest_cache_entry;
+
+struct manifest_cache_key {
+  std::string alba_id;
+  std::string object_name;
+
+  bool operator==(const manifest_cache_key &other) const {
+    return alba_id == other.alba_id && object_name == other.object_name;
+  }
+};
+
+// hash of (alba_id, object_name) without building a key first.
+uint64_t manifest_cache_hash(const std::string &alba_id,
+                             const std::string &object_name);
+
+// (estimated) number of bytes a cached manifest occupies
+size_t manifest_cache_weight(const CompactManifest &);
+
+struct manifest_cache_usage {
+  size_t bytes;
+  size_t max_bytes;
+  size_t entries;
+  size_t namespaces;
+};
+
+std::ostream &operator<<(std::ostream &, const manifest_cache_usage &);
+
+struct cached_manifest {
+  std::string namespace_;
+  std::string alba_id;
+  manifest_cache_entry manifest;
+};
+
 class ManifestCache {
 public:
   static ManifestCache &getInstance();
-  void set_capacity(size_t capacity);
+  // capacity: number of manifests per namespace
+  // max_bytes: memory limit shared by all namespaces
+  // policy: applies to namespaces that are cached from now on
+  void set_capacity(size_t capacity, size_t max_bytes,
+                    ovs::eviction_policy policy = ovs::eviction_policy::LRU);
 
   ManifestCache(ManifestCache const &) = delete;
   void operator=(ManifestCache const &) = delete;
@@ -41,19 +79,75 @@ public:
   void add(std::string namespace_, std::string alba_id,
            manifest_cache_entry rora_map);
 
+  // a batch of (alba_id, manifest) for one namespace:
+  // every shard is locked only once.
+  void add(const std::string &namespace_,
+           std::vector<std::pair<alba_id_t, manifest_cache_entry>> &&);
+
   manifest_cache_entry find(const std::string &namespace_,
                             const std::string &alba_id,
                             const std::string &object_name);
 
   void invalidate_namespace(const std::string &);
 
+  // the manifests of this namespace are the first to be evicted
+  // (unless they're used again)
+  void demote_namespace(const std::string &);
+
+  manifest_cache_usage usage();
+
+  // at most max_entries manifests, the most valuable first
+  std::vector<cached_manifest> hottest(size_t max_entries);
+
+  // (at most) this many independently locked parts per namespace
+  static const size_t N_SHARDS = 16;
+
 private:
   ManifestCache() {}
+
+  typedef ovs::HashedLRUCache<manifest_cache_key, manifest_cache_entry>
+      manifest_cache;
+
+  struct shard {
+    shard(size_t capacity, ovs::eviction_policy policy,
+          std::atomic<uint64_t> *clock)
+        : cache(capacity, policy, clock) {}
+    std::mutex mutex;
+    manifest_cache cache;
+  };
+
+  struct namespace_cache {
+    namespace_cache(size_t capacity, ovs::eviction_policy policy,
+                    std::atomic<uint64_t> *clock);
+    shard &shard_for(uint64_t hash);
+    std::vector<std::unique_ptr<shard>> shards;
+  };
+
+  // nullptr if the namespace was invalidated while lock was let go
+  namespace_cache *
+  _namespace_cache(const std::string &namespace_,
+                   std::shared_lock<std::shared_timed_mutex> &lock);
+
+  void _evict();
+  // drops the coldest entry of a sample of shards
+  bool _evict_one();
+
   size_t _manifest_cache_capacity = 10000;
-  std::mutex _level1_mutex;
-  std::map<std::string, std::pair<std::shared_ptr<manifest_cache>,
-                                  std::shared_ptr<std::mutex>>>
-      _level1;
+  ovs::eviction_policy _policy = ovs::eviction_policy::LRU;
+  std::atomic<size_t> _max_bytes{256 << 20};
+  std::atomic<int64_t> _bytes{0};
+  std::atomic<int64_t> _entries{0};
+  // one LRU order over the entries of all shards
+  std::atomic<uint64_t> _clock{0};
+
+  // read-mostly: only adding or dropping a namespace takes it exclusively
+  std::shared_timed_mutex _level1_mutex;
+  std::map<std::string, std::unique_ptr<namespace_cache>> _level1;
+  // the shards of all namespaces in _level1
+  std::vector<shard *> _shards;
+  // the ones that (may) still hold demoted entries
+  std::mutex _demoted_mutex;
+  std::vector<shard *> _demoted_shards;
 };
 }
 }
@@ -18,19 +18,51 @@
 */
 #include "osd_access.h"
 #include "alba_logger.h"
+#include "executor.h"
 
 #include "stuff.h"
+#include <algorithm>
 #include <assert.h>
+#include <string.h>
 
 namespace alba {
 namespace proxy_client {
 
-OsdAccess &OsdAccess::getInstance(int connection_pool_size,
-                                  std::chrono::steady_clock::duration timeout) {
-  static OsdAccess instance(connection_pool_size, timeout);
+OsdAccess &OsdAccess::getInstance(
+    int connection_pool_size, std::chrono::steady_clock::duration timeout,
+    int max_parallel_osd_reads, uint32_t read_gap_tolerance,
+    int pipeline_depth, std::chrono::steady_clock::duration timeout_floor,
+    std::chrono::steady_clock::duration timeout_ceiling) {
+  static OsdAccess instance(connection_pool_size, timeout,
+                            max_parallel_osd_reads, read_gap_tolerance,
+                            pipeline_depth, timeout_floor, timeout_ceiling);
   return instance;
 }
 
+OsdAccess::OsdAccess(int connection_pool_size,
+                     std::chrono::steady_clock::duration timeout,
+                     int max_parallel_osd_reads,
+                     uint32_t read_gap_tolerance, int pipeline_depth,
+                     std::chrono::steady_clock::duration timeout_floor,
+                     std::chrono::steady_clock::duration timeout_ceiling)
+    : _connection_pool_size(connection_pool_size), _timeout(timeout),
+      _timeout_floor(timeout_floor == timeout_floor.zero() ? timeout
+                                                           : timeout_floor),
+      _timeout_ceiling(timeout_ceiling == timeout_ceiling.zero()
+                           ? timeout
+                           : timeout_ceiling),
+      _max_parallel_osd_reads(std::max(1, max_parallel_osd_reads)),
+      _read_gap_tolerance(read_gap_tolerance),
+      _pipeline_depth(std::max(1, pipeline_depth)), _filling(false) {
+  if (_max_parallel_osd_reads > 1) {
+    // the calling thread reads one of the osds itself
+    _executor = std::unique_ptr<executor::Executor>(
+        new executor::Executor(_max_parallel_osd_reads - 1));
+  }
+}
+
+OsdAccess::~OsdAccess() {}
+
 bool OsdAccess::osd_is_unknown(osd_t osd) {
   std::lock_guard<std::mutex> lock(_osd_maps_mutex);
   auto &pair = _osd_maps[_osd_maps.size() - 1];
@@ -84,59 +116,509 @@ bool OsdAccess::update(Proxy_client &client) {
 }
 
 std::vector<alba_id_t> OsdAccess::get_alba_levels(Proxy_client &client) {
+  std::vector<alba_id_t> result;
+  get_alba_levels(client, result);
+  return result;
+}
+
+void OsdAccess::get_alba_levels(Proxy_client &client,
+                                std::vector<alba_id_t> &result) {
   if (_alba_levels.size() == 0) {
     if (!this->update(client)) {
       throw osd_access_exception(
           -1, "initial update of osd infos in osd_access failed");
     }
   }
-  return _alba_levels;
+  result.assign(_alba_levels.begin(), _alba_levels.end());
+}
+
+osd_maps_t OsdAccess::get_osd_maps() {
+  std::lock_guard<std::mutex> lock(_osd_maps_mutex);
+  return _osd_maps;
+}
+
+std::map<std::string, asd::latency_estimate> OsdAccess::latency_estimates() {
+  return asd_connection_pools.latency_estimates();
+}
+
+bool OsdAccess::restore(osd_maps_t &&osd_maps) {
+  std::lock_guard<std::mutex> lock(_osd_maps_mutex);
+  if (!_osd_maps.empty() || osd_maps.empty()) {
+    return false;
+  }
+  _alba_levels.clear();
+  for (auto &p : osd_maps) {
+    _alba_levels.push_back(p.first);
+    _osd_maps.push_back(std::move(p));
+  }
+  ALBA_LOG(INFO, "OsdAccess::restore: " << _alba_levels.size()
+                                        << " alba levels");
+  return true;
 }
 
 int OsdAccess::read_osds_slices(
     std::map<osd_t, std::vector<asd_slice>> &per_osd) {
 
+  // osds without slices (left over in a reused map) are skipped
+  size_t n_osds = std::count_if(
+      per_osd.begin(), per_osd.end(),
+      [](const std::pair<const osd_t, std::vector<asd_slice>> &item) {
+        return !item.second.empty();
+      });
+  if (n_osds <= 1 || nullptr == _executor) {
+    int rc = 0;
+    for (auto &item : per_osd) {
+      if (item.second.empty()) {
+        continue;
+      }
+      rc = _read_osd_slices_asd_direct_path(item.first, item.second);
+      if (rc) {
+        break;
+      }
+    }
+    return rc;
+  }
+
+  std::vector<std::pair<const osd_t, std::vector<asd_slice>> *> items;
+  items.reserve(n_osds);
+  for (auto &item : per_osd) {
+    if (!item.second.empty()) {
+      items.push_back(&item);
+    }
+  }
+  // the first failure stops the reads that have not been started yet;
+  // the ones in flight finish (or time out) on their own.
+  return executor::parallel_for(
+      *_executor, items.size(), _max_parallel_osd_reads, [&](size_t i) {
+        auto &item = *items[i];
+        return _read_osd_slices_asd_direct_path(item.first, item.second);
+      });
+}
+
+int OsdAccess::read_osds_slices(
+    std::map<osd_t, std::vector<asd_slice>> &per_osd,
+    std::map<osd_t, int> &rcs) {
+
+  size_t n_osds = std::count_if(
+      per_osd.begin(), per_osd.end(),
+      [](const std::pair<const osd_t, std::vector<asd_slice>> &item) {
+        return !item.second.empty();
+      });
+  std::vector<std::pair<const osd_t, std::vector<asd_slice>> *> items;
+  std::vector<int *> item_rcs;
+  if (n_osds <= 1 || nullptr == _executor) {
+    for (auto &item : per_osd) {
+      if (!item.second.empty()) {
+        rcs[item.first] =
+            _read_osd_slices_asd_direct_path(item.first, item.second);
+      }
+    }
+  } else {
+    items.reserve(n_osds);
+    item_rcs.reserve(n_osds);
+    for (auto &item : per_osd) {
+      if (!item.second.empty()) {
+        items.push_back(&item);
+        // (the entries exist before the threads write into them)
+        item_rcs.push_back(&rcs[item.first]);
+      }
+    }
+    executor::parallel_for(*_executor, items.size(), _max_parallel_osd_reads,
+                           [&](size_t i) {
+                             auto &item = *items[i];
+                             *item_rcs[i] = _read_osd_slices_asd_direct_path(
+                                 item.first, item.second);
+                             return 0;
+                           });
+  }
+
+  int result = 0;
+  for (auto &item : per_osd) {
+    if (!item.second.empty()) {
+      int rc = rcs[item.first];
+      if (rc != 0 && result != -1) {
+        result = rc;
+      }
+    }
+  }
+  return result;
+}
+
+const int hedged_read::LATE;
+
+// one osd of a hedged read. As the hook of its partial_gets, it's what
+// keeps the read off the caller's keys and targets once it's late.
+struct hedged_read::osd_read : asd_client::requests_hook {
+  hedged_read::state *s;
+  osd_t osd;
+  const std::vector<asd_slice> *slices; // the caller's
+  std::chrono::steady_clock::duration delay;
+
+  // (under state::mutex)
+  bool started = false;
+  std::chrono::steady_clock::time_point deadline;
+  bool late = false;
+  bool busy = false; // with the caller's slices, keys or targets
+  bool done = false;
   int rc = 0;
+
+  // where the rest of a late read goes instead (only touched by the thread
+  // reading the osd, and by finish once it's done)
+  asd_read_plan *plan = nullptr;
+  bool moved = false;
+  std::vector<std::string> keys;
+  std::vector<byte> buffer;
+  struct move {
+    byte *target;
+    size_t pos; // in buffer
+    uint32_t len;
+  };
+  std::vector<move> moves;
+
+  // false if it's late before it started, then it leaves the slices alone
+  bool start();
+  // the plan was built from the slices, it's what's used from now on
+  void built(asd_read_plan &);
+
+  void using_requests(std::vector<asd_client::partial_get_request> &,
+                      size_t first) override;
+  void done_with_requests() override;
+
+private:
+  void _move(std::vector<asd_client::partial_get_request> &, size_t first);
+};
+
+// what the threads reading the osds share, it may outlive the hedged_read
+struct hedged_read::state {
+  executor::Executor *executor;
+  std::vector<osd_read> reads; // (reserved, they point back here)
+
+  std::mutex mutex;
+  std::condition_variable cond;
+  bool hedging = false;
+  bool hedge_done = false;
+  bool hedge_ok = false;
+
+  // the reads that aren't done let go of the caller's slices
+  bool late_ones_let_go() const {
+    for (auto &r : reads) {
+      if (!r.done && r.busy) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+bool hedged_read::osd_read::start() {
+  std::lock_guard<std::mutex> lock(s->mutex);
+  if (late) {
+    return false;
+  }
+  started = true;
+  deadline = std::chrono::steady_clock::now() + delay;
+  busy = true;
+  return true;
+}
+
+void hedged_read::osd_read::built(asd_read_plan &plan_) {
+  plan = &plan_;
+  done_with_requests();
+}
+
+void hedged_read::osd_read::using_requests(
+    std::vector<asd_client::partial_get_request> &requests, size_t first) {
+  std::lock_guard<std::mutex> lock(s->mutex);
+  if (late && !moved) {
+    _move(requests, first);
+  }
+  busy = !moved;
+}
+
+void hedged_read::osd_read::done_with_requests() {
+  {
+    std::lock_guard<std::mutex> lock(s->mutex);
+    busy = false;
+  }
+  s->cond.notify_all();
+}
+
+void hedged_read::osd_read::_move(
+    std::vector<asd_client::partial_get_request> &requests, size_t first) {
+  // the keys of the requests from first on, the slices of theirs that
+  // don't land in scratch, and what's scattered from scratch afterwards.
+  // (what was read before went where it should, and is the same data
+  // the proxy has)
+  auto &scratch = plan->scratch;
+  auto in_scratch = [&scratch](const byte *p) {
+    return !scratch.empty() && p >= scratch.data() &&
+           p < scratch.data() + scratch.size();
+  };
+  size_t size = 0;
+  for (size_t i = first; i < requests.size(); i++) {
+    for (auto &slice : requests[i].slices) {
+      if (!in_scratch(slice.target)) {
+        size += slice.length;
+      }
+    }
+  }
+  for (auto &c : plan->copies) {
+    size += c.len;
+  }
+  buffer.resize(size);
+  // (reserved, so the requests can point into it)
+  keys.reserve(requests.size() - first);
+  size_t pos = 0;
+  for (size_t i = first; i < requests.size(); i++) {
+    auto &request = requests[i];
+    keys.push_back(*request.key);
+    request.key = &keys.back();
+    for (auto &slice : request.slices) {
+      if (!in_scratch(slice.target)) {
+        moves.push_back(move{slice.target, pos, slice.length});
+        slice.target = &buffer[pos];
+        pos += slice.length;
+      }
+    }
+  }
+  for (auto &c : plan->copies) {
+    moves.push_back(move{c.target, pos, c.len});
+    c.target = &buffer[pos];
+    pos += c.len;
+  }
+  moved = true;
+  ALBA_LOG(DEBUG, "hedged_read: osd " << osd << " goes on in a buffer of "
+                                      << size << " bytes");
+}
+
+std::unique_ptr<hedged_read> OsdAccess::start_hedged_read(
+    const std::map<osd_t, std::vector<asd_slice>> &per_osd,
+    double percentile) {
+  if (nullptr == _executor) {
+    return nullptr;
+  }
+  std::unique_ptr<hedged_read> result(new hedged_read());
+  auto state = std::make_shared<hedged_read::state>();
+  state->executor = _executor.get();
+  state->reads.reserve(per_osd.size());
   for (auto &item : per_osd) {
-    osd_t osd = item.first;
-    auto &osd_slices = item.second;
-    // TODO this could be done in parallel
-    rc = _read_osd_slices_asd_direct_path(osd, osd_slices);
-    if (rc) {
+    if (item.second.empty()) {
+      continue;
+    }
+    state->reads.emplace_back();
+    auto &r = state->reads.back();
+    r.s = state.get();
+    r.osd = item.first;
+    r.slices = &item.second;
+    r.delay = _hedge_delay(item.first, percentile);
+  }
+  result->_state = state;
+
+  // every osd on a thread of its own, the caller only waits (in finish)
+  for (auto &r : state->reads) {
+    hedged_read::osd_read *rp = &r;
+    _executor->submit([this, state, rp] {
+      int rc;
+      try {
+        rc = _read_osd_slices_asd_direct_path(rp->osd, *rp->slices, rp);
+      } catch (std::exception &e) {
+        ALBA_LOG(INFO, "hedged read of osd " << rp->osd << ": " << e.what());
+        rc = -1;
+      }
+      {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        rp->rc = rc;
+        rp->done = true;
+        rp->busy = false;
+      }
+      state->cond.notify_all();
+    });
+  }
+  return result;
+}
+
+hedged_read::~hedged_read() {
+  if (_state) {
+    state &s = *_state;
+    std::unique_lock<std::mutex> lock(s.mutex);
+    for (auto &r : s.reads) {
+      if (!r.done) {
+        r.late = true;
+      }
+    }
+    s.cond.wait(lock, [&s] { return s.late_ones_let_go(); });
+  }
+}
+
+int hedged_read::finish(std::map<osd_t, int> &rcs,
+                        const std::function<std::function<bool()>(
+                            const std::vector<osd_t> &)> &hedge) {
+  state &s = *_state;
+  std::unique_lock<std::mutex> lock(s.mutex);
+  while (true) {
+    bool all_done = true;
+    auto first_deadline = std::chrono::steady_clock::time_point::max();
+    for (auto &r : s.reads) {
+      if (!r.done) {
+        all_done = false;
+        if (r.started) {
+          first_deadline = std::min(first_deadline, r.deadline);
+        }
+      }
+    }
+    if (all_done || (s.hedge_done && s.hedge_ok)) {
       break;
     }
+    if (s.hedging || first_deadline == first_deadline.max()) {
+      s.cond.wait(lock);
+      continue;
+    }
+    if (std::chrono::steady_clock::now() < first_deadline) {
+      s.cond.wait_until(lock, first_deadline);
+      continue;
+    }
+
+    // once one is late, the others get no more time
+    std::vector<osd_t> late;
+    for (auto &r : s.reads) {
+      if (!r.done) {
+        ALBA_LOG(DEBUG, "hedged_read: osd " << r.osd << " is late");
+        r.late = true;
+        late.push_back(r.osd);
+      }
+    }
+    s.hedging = true;
+    lock.unlock();
+    auto via_proxy = hedge(late);
+    auto shared = _state;
+    std::function<void()> run = [shared, via_proxy] {
+      bool ok = false;
+      try {
+        ok = via_proxy && via_proxy();
+      } catch (std::exception &e) {
+        ALBA_LOG(INFO, "hedged_read: the proxy failed: " << e.what());
+      }
+      {
+        std::lock_guard<std::mutex> lock(shared->mutex);
+        shared->hedge_done = true;
+        shared->hedge_ok = ok;
+      }
+      shared->cond.notify_all();
+    };
+    if (!s.executor->submit_if_idle(run)) {
+      // all threads are reading osds (slow ones, most likely)
+      run();
+    }
+    lock.lock();
+  }
+
+  // the late ones may be writing into the targets still, until they notice
+  s.cond.wait(lock, [&s] { return s.late_ones_let_go(); });
+
+  bool proxy_faster = false;
+  bool failed = false;
+  bool disqualified = false;
+  for (auto &r : s.reads) {
+    if (!r.done) {
+      // (and it won't touch the targets when it is)
+      rcs[r.osd] = LATE;
+      proxy_faster = true;
+      continue;
+    }
+    rcs[r.osd] = r.rc;
+    if (r.rc == 0) {
+      // it was late, but done before the proxy after all
+      for (auto &m : r.moves) {
+        memcpy(m.target, &r.buffer[m.pos], m.len);
+      }
+    } else if (r.rc == -2) {
+      disqualified = true;
+    } else {
+      failed = true;
+    }
+  }
+
+  if (failed) {
+    return -1;
+  } else if (proxy_faster) {
+    return LATE;
+  } else if (disqualified) {
+    return -2;
   }
-  return rc;
+  return 0;
+}
+
+int OsdAccess::parallel_for(size_t n, const std::function<int(size_t)> &f) {
+  if (nullptr == _executor) {
+    int rc = 0;
+    for (size_t i = 0; i < n && rc == 0; i++) {
+      rc = f(i);
+    }
+    return rc;
+  }
+  return executor::parallel_for(*_executor, n, _max_parallel_osd_reads, f);
 }
 
 int OsdAccess::_read_osd_slices_asd_direct_path(
-    osd_t osd, std::vector<asd_slice> &slices) {
+    osd_t osd, const std::vector<asd_slice> &slices, hedged_read::osd_read *r) {
   auto maybe_ic = _find_osd(osd);
   if (nullptr == maybe_ic) {
     ALBA_LOG(WARNING, "have context, but no info?");
     return -1;
   }
   auto p = asd_connection_pools.get_connection_pool(
-      maybe_ic->first, _connection_pool_size, _timeout);
+      maybe_ic->first, _connection_pool_size, _timeout, _timeout_floor,
+      _timeout_ceiling);
   if (nullptr == p) {
-    return -1;
+    // not an asd, that's not going to change by trying again
+    return -2;
   }
   auto connection = p->get_connection();
 
   if (connection) {
+    if (r != nullptr && !r->start()) {
+      // the proxy reads it instead
+      p->release_connection(std::move(connection));
+      return hedged_read::LATE;
+    }
+    auto timeout = p->read_timeout();
+    auto t0 = std::chrono::steady_clock::now();
     try {
-      // TODO 1 batch call...
-      for (auto &slice_ : slices) {
-        alba::asd_protocol::slice slice__;
-        slice__.offset = slice_.offset;
-        slice__.length = slice_.len;
-        slice__.target = slice_.target;
-        std::vector<alba::asd_protocol::slice> slices_{slice__};
-        connection->partial_get(slice_.key, slices_);
+      // (one per thread, so what it allocated is there for the next read)
+      static thread_local asd_read_plan plan;
+      plan.build(slices, _read_gap_tolerance);
+      if (r != nullptr) {
+        r->built(plan);
       }
+      // (the timeout is per response, and so is what the asd's latency
+      // is made of)
+      connection->partial_gets(plan.requests, _pipeline_depth, timeout, r);
+      auto &times = connection->response_times();
+      p->report_latencies(times, times.size());
       p->release_connection(std::move(connection));
+      if (r != nullptr) {
+        r->using_requests(plan.requests, plan.requests.size());
+      }
+      plan.scatter();
+      if (r != nullptr) {
+        r->done_with_requests();
+      }
       return 0;
     } catch (std::exception &e) {
+      if (r != nullptr) {
+        r->done_with_requests();
+      }
+      // what was answered counts, the last one is what failed
+      auto &times = connection->response_times();
+      auto elapsed = std::chrono::steady_clock::now() - t0;
+      if (!times.empty()) {
+        p->report_latencies(times, times.size() - 1);
+        elapsed = times.back();
+      }
+      if (elapsed >= timeout) {
+        // it took at least this long, the timeout has to learn from that
+        p->report_latency(elapsed);
+      }
       p->report_failure();
       ALBA_LOG(INFO, "exception in _read_osd_slices_asd_direct_path for osd "
                          << osd << " " << e.what());
@@ -148,6 +630,100 @@ int OsdAccess::_read_osd_slices_asd_direct_path(
   }
 }
 
+std::chrono::steady_clock::duration OsdAccess::_hedge_delay(osd_t osd,
+                                                          double percentile) {
+  auto maybe_ic = _find_osd(osd);
+  if (nullptr == maybe_ic) {
+    // the read fails right away
+    return _timeout;
+  }
+  auto p = asd_connection_pools.get_connection_pool(
+      maybe_ic->first, _connection_pool_size, _timeout, _timeout_floor,
+      _timeout_ceiling);
+  if (nullptr == p) {
+    return _timeout;
+  }
+  return p->latency_percentile(percentile);
+}
+
+void asd_read_plan::build(const std::vector<asd_slice> &slices,
+                          uint32_t gap_tolerance) {
+  // (the slices of the requests are kept, so their capacity is too)
+  for (auto &request : requests) {
+    request.slices.clear();
+    _spare.push_back(std::move(request.slices));
+  }
+  requests.clear();
+  scratch.clear();
+  copies.clear();
+
+  _sorted.clear();
+  for (auto &slice : slices) {
+    _sorted.push_back(&slice);
+  }
+  std::sort(_sorted.begin(), _sorted.end(),
+            [](const asd_slice *a, const asd_slice *b) {
+              int c = a->key->compare(*b->key);
+              return c < 0 || (c == 0 && a->offset < b->offset);
+            });
+
+  _ranges.clear();
+  for (size_t i = 0; i < _sorted.size(); i++) {
+    const asd_slice &s = *_sorted[i];
+    uint64_t end = (uint64_t)s.offset + s.len;
+    if (!_ranges.empty()) {
+      range &r = _ranges.back();
+      if (*_sorted[r.first]->key == *s.key &&
+          s.offset <= r.end + gap_tolerance) {
+        r.end = std::max(r.end, end);
+        r.last = i + 1;
+        continue;
+      }
+    }
+    _ranges.push_back(range{s.offset, end, i, i + 1});
+  }
+
+  size_t scratch_size = 0;
+  for (auto &r : _ranges) {
+    if (r.last - r.first > 1) {
+      scratch_size += r.end - r.offset;
+    }
+  }
+  scratch.resize(scratch_size);
+  size_t scratch_pos = 0;
+  for (auto &r : _ranges) {
+    const std::string &key = *_sorted[r.first]->key;
+    if (requests.empty() || *requests.back().key != key) {
+      requests.push_back(asd_client::partial_get_request{&key, {}});
+      if (!_spare.empty()) {
+        requests.back().slices.swap(_spare.back());
+        _spare.pop_back();
+      }
+    }
+    asd_protocol::slice slice;
+    slice.offset = r.offset;
+    slice.length = r.end - r.offset;
+    if (r.last - r.first == 1) {
+      slice.target = _sorted[r.first]->target;
+    } else {
+      slice.target = &scratch[scratch_pos];
+      for (size_t i = r.first; i < r.last; i++) {
+        const asd_slice &s = *_sorted[i];
+        copies.push_back(
+            copy{scratch_pos + (s.offset - r.offset), s.target, s.len});
+      }
+      scratch_pos += slice.length;
+    }
+    requests.back().slices.push_back(slice);
+  }
+}
+
+void asd_read_plan::scatter() const {
+  for (auto &c : copies) {
+    memcpy(c.target, &scratch[c.scratch_offset], c.len);
+  }
+}
+
 std::ostream &operator<<(std::ostream &os, const asd_slice &s) {
   os << "asd_slice{ _"
      << ", " << s.offset << ", " << s.len << ", _"
@@ -64,10 +64,39 @@ void Proxy_client::apply_sequence(const std::string &namespace_,
   this->apply_sequence(namespace_, write_barrier, seq._asserts, seq._updates);
 }
 
+std::ostream &operator<<(std::ostream &os, const cache_policy_t &policy) {
+  switch (policy) {
+  case cache_policy_t::LRU:
+    os << "LRU";
+    break;
+  case cache_policy_t::TWO_Q:
+    os << "TWO_Q";
+    break;
+  }
+  return os;
+}
+
 std::ostream &operator<<(std::ostream &os, const RoraConfig &cfg) {
   os << "RoraConfig{"
      << " manifest_cache_size= " << cfg.manifest_cache_size
-     << ", asd_connection_pool_size= " << cfg.asd_connection_pool_size << " }";
+     << ", asd_connection_pool_size= " << cfg.asd_connection_pool_size
+     << ", asd_partial_read_timeout_milliseconds= "
+     << cfg.asd_partial_read_timeout_milliseconds << " ["
+     << cfg.asd_partial_read_timeout_floor_milliseconds << ", "
+     << cfg.asd_partial_read_timeout_ceiling_milliseconds << "]"
+     << ", asd_hedge_percentile= " << cfg.asd_hedge_percentile
+     << ", asd_rebuild_fragments= " << cfg.asd_rebuild_fragments
+     << ", decompressed_fragment_cache_bytes= "
+     << cfg.decompressed_fragment_cache_bytes
+     << ", asd_verify_fragments= " << cfg.asd_verify_fragments
+     << ", max_parallel_osd_reads= " << cfg.max_parallel_osd_reads
+     << ", asd_read_gap_tolerance= " << cfg.asd_read_gap_tolerance
+     << ", asd_pipeline_depth= " << cfg.asd_pipeline_depth
+     << ", manifest_cache_bytes= " << cfg.manifest_cache_bytes
+     << ", manifest_cache_policy= " << cfg.manifest_cache_policy
+     << ", snapshot_path= " << cfg.snapshot_path
+     << ", snapshot_interval_seconds= " << cfg.snapshot_interval_seconds
+     << ", snapshot_max_manifests= " << cfg.snapshot_max_manifests << " }";
   return os;
 }
 }
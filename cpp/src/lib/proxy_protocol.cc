@@ -256,6 +256,12 @@ void _write_read_objects_slices_request(const int tag, message_builder &mb,
                                         const string &namespace_,
                                         const std::vector<ObjectSlices> &slices,
                                         const bool consistent_read) {
+  size_t size_hint = 4 + 4 + namespace_.size() + 4 + 1;
+  for (auto &object_slices : slices) {
+    size_hint += 4 + object_slices.object_name.size() + 4 +
+                 object_slices.slices.size() * (8 + 4);
+  }
+  mb.reserve(size_hint);
   write_tag(mb, tag);
   to(mb, namespace_);
   to(mb, slices);
@@ -326,6 +332,64 @@ void _read_object_infos(message &m, std::vector<object_info> &object_infos) {
   }
 }
 
+int64_t read_read_objects_slices_response_header(const char *header) {
+  uint32_t rc;
+  memcpy(&rc, header, 4);
+  if (rc != 0) {
+    return -1;
+  }
+  uint32_t size;
+  memcpy(&size, header + 4, 4);
+  return size;
+}
+
+void read_read_objects_slices2_response_tail(
+    message &m, std::vector<object_info> &object_infos) {
+  _read_object_infos(m, object_infos);
+}
+
+void read_read_objects_slices2_response_tail(
+    message &m, std::vector<encoded_object_info> &object_infos) {
+  // only finds where every manifest starts and ends,
+  // versions 1 and 2 both are a size followed by that many bytes.
+  uint32_t size;
+  from(m, size);
+  object_infos.reserve(size);
+  for (int32_t i = size - 1; i >= 0; --i) {
+    std::string name;
+    from(m, name);
+    alba_id_t alba_id;
+    from(m, alba_id);
+
+    message probe = m;
+    uint8_t version;
+    from(probe, version);
+    if (version != 1 && version != 2) {
+      throw llio::deserialisation_exception("unexpecteded Manifest version");
+    }
+    uint32_t manifest_size;
+    from(probe, manifest_size);
+    probe.current(manifest_size);
+    probe.skip(manifest_size);
+    namespace_t namespace_id;
+    from(probe, namespace_id);
+
+    uint32_t len = probe.get_pos() - m.get_pos();
+    object_infos.push_back(encoded_object_info{
+        std::move(name), std::move(alba_id), m.get_nested_message(len)});
+    m.skip(len);
+  }
+}
+
+std::shared_ptr<const CompactManifest>
+decode_manifest(const encoded_object_info &info) {
+  message m = info.manifest;
+  std::shared_ptr<const CompactManifest> mf;
+  bool ok_to_continue = false;
+  llio::from2(m, mf, ok_to_continue);
+  return mf;
+}
+
 void read_read_objects_slices2_response(
     message &m, Status &status, const std::vector<ObjectSlices> &objects_slices,
     std::vector<object_info> &object_infos) {
@@ -0,0 +1,363 @@
+/*
+Copyright (C) 2016 iNuron NV
+
+This file is part of Open vStorage Open Source Edition (OSE), as available from
+
+
+    http://www.openvstorage.org and
+    http://www.openvstorage.com.
+
+This file is free software; you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License v3 (GNU AGPLv3)
+as published by the Free Software Foundation, in version 3 as it comes
+in the <LICENSE.txt> file of the Open vStorage OSE distribution.
+
+Open vStorage is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY of any kind.
+*/
+
+#include "reed_solomon.h"
+#include <algorithm>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ALBA_RS_X86 1
+#endif
+
+namespace alba {
+namespace erasure {
+
+namespace {
+struct gf_tables {
+  uint8_t exp[512];
+  uint8_t log[256];
+
+  gf_tables() {
+    uint32_t x = 1;
+    for (uint32_t i = 0; i < 255; i++) {
+      exp[i] = x;
+      log[x] = i;
+      x <<= 1;
+      if (x & 0x100) {
+        x ^= 0x11d;
+      }
+    }
+    // so exp[log a + log b] needs no modulo
+    for (uint32_t i = 255; i < 512; i++) {
+      exp[i] = exp[i - 255];
+    }
+    log[0] = 0;
+  }
+};
+
+const gf_tables &_gf() {
+  static const gf_tables tables;
+  return tables;
+}
+
+uint8_t _inverse(uint8_t a) { return _gf().exp[255 - _gf().log[a]]; }
+
+/* jerasure's reed_sol_big_vandermonde_distribution_matrix(rows, cols, 8):
+   an extended vandermonde matrix turned into one with the identity on top
+   (by column operations), then scaled so row cols and the first column of
+   the rows below it are all ones. */
+std::vector<uint8_t> _distribution_matrix(uint32_t rows, uint32_t cols) {
+  std::vector<uint8_t> d(rows * cols, 0);
+  d[0] = 1;
+  if (rows > 1) {
+    d[(rows - 1) * cols + cols - 1] = 1;
+  }
+  for (uint32_t i = 1; i + 1 < rows; i++) {
+    uint8_t x = 1;
+    for (uint32_t j = 0; j < cols; j++) {
+      d[i * cols + j] = x;
+      x = gf_multiply(x, i);
+    }
+  }
+
+  for (uint32_t i = 1; i < cols; i++) {
+    // a row (from i down) with a non zero in column i becomes row i
+    uint32_t r = i;
+    while (r < rows && d[r * cols + i] == 0) {
+      r++;
+    }
+    if (r == rows) {
+      // (can't happen for the k and m alba allows)
+      return {};
+    }
+    if (r != i) {
+      for (uint32_t j = 0; j < cols; j++) {
+        std::swap(d[r * cols + j], d[i * cols + j]);
+      }
+    }
+    uint8_t e = d[i * cols + i];
+    if (e != 1) {
+      uint8_t s = _inverse(e);
+      for (uint32_t r2 = 0; r2 < rows; r2++) {
+        d[r2 * cols + i] = gf_multiply(s, d[r2 * cols + i]);
+      }
+    }
+    // the other columns get a multiple of column i to zero row i
+    for (uint32_t j = 0; j < cols; j++) {
+      uint8_t t = d[i * cols + j];
+      if (j != i && t != 0) {
+        for (uint32_t r2 = 0; r2 < rows; r2++) {
+          d[r2 * cols + j] ^= gf_multiply(t, d[r2 * cols + i]);
+        }
+      }
+    }
+  }
+
+  // row cols all ones: scale the columns (of the coding rows only)
+  for (uint32_t j = 0; j < cols; j++) {
+    uint8_t t = d[cols * cols + j];
+    if (t != 1) {
+      uint8_t s = _inverse(t);
+      for (uint32_t r = cols; r < rows; r++) {
+        d[r * cols + j] = gf_multiply(s, d[r * cols + j]);
+      }
+    }
+  }
+
+  // the first column of the rows below all ones: scale the rows
+  for (uint32_t r = cols + 1; r < rows; r++) {
+    uint8_t t = d[r * cols];
+    if (t != 1) {
+      uint8_t s = _inverse(t);
+      for (uint32_t j = 0; j < cols; j++) {
+        d[r * cols + j] = gf_multiply(d[r * cols + j], s);
+      }
+    }
+  }
+  return d;
+}
+
+// inverts the n x n matrix a in place, false if it's singular
+bool _invert(std::vector<uint8_t> &a, uint32_t n) {
+  std::vector<uint8_t> inv(n * n, 0);
+  for (uint32_t i = 0; i < n; i++) {
+    inv[i * n + i] = 1;
+  }
+  for (uint32_t c = 0; c < n; c++) {
+    uint32_t p = c;
+    while (p < n && a[p * n + c] == 0) {
+      p++;
+    }
+    if (p == n) {
+      return false;
+    }
+    if (p != c) {
+      for (uint32_t j = 0; j < n; j++) {
+        std::swap(a[p * n + j], a[c * n + j]);
+        std::swap(inv[p * n + j], inv[c * n + j]);
+      }
+    }
+    uint8_t s = _inverse(a[c * n + c]);
+    for (uint32_t j = 0; j < n; j++) {
+      a[c * n + j] = gf_multiply(s, a[c * n + j]);
+      inv[c * n + j] = gf_multiply(s, inv[c * n + j]);
+    }
+    for (uint32_t r = 0; r < n; r++) {
+      uint8_t t = a[r * n + c];
+      if (r != c && t != 0) {
+        for (uint32_t j = 0; j < n; j++) {
+          a[r * n + j] ^= gf_multiply(t, a[c * n + j]);
+          inv[r * n + j] ^= gf_multiply(t, inv[c * n + j]);
+        }
+      }
+    }
+  }
+  a.swap(inv);
+  return true;
+}
+
+/* the kernels: dst (^)= c * src, with c * x = lo[x & 15] ^ hi[x >> 4]
+   (16 entry tables, so a byte shuffle does 16 or 32 lookups at once) */
+struct nibble_tables {
+  uint8_t lo[16];
+  uint8_t hi[16];
+};
+
+void _tables(uint8_t c, nibble_tables &t) {
+  for (uint8_t x = 0; x < 16; x++) {
+    t.lo[x] = gf_multiply(c, x);
+    t.hi[x] = gf_multiply(c, x << 4);
+  }
+}
+
+void _mul_add_plain(const nibble_tables &t, const byte *src, byte *dst,
+                    size_t from, size_t len, bool first) {
+  for (size_t i = from; i < len; i++) {
+    uint8_t p = t.lo[src[i] & 0x0f] ^ t.hi[src[i] >> 4];
+    dst[i] = first ? p : dst[i] ^ p;
+  }
+}
+
+#ifdef ALBA_RS_X86
+__attribute__((target("ssse3"))) void
+_mul_add_ssse3(const nibble_tables &t, const byte *src, byte *dst,
+               size_t len, bool first) {
+  const __m128i lo = _mm_loadu_si128((const __m128i *)t.lo);
+  const __m128i hi = _mm_loadu_si128((const __m128i *)t.hi);
+  const __m128i mask = _mm_set1_epi8(0x0f);
+  size_t i = 0;
+  for (; i + 16 <= len; i += 16) {
+    __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+    __m128i p = _mm_xor_si128(
+        _mm_shuffle_epi8(lo, _mm_and_si128(s, mask)),
+        _mm_shuffle_epi8(hi, _mm_and_si128(_mm_srli_epi64(s, 4), mask)));
+    if (!first) {
+      p = _mm_xor_si128(p, _mm_loadu_si128((const __m128i *)(dst + i)));
+    }
+    _mm_storeu_si128((__m128i *)(dst + i), p);
+  }
+  _mul_add_plain(t, src, dst, i, len, first);
+}
+
+__attribute__((target("avx2"))) void
+_mul_add_avx2(const nibble_tables &t, const byte *src, byte *dst, size_t len,
+              bool first) {
+  // (the shuffle works per 128 bit lane, so both lanes get the tables)
+  const __m256i lo =
+      _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)t.lo));
+  const __m256i hi =
+      _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)t.hi));
+  const __m256i mask = _mm256_set1_epi8(0x0f);
+  size_t i = 0;
+  for (; i + 32 <= len; i += 32) {
+    __m256i s = _mm256_loadu_si256((const __m256i *)(src + i));
+    __m256i p = _mm256_xor_si256(
+        _mm256_shuffle_epi8(lo, _mm256_and_si256(s, mask)),
+        _mm256_shuffle_epi8(hi,
+                            _mm256_and_si256(_mm256_srli_epi64(s, 4), mask)));
+    if (!first) {
+      p = _mm256_xor_si256(p,
+                           _mm256_loadu_si256((const __m256i *)(dst + i)));
+    }
+    _mm256_storeu_si256((__m256i *)(dst + i), p);
+  }
+  _mul_add_plain(t, src, dst, i, len, first);
+}
+#endif
+
+void _mul_add_portable(const nibble_tables &t, const byte *src, byte *dst,
+                       size_t len, bool first) {
+  _mul_add_plain(t, src, dst, 0, len, first);
+}
+
+typedef void (*mul_add_t)(const nibble_tables &, const byte *, byte *, size_t,
+                          bool);
+
+mul_add_t _pick_mul_add() {
+#ifdef ALBA_RS_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return _mul_add_avx2;
+  }
+  if (__builtin_cpu_supports("ssse3")) {
+    return _mul_add_ssse3;
+  }
+#endif
+  return _mul_add_portable;
+}
+}
+
+uint8_t gf_multiply(uint8_t a, uint8_t b) {
+  if (a == 0 || b == 0) {
+    return 0;
+  }
+  auto &gf = _gf();
+  return gf.exp[gf.log[a] + gf.log[b]];
+}
+
+std::vector<uint8_t> coding_matrix(uint32_t k, uint32_t m) {
+  if (k == 0 || m == 0 || k + m > 256) {
+    return {};
+  }
+  auto d = _distribution_matrix(k + m, k);
+  if (d.empty()) {
+    return d;
+  }
+  return std::vector<uint8_t>(d.begin() + k * k, d.end());
+}
+
+bool decoding_coefficients(uint32_t k, uint32_t m,
+                           const std::vector<uint32_t> &sources,
+                           uint32_t wanted,
+                           std::vector<uint8_t> &coefficients) {
+  if (sources.size() != k || wanted >= k + m) {
+    return false;
+  }
+  auto cm = coding_matrix(k, m);
+  if (cm.empty()) {
+    return false;
+  }
+  // the rows of the sources in the (k + m) x k generator matrix
+  std::vector<uint8_t> a(k * k, 0);
+  for (uint32_t i = 0; i < k; i++) {
+    uint32_t s = sources[i];
+    if (s >= k + m) {
+      return false;
+    }
+    if (s < k) {
+      a[i * k + s] = 1;
+    } else {
+      std::copy(&cm[(s - k) * k], &cm[(s - k) * k] + k, &a[i * k]);
+    }
+  }
+  if (!_invert(a, k)) {
+    return false;
+  }
+
+  // (the row of wanted in the generator) * a^-1
+  coefficients.assign(k, 0);
+  for (uint32_t j = 0; j < k; j++) {
+    uint8_t g = wanted < k ? (j == wanted) : cm[(wanted - k) * k + j];
+    if (g == 0) {
+      continue;
+    }
+    for (uint32_t i = 0; i < k; i++) {
+      coefficients[i] ^= gf_multiply(g, a[j * k + i]);
+    }
+  }
+  return true;
+}
+
+void combine(const uint8_t *coefficients, const byte *const *sources,
+             size_t n, byte *out, size_t len) {
+  static const mul_add_t mul_add = _pick_mul_add();
+  bool first = true;
+  for (size_t i = 0; i < n; i++) {
+    if (coefficients[i] == 0) {
+      continue;
+    }
+    if (coefficients[i] == 1) {
+      if (first) {
+        memcpy(out, sources[i], len);
+      } else {
+        for (size_t b = 0; b < len; b++) {
+          out[b] ^= sources[i][b];
+        }
+      }
+    } else {
+      nibble_tables t;
+      _tables(coefficients[i], t);
+      mul_add(t, sources[i], out, len, first);
+    }
+    first = false;
+  }
+  if (first) {
+    memset(out, 0, len);
+  }
+}
+
+void encode(uint32_t k, uint32_t m, const byte *const *data,
+            byte *const *parity, size_t len) {
+  auto cm = coding_matrix(k, m);
+  for (uint32_t p = 0; p < m && !cm.empty(); p++) {
+    combine(&cm[p * k], data, k, parity[p], len);
+  }
+}
+}
+}
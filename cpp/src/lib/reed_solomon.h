@@ -0,0 +1,62 @@
+/*
+Copyright (C) 2016 iNuron NV
+
+This file is part of Open vStorage Open Source Edition (OSE), as available from
+
+
+    http://www.openvstorage.org and
+    http://www.openvstorage.com.
+
+This file is free software; you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License v3 (GNU AGPLv3)
+as published by the Free Software Foundation, in version 3 as it comes
+in the <LICENSE.txt> file of the Open vStorage OSE distribution.
+
+Open vStorage is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY of any kind.
+*/
+
+#pragma once
+#include "alba_common.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace alba {
+namespace erasure {
+
+/* Reed-Solomon over GF(2^8) (polynomial 0x11d), the way alba encodes a
+   chunk: jerasure's reed_sol_vandermonde_coding_matrix with w = 8, which
+   the isa-l encoder of the ocaml side uses as well. Fragments 0 .. k-1
+   are the data, k .. k+m-1 the parity.
+   It works byte by byte, so any range of a fragment can be rebuilt from
+   the same range of any k other fragments of its chunk.
+*/
+
+// EncodingScheme::w as a manifest has it for w = 8
+const uint8_t W8 = 1;
+
+// the m x k coding matrix, row after row
+std::vector<uint8_t> coding_matrix(uint32_t k, uint32_t m);
+
+/* the coefficients to compute fragment wanted from the (k different)
+   fragments in sources: wanted = sum of coefficients[i] * sources[i].
+   false if that can't be done (wrong number of sources, or one of them
+   out of range). */
+bool decoding_coefficients(uint32_t k, uint32_t m,
+                           const std::vector<uint32_t> &sources,
+                           uint32_t wanted,
+                           std::vector<uint8_t> &coefficients);
+
+/* out[0 .. len[ = sum of coefficients[i] * sources[i][0 .. len[
+   (with the widest kernel the cpu has: avx2, ssse3 or plain c++) */
+void combine(const uint8_t *coefficients, const byte *const *sources,
+             size_t n, byte *out, size_t len);
+
+// the m parity fragments of k data fragments of len bytes
+void encode(uint32_t k, uint32_t m, const byte *const *data,
+            byte *const *parity, size_t len);
+
+uint8_t gf_multiply(uint8_t a, uint8_t b);
+}
+}
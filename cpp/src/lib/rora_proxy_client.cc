@@ -21,8 +21,10 @@ but WITHOUT ANY WARRANTY of any kind.
 #include "asd_client.h"
 #include "manifest.h"
 #include "manifest_cache.h"
+#include "snapshot.h"
 #include "osd_access.h"
 
+#include <exception>
 #include <gcrypt.h>
 
 namespace alba {
@@ -36,6 +38,16 @@ RoraProxy_client::RoraProxy_client(
       _asd_connection_pool_size(rora_config.asd_connection_pool_size),
       _asd_partial_read_timeout(std::chrono::milliseconds(
           rora_config.asd_partial_read_timeout_milliseconds)),
+      _asd_partial_read_timeout_floor(std::chrono::milliseconds(
+          rora_config.asd_partial_read_timeout_floor_milliseconds)),
+      _asd_partial_read_timeout_ceiling(std::chrono::milliseconds(
+          rora_config.asd_partial_read_timeout_ceiling_milliseconds)),
+      _max_parallel_osd_reads(rora_config.max_parallel_osd_reads),
+      _asd_read_gap_tolerance(rora_config.asd_read_gap_tolerance),
+      _asd_pipeline_depth(rora_config.asd_pipeline_depth),
+      _asd_hedge_percentile(rora_config.asd_hedge_percentile),
+      _asd_rebuild_fragments(rora_config.asd_rebuild_fragments),
+      _asd_verify_fragments(rora_config.asd_verify_fragments),
       _ser_version(boost::none) {
 
   if (!gcry_control(GCRYCTL_INITIALIZATION_FINISHED_P)) {
@@ -45,7 +57,20 @@ RoraProxy_client::RoraProxy_client(
 
   ALBA_LOG(INFO, "RoraProxy_client( _asd_connection_pool_size = "
                      << _asd_connection_pool_size << " ...)");
-  ManifestCache::getInstance().set_capacity(rora_config.manifest_cache_size);
+  ovs::eviction_policy policy =
+      rora_config.manifest_cache_policy == cache_policy_t::TWO_Q
+          ? ovs::eviction_policy::TWO_Q
+          : ovs::eviction_policy::LRU;
+  ManifestCache::getInstance().set_capacity(
+      rora_config.manifest_cache_size, rora_config.manifest_cache_bytes, policy);
+  DecompressedFragmentCache::getInstance().set_capacity(
+      rora_config.decompressed_fragment_cache_bytes);
+  if (!rora_config.snapshot_path.empty()) {
+    _snapshot_writer = shared_snapshot_writer(
+        _osd_access(), rora_config.snapshot_path,
+        std::chrono::seconds(rora_config.snapshot_interval_seconds),
+        rora_config.snapshot_max_manifests);
+  }
   _fast_path_failures = 0;
   try {
     _has_local_fragment_cache = _delegate->has_local_fragment_cache();
@@ -89,24 +114,24 @@ RoraProxy_client::RoraProxy_client(
 }
 
 bool RoraProxy_client::namespace_exists(const string &name) {
-  return _delegate->namespace_exists(name);
+  return _proxy().namespace_exists(name);
 };
 
 void RoraProxy_client::create_namespace(
     const string &name, const boost::optional<string> &preset_name) {
-  _delegate->create_namespace(name, preset_name);
+  _proxy().create_namespace(name, preset_name);
 };
 
 void RoraProxy_client::delete_namespace(const string &name) {
-  _delegate->delete_namespace(name);
+  _proxy().delete_namespace(name);
 };
 
 std::tuple<std::vector<string>, has_more> RoraProxy_client::list_namespaces(
     const string &first, const include_first include_first_,
     const boost::optional<string> &last, const include_last include_last_,
     const int max, const reverse reverse_) {
-  return _delegate->list_namespaces(first, include_first_, last, include_last_,
-                                    max, reverse_);
+  return _proxy().list_namespaces(first, include_first_, last, include_last_,
+                                  max, reverse_);
 }
 
 void RoraProxy_client::write_object_fs(const string &namespace_,
@@ -134,44 +159,45 @@ void RoraProxy_client::read_object_fs(const string &namespace_,
                                       const string &dest_file,
                                       const consistent_read consistent_read_,
                                       const should_cache should_cache_) {
-  _delegate->read_object_fs(namespace_, object_name, dest_file,
-                            consistent_read_, should_cache_);
+  _proxy().read_object_fs(namespace_, object_name, dest_file,
+                          consistent_read_, should_cache_);
 }
 
 void RoraProxy_client::delete_object(const string &namespace_,
                                      const string &object_name,
                                      const may_not_exist may_not_exist_) {
-  _delegate->delete_object(namespace_, object_name, may_not_exist_);
+  _proxy().delete_object(namespace_, object_name, may_not_exist_);
 }
 
 std::tuple<std::vector<string>, has_more> RoraProxy_client::list_objects(
     const string &namespace_, const string &first,
     const include_first include_first_, const boost::optional<string> &last,
     const include_last include_last_, const int max, const reverse reverse_) {
-  return _delegate->list_objects(namespace_, first, include_first_, last,
-                                 include_last_, max, reverse_);
-}
-
-string RoraProxy_client::_fragment_key(const namespace_t namespace_id,
-                                       const string &object_id,
-                                       uint32_t version_id, uint32_t chunk_id,
-                                       uint32_t fragment_id) {
-  char instance_content_prefix = 'p';
-  _fkb.add_raw(&instance_content_prefix, 1);
-  uint32_t zero = 0;
-  to(_fkb, zero);
-  char namespace_char = 'n';
-  _fkb.add_raw(&namespace_char, 1);
-  alba::to_be(_fkb, namespace_id);
-  char prefix = 'o';
-  _fkb.add_raw(&prefix, 1);
-  to(_fkb, object_id);
-  to(_fkb, chunk_id);
-  to(_fkb, fragment_id);
-  to(_fkb, version_id);
-  string r = _fkb.as_string_no_size();
-  _fkb.reset();
-  return r;
+  return _proxy().list_objects(namespace_, first, include_first_, last,
+                               include_last_, max, reverse_);
+}
+
+RoraProxy_client::~RoraProxy_client() {
+  // (a hedge might still be reading via the delegate)
+  _proxy();
+}
+
+GenericProxy_client &RoraProxy_client::_proxy() {
+  if (_hedge_in_flight) {
+    hedge &h = *_hedge_in_flight;
+    std::unique_lock<std::mutex> lock(h.mutex);
+    h.cond.wait(lock, [&h] { return h.done; });
+    lock.unlock();
+    _hedge_in_flight.reset();
+  }
+  return *_delegate;
+}
+
+OsdAccess &RoraProxy_client::_osd_access() {
+  return OsdAccess::getInstance(
+      _asd_connection_pool_size, _asd_partial_read_timeout,
+      _max_parallel_osd_reads, _asd_read_gap_tolerance, _asd_pipeline_depth,
+      _asd_partial_read_timeout_floor, _asd_partial_read_timeout_ceiling);
 }
 
 void _dump(std::map<osd_t, std::vector<asd_slice>> &per_osd) {
@@ -196,11 +222,10 @@ void RoraProxy_client::_maybe_update_osd_infos(
 
   ALBA_LOG(DEBUG, "RoraProxy_client::_maybe_update_osd_infos(_)");
   bool ok = true;
-  auto &access = OsdAccess::getInstance(_asd_connection_pool_size,
-                                        _asd_partial_read_timeout);
+  auto &access = _osd_access();
   for (auto &item : per_osd) {
     osd_t osd = item.first;
-    if (access.osd_is_unknown(osd)) {
+    if (!item.second.empty() && access.osd_is_unknown(osd)) {
       ok = false;
       break;
     }
@@ -212,199 +237,95 @@ void RoraProxy_client::_maybe_update_osd_infos(
   }
 }
 
-Location get_location(ManifestWithNamespaceId &mf, uint64_t pos, uint32_t len) {
-  int chunk_index = -1;
-  uint64_t total = 0;
-
-  {
-    auto it = mf.chunk_sizes.begin();
-    while (total <= pos) {
-      chunk_index++;
-      auto chunk_size = *it;
-      total += chunk_size;
-      it++;
-    }
-  }
+int RoraProxy_client::_short_path(
+    std::map<osd_t, std::vector<asd_slice>> &per_osd,
+    std::map<osd_t, int> &rcs) {
 
-  auto &chunk_fragments = mf.fragments[chunk_index];
-
-  uint32_t chunk_size = mf.chunk_sizes[chunk_index];
-  total -= chunk_size;
-  uint32_t fragment_length = chunk_size / mf.encoding_scheme.k;
-  uint32_t pos_in_chunk = pos - total;
-
-  uint32_t fragment_index = pos_in_chunk / fragment_length;
-  auto &fragment = chunk_fragments[fragment_index];
-
-  total += fragment_length * fragment_index;
-  uint32_t pos_in_fragment = pos - total;
-
-  Location l;
-  l.namespace_id = mf.namespace_id;
-  l.object_id = mf.object_id;
-  l.chunk_id = chunk_index;
-  l.fragment_id = fragment_index;
-  l.fragment_location = fragment->loc;
-  l.offset = pos_in_fragment;
-  l.length = std::min(len, fragment_length - pos_in_fragment);
-  l.uses_compression =
-      mf.compression->get_compressor() != compressor_t::NO_COMPRESSION;
-  l.encrypt_info = mf.encrypt_info;
-  l.ctr = fragment->ctr;
-  return l;
-}
-
-void _resolve_slice_one_level(std::vector<std::pair<byte *, Location>> &results,
-                              ManifestWithNamespaceId &manifest,
-                              uint64_t offset, uint32_t length, byte *target) {
-  while (length > 0) {
-    results.emplace_back(target, get_location(manifest, offset, length));
-    auto len = results.back().second.length;
-    length -= len;
-    offset += len;
-    target += len;
-  };
-}
+  ALBA_LOG(DEBUG, "_short_path locations.size()=" << _plan.locations.size());
 
-boost::optional<std::vector<std::pair<byte *, Location>>>
-_resolve_one_level(const alba_id_t &alba_id, const std::string &namespace_,
-                   const ObjectSlices obj_slices) {
-  auto &cache = ManifestCache::getInstance();
-  auto mf = cache.find(namespace_, alba_id, obj_slices.object_name);
-  if (mf == nullptr) {
-    ALBA_LOG(DEBUG, "manifest for alba_id=" << alba_id << ", obj_slices="
-                                            << obj_slices << " not found");
-    return boost::none;
+  // everything to read is now nicely sorted per osd.
+  //_dump(per_osd);
+  if (_use_null_io) {
+    for (auto &item : per_osd) {
+      if (!item.second.empty()) {
+        rcs[item.first] = 0;
+      }
+    }
+    return 0;
   } else {
-    ALBA_LOG(DEBUG, "manifest for alba_id=" << alba_id << ", obj_slices="
-                                            << obj_slices << " found");
-    std::vector<std::pair<byte *, Location>> results;
-    for (auto &slice : obj_slices.slices) {
-      _resolve_slice_one_level(results, *mf, slice.offset, slice.size,
-                               slice.buf);
-    }
-    return results;
+    return _osd_access()
+        .read_osds_slices(per_osd, rcs);
   }
 }
 
-boost::optional<std::vector<std::pair<byte *, Location>>>
-_resolve_one_many_levels(const std::vector<alba_id_t> &alba_levels,
-                         const uint alba_level_num,
-                         const std::string &namespace_,
-                         const ObjectSlices &obj_slices) {
-  auto &alba_id = alba_levels[alba_level_num];
-  auto locations = _resolve_one_level(alba_id, namespace_, obj_slices);
-  if (locations == boost::none) {
-    return boost::none;
-  } else {
-    if ((alba_level_num + 1) < alba_levels.size()) {
-      std::vector<std::pair<byte *, Location>> locations_final_level;
-      locations_final_level.reserve(locations->size());
-      for (auto &buf_l : *locations) {
-        auto &l = std::get<1>(buf_l);
-        message_builder mb;
-        to(mb, l.object_id);
-        to(mb, l.chunk_id);
-        to(mb, l.fragment_id);
-        SliceDescriptor slice{std::get<0>(buf_l), l.offset, l.length};
-        std::vector<SliceDescriptor> slices{slice};
-
-        string r = mb.as_string();
-        string fragment_cache_object_name = r.substr(4, r.size() - 4);
-
-        ObjectSlices obj_slices{fragment_cache_object_name, slices};
-        ALBA_LOG(DEBUG, "_resolve_one_many_levels: obj_slices=" << obj_slices);
-
-        auto locations = _resolve_one_many_levels(
-            alba_levels, alba_level_num + 1, namespace_, obj_slices);
-        if (locations == boost::none) {
-          return boost::none;
-        } else {
-          for (auto &l : *locations) {
-            locations_final_level.push_back(l);
-          }
-        }
-      }
-      return locations_final_level;
-    } else {
-      return locations;
-    }
+void RoraProxy_client::_process(std::vector<object_info> &object_infos,
+                                const string &namespace_) {
+  std::vector<compact_object_info> compact_infos;
+  compact_infos.reserve(object_infos.size());
+  for (auto &object_info : object_infos) {
+    compact_infos.emplace_back(
+        std::move(std::get<0>(object_info)),
+        std::move(std::get<1>(object_info)),
+        std::make_shared<const CompactManifest>(*std::get<2>(object_info)));
+    std::get<2>(object_info).reset();
   }
+  _process(compact_infos, namespace_);
 }
 
-int RoraProxy_client::_short_path(
-    const std::vector<std::pair<byte *, Location>> &locations) {
-
-  ALBA_LOG(DEBUG, "_short_path locations.size()=" << locations.size());
-
-  std::map<osd_t, std::vector<asd_slice>> per_osd;
-
-  for (auto &bl : locations) {
-    auto &target = std::get<0>(bl);
-    auto &l = std::get<1>(bl);
-
-    osd_t osd_id = *l.fragment_location.first;
-    uint32_t version_id = l.fragment_location.second;
-
-    asd_slice slice;
-    slice.offset = l.offset;
-    slice.len = l.length;
-    slice.target = target;
-    string key = _fragment_key(l.namespace_id, l.object_id, version_id,
-                               l.chunk_id, l.fragment_id);
-    slice.key = key;
-
-    auto it = per_osd.find(osd_id);
-    if (it == per_osd.end()) {
-      std::vector<asd_slice> slices;
-      per_osd[osd_id] = slices;
-      it = per_osd.find(osd_id);
-    }
-    auto &slices = it->second;
-    slices.push_back(slice);
+void RoraProxy_client::_process(std::vector<encoded_object_info> &object_infos,
+                                const string &namespace_) {
+  ALBA_LOG(DEBUG, "_process : " << object_infos.size());
+  if (object_infos.empty()) {
+    return;
   }
-
-  // everything to read is now nicely sorted per osd.
-  _maybe_update_osd_infos(per_osd);
-  //_dump(per_osd);
-  if (_use_null_io) {
+  // the decoding (snappy & co) of a large batch is spread over
+  // the osd reading threads
+  std::vector<compact_object_info> compact_infos(object_infos.size());
+  _osd_access().parallel_for(object_infos.size(), [&](size_t i) {
+    auto &info = object_infos[i];
+    try {
+      std::get<2>(compact_infos[i]) = decode_manifest(info);
+    } catch (alba::llio::deserialisation_exception &e) {
+      ALBA_LOG(WARNING, "skipping name=" << info.name << " because of "
+                                         << e.what());
+      return 0;
+    }
+    std::get<0>(compact_infos[i]) = std::move(info.name);
+    std::get<1>(compact_infos[i]) = std::move(info.alba_id);
     return 0;
-  } else {
-    return OsdAccess::getInstance(_asd_connection_pool_size,
-                                  _asd_partial_read_timeout)
-        .read_osds_slices(per_osd);
-  }
+  });
+  _process(compact_infos, namespace_);
 }
 
-void RoraProxy_client::_process(std::vector<object_info> &object_infos,
+void RoraProxy_client::_process(std::vector<compact_object_info> &object_infos,
                                 const string &namespace_) {
 
   ALBA_LOG(DEBUG, "_process : " << object_infos.size());
+  std::vector<std::pair<alba_id_t, manifest_cache_entry>> entries;
+  entries.reserve(object_infos.size());
   for (auto &object_info : object_infos) {
-    using alba::stuff::operator<<;
-
-    manifest_cache_entry manifest_cache_entry_ =
-        std::shared_ptr<alba::proxy_protocol::ManifestWithNamespaceId>(
-            std::get<2>(object_info).release());
-    string alba_id = std::get<1>(object_info);
+    if (std::get<2>(object_info) == nullptr) {
+      continue;
+    }
+    string alba_id = std::move(std::get<1>(object_info));
     if (alba_id == "") {
-      alba_id = OsdAccess::getInstance(_asd_connection_pool_size,
-                                       _asd_partial_read_timeout)
+      alba_id = _osd_access()
                     .get_alba_levels(*this)
                     .at(0);
     }
-    ManifestCache::getInstance().add(namespace_, alba_id,
-                                     std::move(manifest_cache_entry_));
+    entries.emplace_back(std::move(alba_id),
+                         std::move(std::get<2>(object_info)));
   }
+  ManifestCache::getInstance().add(namespace_, std::move(entries));
 }
 
-void RoraProxy_client::_slow_path(const std::string &namespace_,
-                                  const std::vector<ObjectSlices> &slices,
-                                  const consistent_read consistent_read_,
-                                  std::vector<object_info> &object_infos,
-                                  alba::statistics::RoraCounter &cntr) {
-  _delegate->read_objects_slices2(namespace_, slices, consistent_read_,
-                                  object_infos, cntr);
+void RoraProxy_client::_slow_path(
+    const std::string &namespace_, const std::vector<ObjectSlices> &slices,
+    const consistent_read consistent_read_,
+    std::vector<encoded_object_info> &object_infos,
+    alba::statistics::RoraCounter &cntr) {
+  _proxy().read_objects_slices2(namespace_, slices, consistent_read_,
+                                object_infos, cntr);
 }
 
 void RoraProxy_client::read_objects_slices(
@@ -425,111 +346,333 @@ void RoraProxy_client::read_objects_slices(
   }
 
   if (use_slow_path) {
-    std::vector<object_info> object_infos;
+    std::vector<encoded_object_info> object_infos;
     _slow_path(namespace_, slices, consistent_read_, object_infos, cntr);
     _process(object_infos, namespace_);
 
   } else {
-    std::vector<std::pair<byte *, Location>> short_path;
-    std::vector<ObjectSlices> via_proxy;
-    auto alba_levels = OsdAccess::getInstance(_asd_connection_pool_size,
-                                              _asd_partial_read_timeout)
-                           .get_alba_levels(*this);
-    for (auto &object_slices : slices) {
-      auto locations =
-          _resolve_one_many_levels(alba_levels, 0, namespace_, object_slices);
-      if (locations == boost::none ||
-          std::any_of(
-              locations->begin(), locations->end(),
-              [](std::pair<byte *, Location> &l) {
-                auto &location = std::get<1>(l);
-                return location.fragment_location.first == boost::none ||
-                       location.uses_compression ||
-                       !location.encrypt_info->supports_partial_decrypt();
-              })) {
-        via_proxy.push_back(object_slices);
-      } else {
-        for (auto &l : *locations) {
-          short_path.push_back(l);
-        }
-      }
+    _osd_access().get_alba_levels(*this, _alba_levels);
+    _plan.build(_alba_levels, namespace_, slices, _asd_rebuild_fragments);
+    _via_proxy.clear();
+    for (size_t i : _plan.via_proxy) {
+      _via_proxy.push_back(slices[i]);
     }
 
-    // TODO: different paths could go in parallel
-    int result_front = _short_path(short_path);
-    ALBA_LOG(DEBUG, "_short_path result => " << result_front);
-
-    if (!result_front) {
-      // maybe decrypt data
-      try {
-        for (auto &s : short_path) {
-          unsigned char *buf = s.first;
-          alba::proxy_protocol::Location &l = s.second;
-          switch (l.encrypt_info->get_encryption()) {
-          case encryption_t::NO_ENCRYPTION:
-            break;
-          case encryption_t::ENCRYPTED:
-            auto encrypt_info =
-                static_cast<encryption::Encrypted *>(l.encrypt_info.get());
-
-            if (l.ctr == boost::none) {
-              ALBA_LOG(ERROR, "ctr==boost::none while doing ctr partial decrypt");
-              throw 0;
-            }
-
-            auto enc_key =
-                get_encryption_key(alba_levels.back(), l.namespace_id,
-                                   encrypt_info->key_identification);
-
-            if (!encrypt_info->partial_decrypt(buf, l.length, enc_key, *l.ctr,
-                                               l.offset)) {
-              ALBA_LOG(
-                  ERROR,
-                  "Could not partially decrypt data, which is unexpected!");
-              throw 0;
-            }
-            break;
+    // (this can talk to the proxy, so it goes before the slow path starts)
+    _maybe_update_osd_infos(_plan.per_osd);
+
+    // the proxy reads what's not in the cache while the asds are read.
+    // (the slow path gets its own counter, cntr is only touched here)
+    int result_front = 0;
+    std::vector<encoded_object_info> object_infos;
+    alba::statistics::RoraCounter slow_cntr;
+    std::exception_ptr slow_path_error;
+    std::unique_ptr<hedged_read> hedged;
+    std::shared_ptr<hedge> hedge_;
+    if (_asd_hedge_percentile > 0 && !_use_null_io) {
+      hedged = _osd_access().start_hedged_read(_plan.per_osd,
+                                               _asd_hedge_percentile);
+    }
+    if (hedged) {
+      // the asds are read in the background, the proxy's share meanwhile.
+      // then the osds that are late are raced with the proxy, on the
+      // same connection, so their hedge starts once that share is in.
+      if (!_via_proxy.empty()) {
+        try {
+          _slow_path(namespace_, _via_proxy, consistent_read_, object_infos,
+                     slow_cntr);
+        } catch (...) {
+          slow_path_error = std::current_exception();
+        }
+      }
+      result_front = hedged->finish(
+          _plan.osd_results, [&](const std::vector<osd_t> &late) {
+            hedge_ = _hedge(namespace_, slices, late, consistent_read_);
+            _hedge_in_flight = hedge_;
+            std::shared_ptr<hedge> h = hedge_;
+            GenericProxy_client *proxy = _delegate.get();
+            return std::function<bool()>([h, proxy] { return h->run(*proxy); });
+          });
+    } else if (_via_proxy.empty()) {
+      result_front = _short_path(_plan.per_osd, _plan.osd_results);
+    } else {
+      _osd_access().parallel_for(2, [&](size_t i) -> int {
+        if (i == 0) {
+          result_front = _short_path(_plan.per_osd, _plan.osd_results);
+        } else {
+          try {
+            _slow_path(namespace_, _via_proxy, consistent_read_,
+                       object_infos, slow_cntr);
+          } catch (...) {
+            slow_path_error = std::current_exception();
           }
         }
-      } catch (std::exception &e) {
-        result_front = -1;
-        ALBA_LOG(ERROR,
-                 "partial decrypt failed due to an exception: " << e.what());
-      } catch (...) {
-        result_front = -1;
+        return 0;
+      });
+    }
+    ALBA_LOG(DEBUG, "_short_path result => " << result_front);
+    cntr.slow_path += slow_cntr.slow_path;
+
+    // maybe decrypt data (of the osds that could be read)
+    bool decrypted = true;
+    size_t n_read = 0;
+    try {
+      if (_asd_verify_fragments) {
+        _plan.verify_direct();
       }
+      n_read += _decrypt_direct();
+      // what couldn't be read from its own fragment is rebuilt from others
+      if (_asd_rebuild_fragments && result_front && !_use_null_io &&
+          _plan.plan_rebuilds()) {
+        _osd_access().read_osds_slices(_plan.rebuild_per_osd,
+                                       _plan.rebuild_results);
+      }
+      auto decrypt = [this](byte *buf, const Location &l) {
+        _decrypt(buf, l);
+      };
+      n_read += _plan.rebuild(decrypt);
+      n_read += _plan.decompress(decrypt, _asd_verify_fragments);
+      n_read += _plan.decrypt_windows(decrypt);
+    } catch (std::exception &e) {
+      decrypted = false;
+      ALBA_LOG(ERROR,
+               "partial decrypt failed due to an exception: " << e.what());
+    } catch (...) {
+      decrypted = false;
     }
 
-    if (result_front) {
+    _fallback.clear();
+    if (!decrypted) {
       _failure_time = std::chrono::steady_clock::now();
-      if (result_front != -2) {
-        // disqualified osds shouldn't result in disqualifying the fast path
-        _fast_path_failures++;
+      _fast_path_failures++;
+      _plan.direct_slices(slices, _fallback);
+    } else {
+      if (result_front) {
+        _failure_time = std::chrono::steady_clock::now();
+        if (result_front == -1) {
+          // disqualified osds (or late ones, when hedging) shouldn't result
+          // in disqualifying the fast path
+          _fast_path_failures++;
+        }
+      } else {
+        _fast_path_failures = 0;
       }
-      via_proxy.clear();
-      for (auto &s : slices) {
-        via_proxy.push_back(s);
+      if (n_read < _plan.locations.size()) {
+        // what the other osds had is in place (or rebuilt),
+        // only the slices of the ones that failed go via the proxy
+        _plan.failed_slices(slices, _fallback);
       }
-    } else {
-      _fast_path_failures = 0;
-      cntr.fast_path += short_path.size();
+      cntr.fast_path += n_read;
     }
 
-    if (via_proxy.size() > 0) {
+    // what the proxy was faster for when hedging
+    _fill_hedged(hedge_.get(), _fallback, object_infos, cntr);
+
+    if (slow_path_error) {
+      std::rethrow_exception(slow_path_error);
+    }
+    _process(object_infos, namespace_);
+
+    if (_fallback.size() > 0) {
       ALBA_LOG(DEBUG, "rora read_objects_slices going via proxy, size="
-                          << via_proxy.size());
-      std::vector<object_info> object_infos;
-      _slow_path(namespace_, via_proxy, consistent_read_, object_infos, cntr);
+                          << _fallback.size());
+      object_infos.clear();
+      _slow_path(namespace_, _fallback, consistent_read_, object_infos, cntr);
       _process(object_infos, namespace_);
     }
   }
 }
 
+bool RoraProxy_client::hedge::run(GenericProxy_client &proxy) {
+  bool result = true;
+  if (!slices.empty()) {
+    try {
+      proxy.read_objects_slices2(namespace_, slices, consistent_read_,
+                                 object_infos, cntr);
+    } catch (std::exception &e) {
+      ALBA_LOG(INFO, "hedge via the proxy failed: " << e.what());
+      result = false;
+    } catch (...) {
+      result = false;
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    done = true;
+    ok = result;
+  }
+  cond.notify_all();
+  return result;
+}
+
+std::shared_ptr<RoraProxy_client::hedge>
+RoraProxy_client::_hedge(const string &namespace_,
+                         const std::vector<ObjectSlices> &slices,
+                         const std::vector<osd_t> &late,
+                         const consistent_read consistent_read_) {
+  // (only one at a time uses the proxy)
+  _proxy();
+  std::vector<ObjectSlices> on_late;
+  _plan.slices_on(late, slices, on_late);
+
+  auto h = std::make_shared<hedge>();
+  h->namespace_ = namespace_;
+  h->consistent_read_ = consistent_read_;
+  size_t size = 0;
+  for (auto &object_slices : on_late) {
+    for (auto &slice : object_slices.slices) {
+      size += slice.size;
+    }
+  }
+  h->buffer.resize(size);
+  h->object_names.reserve(on_late.size());
+  size_t pos = 0;
+  for (auto &object_slices : on_late) {
+    std::vector<SliceDescriptor> own_slices;
+    for (auto &slice : object_slices.slices) {
+      own_slices.push_back(
+          SliceDescriptor{&h->buffer[pos], slice.offset, slice.size});
+      h->targets.push_back(hedge::target{slice.buf, slice.size, pos});
+      pos += slice.size;
+    }
+    h->object_names.push_back(object_slices.object_name);
+    h->slices.push_back(ObjectSlices{h->object_names.back(), own_slices});
+  }
+  ALBA_LOG(DEBUG, "hedging " << late.size() << " late osd(s) with "
+                             << h->slices.size()
+                             << " object(s) via the proxy");
+  return h;
+}
+
+void RoraProxy_client::_fill_hedged(
+    hedge *h, std::vector<ObjectSlices> &fallback,
+    std::vector<encoded_object_info> &object_infos,
+    alba::statistics::RoraCounter &cntr) {
+  if (h == nullptr) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(h->mutex);
+    if (!h->done || !h->ok) {
+      return;
+    }
+  }
+  std::move(h->object_infos.begin(), h->object_infos.end(),
+            std::back_inserter(object_infos));
+  h->object_infos.clear();
+  cntr.slow_path += h->cntr.slow_path;
+  if (fallback.empty()) {
+    return;
+  }
+  std::vector<ObjectSlices> rest;
+  for (auto &object_slices : fallback) {
+    std::vector<SliceDescriptor> left;
+    for (auto &slice : object_slices.slices) {
+      auto it = std::find_if(h->targets.begin(), h->targets.end(),
+                             [&slice](const hedge::target &t) {
+                               return t.buf == slice.buf &&
+                                      t.size == slice.size;
+                             });
+      if (it == h->targets.end()) {
+        left.push_back(slice);
+      } else {
+        memcpy(slice.buf, &h->buffer[it->pos], slice.size);
+      }
+    }
+    if (!left.empty()) {
+      rest.push_back(ObjectSlices{object_slices.object_name, left});
+    }
+  }
+  fallback.swap(rest);
+}
+
+void RoraProxy_client::_decrypt(byte *buf, const Location &l) {
+  switch (l.encrypt_info->get_encryption()) {
+  case encryption_t::NO_ENCRYPTION:
+    break;
+  case encryption_t::ENCRYPTED:
+    auto encrypt_info =
+        static_cast<const encryption::Encrypted *>(l.encrypt_info);
+    bool cbc = encrypt_info->mode == encryption::chaining_mode_t::CBC;
+
+    if (!cbc && l.ctr == boost::none) {
+      ALBA_LOG(ERROR, "ctr==boost::none while doing ctr partial decrypt");
+      throw 0;
+    }
+
+    auto enc_key = get_encryption_key(_alba_levels.back(), l.namespace_id,
+                                      encrypt_info->key_identification);
+
+    string ctr;
+    if (!cbc) {
+      ctr = l.ctr->to_string();
+    } else if (l.offset == 0) {
+      ctr = encrypt_info->fragment_iv(enc_key, l.object_id.to_string(),
+                                      l.chunk_id, l.fragment_id);
+    } else {
+      // the block before (see fast_path_plan)
+      ctr.assign((const char *)buf - 16, 16);
+    }
+    if (!encrypt_info->partial_decrypt(buf, l.length, enc_key, ctr,
+                                       l.offset)) {
+      ALBA_LOG(ERROR, "Could not partially decrypt data, which is unexpected!");
+      throw 0;
+    }
+    break;
+  }
+}
+
+size_t RoraProxy_client::_decrypt_direct() {
+  size_t n = 0;
+  const encryption::Encrypted *encrypt_info = nullptr;
+  namespace_t namespace_id{0};
+  auto flush = [&]() {
+    if (_decrypt_slices.empty()) {
+      return;
+    }
+    auto enc_key = get_encryption_key(_alba_levels.back(), namespace_id,
+                                      encrypt_info->key_identification);
+    if (!encrypt_info->partial_decrypt(enc_key, _decrypt_slices.data(),
+                                       _decrypt_slices.size())) {
+      ALBA_LOG(ERROR, "Could not partially decrypt data, which is unexpected!");
+      throw 0;
+    }
+    _decrypt_slices.clear();
+  };
+
+  // (the encrypt infos are interned: one per key)
+  for (size_t i = 0; i < _plan.locations.size(); i++) {
+    if (!_plan.direct(i)) {
+      continue;
+    }
+    n++;
+    auto &bl = _plan.locations[i];
+    const Location &l = bl.second;
+    if (l.encrypt_info->get_encryption() == encryption_t::NO_ENCRYPTION) {
+      continue;
+    }
+    auto info = static_cast<const encryption::Encrypted *>(l.encrypt_info);
+    if (info != encrypt_info) {
+      flush();
+      encrypt_info = info;
+      namespace_id = l.namespace_id;
+    }
+    if (l.ctr == boost::none || l.ctr->size() != 16) {
+      ALBA_LOG(ERROR, "no ctr while doing ctr partial decrypt");
+      throw 0;
+    }
+    _decrypt_slices.push_back(encryption::Encrypted::slice{
+        bl.first, l.length, (const unsigned char *)l.ctr->data(), l.offset});
+  }
+  flush();
+  return n;
+}
+
 std::tuple<uint64_t, Checksum *> RoraProxy_client::get_object_info(
     const string &namespace_, const string &object_name,
     const consistent_read consistent_read_, const should_cache should_cache_) {
-  return _delegate->get_object_info(namespace_, object_name, consistent_read_,
-                                    should_cache_);
+  return _proxy().get_object_info(namespace_, object_name, consistent_read_,
+                                  should_cache_);
 }
 
 void RoraProxy_client::apply_sequence(
@@ -537,84 +680,89 @@ void RoraProxy_client::apply_sequence(
     const std::vector<std::shared_ptr<sequences::Assert>> &asserts,
     const std::vector<std::shared_ptr<sequences::Update>> &updates) {
   std::vector<proxy_protocol::object_info> object_infos;
-  _delegate->apply_sequence_(namespace_, write_barrier, asserts, updates,
-                             object_infos);
+  _proxy().apply_sequence_(namespace_, write_barrier, asserts, updates,
+                           object_infos);
 
   _process(object_infos, namespace_);
 }
 
 void RoraProxy_client::invalidate_cache(const std::string &namespace_) {
   ManifestCache::getInstance().invalidate_namespace(namespace_);
-  _delegate->invalidate_cache(namespace_);
+  _proxy().invalidate_cache(namespace_);
 }
 
 void RoraProxy_client::drop_cache(const string &namespace_) {
-  _delegate->drop_cache(namespace_);
+  ManifestCache::getInstance().demote_namespace(namespace_);
+  _proxy().drop_cache(namespace_);
 }
 
 std::tuple<int32_t, int32_t, int32_t, string>
 RoraProxy_client::get_proxy_version() {
-  return _delegate->get_proxy_version();
+  return _proxy().get_proxy_version();
 }
 
 double RoraProxy_client::ping(const double delay) {
-  return _delegate->ping(delay);
+  return _proxy().ping(delay);
 }
 
 void RoraProxy_client::osd_info(osd_map_t &result) {
   ALBA_LOG(DEBUG, "RoraProxy_client::osd_info");
-  _delegate->osd_info(result);
+  _proxy().osd_info(result);
 }
 
 void RoraProxy_client::osd_info2(osd_maps_t &result) {
   ALBA_LOG(DEBUG, "RoraProxy_client::osd_info2");
-  _delegate->osd_info2(result);
+  _proxy().osd_info2(result);
 }
 
 boost::optional<string>
 RoraProxy_client::get_fragment_encryption_key(const string &alba_id,
                                               const namespace_t namespace_id) {
-  return _delegate->get_fragment_encryption_key(alba_id, namespace_id);
+  return _proxy().get_fragment_encryption_key(alba_id, namespace_id);
 }
 
 string RoraProxy_client::get_encryption_key(const string &alba_id,
                                             const namespace_t namespace_id,
                                             const string &key_identification) {
-  auto find_key = _enc_keys.find(key_identification);
-  if (find_key == _enc_keys.end()) {
-    auto enc_key = *get_fragment_encryption_key(alba_id, namespace_id);
+  {
+    std::lock_guard<std::mutex> g(_enc_keys_mutex);
+    auto find_key = _enc_keys.find(key_identification);
+    if (find_key != _enc_keys.end()) {
+      return find_key->second;
+    }
+  }
 
-    int gcrypt_result;
+  // (without the lock, this asks the proxy)
+  auto enc_key = *get_fragment_encryption_key(alba_id, namespace_id);
 
-    gcry_md_hd_t hd;
-    gcrypt_result = gcry_md_open(&hd, GCRY_MD_SHA256, 0);
-    if (gcrypt_result != 0) {
-      ALBA_LOG(ERROR, "gcry_md_open failed: " << gcrypt_result);
-      throw 0;
-    }
+  int gcrypt_result;
 
-    gcry_md_write(hd, enc_key.c_str(), enc_key.size());
+  gcry_md_hd_t hd;
+  gcrypt_result = gcry_md_open(&hd, GCRY_MD_SHA256, 0);
+  if (gcrypt_result != 0) {
+    ALBA_LOG(ERROR, "gcry_md_open failed: " << gcrypt_result);
+    throw 0;
+  }
 
-    gcrypt_result = gcry_md_final(hd);
-    if (gcrypt_result != 0) {
-      ALBA_LOG(ERROR, "gcry_md_final failed: " << gcrypt_result);
-      throw 0;
-    }
+  gcry_md_write(hd, enc_key.c_str(), enc_key.size());
+
+  gcrypt_result = gcry_md_final(hd);
+  if (gcrypt_result != 0) {
+    ALBA_LOG(ERROR, "gcry_md_final failed: " << gcrypt_result);
+    throw 0;
+  }
 
-    unsigned char *sha256 = gcry_md_read(hd, GCRY_MD_SHA256);
-    string key_identification2((char *)sha256, 256 / 8);
+  unsigned char *sha256 = gcry_md_read(hd, GCRY_MD_SHA256);
+  string key_identification2((char *)sha256, 256 / 8);
 
-    gcry_md_close(hd);
+  gcry_md_close(hd);
 
-    if (key_identification == key_identification2) {
-      std::tie(find_key, std::ignore) =
-          _enc_keys.emplace(key_identification, enc_key);
-    } else {
-      _enc_keys.emplace(key_identification2, enc_key);
-      throw 0;
-    }
+  std::lock_guard<std::mutex> g(_enc_keys_mutex);
+  _enc_keys.emplace(key_identification2, enc_key);
+  if (key_identification != key_identification2) {
+    throw 0;
   }
-  return find_key->second;
+  return enc_key;
 }
 }
 }
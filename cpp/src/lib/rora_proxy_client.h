@@ -18,16 +18,21 @@ but WITHOUT ANY WARRANTY of any kind.
 
 #pragma once
 
+#include "fast_path.h"
 #include "generic_proxy_client.h"
 #include "osd_access.h"
 #include "osd_info.h"
 #include "proxy_client.h"
 
+#include <condition_variable>
+#include <mutex>
 #include <unordered_map>
 
 namespace alba {
 namespace proxy_client {
 
+class SnapshotWriter;
+
 using namespace proxy_protocol;
 using namespace std::chrono;
 
@@ -98,18 +103,30 @@ public:
   get_fragment_encryption_key(const string &alba_id,
                               const namespace_t namespace_id);
 
-  virtual ~RoraProxy_client(){};
+  virtual ~RoraProxy_client();
 
 private:
   std::unique_ptr<GenericProxy_client> _delegate;
 
   void _process(std::vector<object_info> &object_infos,
                 const string &namespace_);
+  void _process(std::vector<compact_object_info> &object_infos,
+                const string &namespace_);
+  void _process(std::vector<encoded_object_info> &object_infos,
+                const string &namespace_);
 
   void
   _maybe_update_osd_infos(std::map<osd_t, std::vector<asd_slice>> &per_osd);
 
-  int _short_path(const std::vector<std::pair<byte *, Location>> &);
+  int _short_path(std::map<osd_t, std::vector<asd_slice>> &per_osd,
+                  std::map<osd_t, int> &rcs);
+  // in place, throws if it can't
+  // (for CBC, the iv is before buf, see fast_path_plan)
+  void _decrypt(byte *buf, const Location &);
+  // the locations read straight into their targets, decrypted in one
+  // pass per key. returns how many there are.
+  size_t _decrypt_direct();
+  std::vector<encryption::Encrypted::slice> _decrypt_slices;
 
   bool _use_null_io;
 
@@ -120,19 +137,74 @@ private:
 
   int _asd_connection_pool_size;
   std::chrono::steady_clock::duration _asd_partial_read_timeout;
-
-  message_builder _fkb;
-  string _fragment_key(const namespace_t namespace_id, const string &object_id,
-                       uint32_t version_id, uint32_t chunk_id,
-                       uint32_t fragment_id);
+  std::chrono::steady_clock::duration _asd_partial_read_timeout_floor;
+  std::chrono::steady_clock::duration _asd_partial_read_timeout_ceiling;
+  int _max_parallel_osd_reads;
+  uint32_t _asd_read_gap_tolerance;
+  int _asd_pipeline_depth;
+  double _asd_hedge_percentile;
+  bool _asd_rebuild_fragments;
+  bool _asd_verify_fragments;
+
+  OsdAccess &_osd_access();
+
+  // reused from one read_objects_slices to the next
+  fast_path_plan _plan;
+  std::vector<alba_id_t> _alba_levels;
+  std::vector<ObjectSlices> _via_proxy;
+  std::vector<ObjectSlices> _fallback;
   boost::optional<int> _ser_version;
 
   void _slow_path(const std::string &namespace_,
                   const std::vector<ObjectSlices> &, const consistent_read,
-                  std::vector<object_info> &object_infos,
+                  std::vector<encoded_object_info> &object_infos,
                   alba::statistics::RoraCounter &);
 
+  /* the read via the proxy of what needs the late osds, when hedging,
+     into a buffer of its own. It runs on a thread of the executor and can
+     outlive the read_objects_slices that started it, so it owns all it
+     uses (but the proxy, see _proxy). */
+  struct hedge {
+    bool run(GenericProxy_client &);
+
+    std::string namespace_;
+    consistent_read consistent_read_;
+    std::vector<std::string> object_names; // (reserved, slices point here)
+    std::vector<ObjectSlices> slices;      // into buffer
+    std::vector<byte> buffer;
+    struct target {
+      byte *buf; // the caller's
+      uint32_t size;
+      size_t pos; // in buffer
+    };
+    std::vector<target> targets;
+    std::vector<encoded_object_info> object_infos;
+    alba::statistics::RoraCounter cntr;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool done = false;
+    bool ok = false;
+  };
+  std::shared_ptr<hedge> _hedge(const std::string &namespace_,
+                                const std::vector<ObjectSlices> &,
+                                const std::vector<osd_t> &late,
+                                const consistent_read);
+  // once h is done, fills in the slices it read, and takes them out of
+  // fallback (it's not waited for: the asds were first when it isn't done)
+  void _fill_hedged(hedge *h, std::vector<ObjectSlices> &fallback,
+                    std::vector<encoded_object_info> &object_infos,
+                    alba::statistics::RoraCounter &);
+  // the last hedge, that may still be using the proxy
+  std::shared_ptr<hedge> _hedge_in_flight;
+  // the delegate, once the last hedge is done with it
+  GenericProxy_client &_proxy();
+
+  std::mutex _enc_keys_mutex;
   std::unordered_map<string, string> _enc_keys;
+
+  // last, so it's gone before anything it might look at
+  std::shared_ptr<SnapshotWriter> _snapshot_writer;
   string get_encryption_key(const string &alba_id,
                             const namespace_t namespace_id,
                             const string &key_identification);
@@ -0,0 +1,412 @@
+/*
+Copyright (C) 2016 iNuron NV
+
+This file is part of Open vStorage Open Source Edition (OSE), as available from
+
+
+    http://www.openvstorage.org and
+    http://www.openvstorage.com.
+
+This file is free software; you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License v3 (GNU AGPLv3)
+as published by the Free Software Foundation, in version 3 as it comes
+in the <LICENSE.txt> file of the Open vStorage OSE distribution.
+
+Open vStorage is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY of any kind.
+*/
+
+#include "snapshot.h"
+#include "alba_logger.h"
+
+#include <boost/crc.hpp>
+#include <cstring>
+#include <fcntl.h>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace alba {
+namespace proxy_client {
+
+using std::string;
+using llio::message;
+using llio::message_buffer;
+using llio::message_builder;
+using llio::from;
+using llio::to;
+
+namespace {
+const char _MAGIC[8] = {'R', 'O', 'R', 'A', 'S', 'N', 'A', 'P'};
+const uint32_t _VERSION = 3;
+const size_t _HEADER_SIZE = sizeof(_MAGIC) + 4 + 4;
+
+uint32_t _crc32(const char *data, size_t len) {
+  boost::crc_32_type crc;
+  crc.process_bytes(data, len);
+  return crc.checksum();
+}
+
+/* the vector/optional templates in llio are noexcept,
+   so we don't use them to read what might be a damaged file */
+void _to_strings(message_builder &mb, const std::vector<string> &ss) {
+  to(mb, (uint32_t)ss.size());
+  for (auto &s : ss) {
+    to(mb, s);
+  }
+}
+
+void _from_strings(message &m, std::vector<string> &ss) {
+  uint32_t n;
+  from(m, n);
+  ss.resize(n);
+  for (auto &s : ss) {
+    from(m, s);
+  }
+}
+
+void _to_optional_string(message_builder &mb,
+                         const boost::optional<string> &so) {
+  to(mb, so != boost::none);
+  if (so != boost::none) {
+    to(mb, *so);
+  }
+}
+
+void _from_optional_string(message &m, boost::optional<string> &so) {
+  bool has;
+  from(m, has);
+  if (has) {
+    string s;
+    from(m, s);
+    so = std::move(s);
+  } else {
+    so = boost::none;
+  }
+}
+
+void _to_osd_maps(message_builder &mb, const osd_maps_t &osd_maps) {
+  to(mb, (uint32_t)osd_maps.size());
+  for (auto &level : osd_maps) {
+    to(mb, level.first);
+    to(mb, (uint32_t)level.second.size());
+    for (auto &p : level.second) {
+      to(mb, p.first.i);
+      const OsdInfo &info = p.second->first;
+      const OsdCapabilities &caps = p.second->second;
+      to(mb, info.kind_asd);
+      to(mb, info.long_id);
+      _to_strings(mb, info.ips);
+      to(mb, info.port);
+      to(mb, info.use_tls);
+      to(mb, info.use_rdma);
+      to(mb, info.node_id);
+
+      to(mb, caps.rora_port != boost::none);
+      if (caps.rora_port != boost::none) {
+        to(mb, *caps.rora_port);
+      }
+      _to_optional_string(mb, caps.rora_transport);
+      to(mb, caps.rora_ips != boost::none);
+      if (caps.rora_ips != boost::none) {
+        _to_strings(mb, *caps.rora_ips);
+      }
+    }
+  }
+}
+
+void _from_osd_maps(message &m, osd_maps_t &osd_maps) {
+  uint32_t n_levels;
+  from(m, n_levels);
+  osd_maps.resize(n_levels);
+  for (auto &level : osd_maps) {
+    from(m, level.first);
+    uint32_t n_osds;
+    from(m, n_osds);
+    for (uint32_t i = 0; i < n_osds; i++) {
+      osd_t osd;
+      from(m, osd.i);
+      auto ic = std::make_shared<info_caps>();
+      OsdInfo &info = ic->first;
+      OsdCapabilities &caps = ic->second;
+      from(m, info.kind_asd);
+      from(m, info.long_id);
+      _from_strings(m, info.ips);
+      from(m, info.port);
+      from(m, info.use_tls);
+      from(m, info.use_rdma);
+      from(m, info.node_id);
+
+      bool has;
+      from(m, has);
+      if (has) {
+        uint32_t port;
+        from(m, port);
+        caps.rora_port = port;
+      }
+      _from_optional_string(m, caps.rora_transport);
+      from(m, has);
+      if (has) {
+        std::vector<string> ips;
+        _from_strings(m, ips);
+        caps.rora_ips = std::move(ips);
+      }
+      level.second[osd] = std::move(ic);
+    }
+  }
+}
+
+/* encryption info is written the way the proxy sends it,
+   so the llio reader can be reused */
+void _to_encrypt_info(message_builder &mb, const EncryptInfo &ei) {
+  if (ei.get_encryption() == encryption::encryption_t::NO_ENCRYPTION) {
+    mb.add_type(1);
+    return;
+  }
+  const auto &e = dynamic_cast<const encryption::Encrypted &>(ei);
+  mb.add_type(2);
+  mb.add_type(1); // AES
+  mb.add_type(e.mode == encryption::chaining_mode_t::CBC ? 1 : 2);
+  mb.add_type(1); // L256
+  mb.add_type(1); // KeySha256
+  to(mb, e.key_identification);
+}
+
+// a CompactManifest is a relocatable block: it goes in as is
+void _to_manifest(message_builder &mb, const CompactManifest &mf) {
+  _to_encrypt_info(mb, *mf.encrypt_info());
+  to(mb, (uint32_t)mf.block_size());
+  mb.add_raw(mf.block(), mf.block_size());
+}
+
+manifest_cache_entry _from_manifest(message &m) {
+  std::shared_ptr<EncryptInfo> encrypt_info;
+  from(m, encrypt_info);
+  uint32_t size;
+  from(m, size);
+  auto mf = std::make_shared<const CompactManifest>(m.current(size), size,
+                                                    std::move(encrypt_info));
+  m.skip(size);
+  return mf;
+}
+}
+
+void write_snapshot(const string &path, const snapshot &snapshot) {
+  message_builder mb(1 << 20);
+  _to_osd_maps(mb, snapshot.osd_maps);
+  to(mb, (uint32_t)snapshot.manifests.size());
+  for (auto &cm : snapshot.manifests) {
+    to(mb, cm.namespace_);
+    to(mb, cm.alba_id);
+    _to_manifest(mb, *cm.manifest);
+  }
+
+  std::ostringstream tmp_ss;
+  tmp_ss << path << ".tmp." << getpid() << "." << std::this_thread::get_id();
+  string tmp = tmp_ss.str();
+  int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    ALBA_LOG(WARNING, "write_snapshot: could not open " << tmp << ": "
+                                                        << strerror(errno));
+    return;
+  }
+  bool ok = true;
+  auto write_all = [&](const char *data, size_t len) {
+    while (ok && len > 0) {
+      ssize_t n = ::write(fd, data, len);
+      if (n < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        ok = false;
+      } else {
+        data += n;
+        len -= n;
+      }
+    }
+  };
+  mb.output_using([&](const char *buffer, const int len) {
+    uint32_t version = _VERSION;
+    uint32_t crc = _crc32(buffer, len);
+    write_all(_MAGIC, sizeof(_MAGIC));
+    write_all((const char *)&version, 4);
+    write_all((const char *)&crc, 4);
+    write_all(buffer, len);
+  });
+  ok = ok && (::fsync(fd) == 0);
+  ::close(fd);
+  if (!ok || ::rename(tmp.c_str(), path.c_str()) != 0) {
+    ALBA_LOG(WARNING, "write_snapshot: could not write " << path << ": "
+                                                         << strerror(errno));
+    ::unlink(tmp.c_str());
+    return;
+  }
+  ALBA_LOG(DEBUG, "write_snapshot: " << path << " ("
+                                     << snapshot.manifests.size()
+                                     << " manifests)");
+}
+
+bool read_snapshot(const string &path, snapshot &snapshot) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    ALBA_LOG(INFO, "read_snapshot: no snapshot at " << path);
+    return false;
+  }
+  struct stat st;
+  if (::fstat(fd, &st) != 0 || (size_t)st.st_size < _HEADER_SIZE + 4) {
+    ALBA_LOG(WARNING, "read_snapshot: " << path << " is too small");
+    ::close(fd);
+    return false;
+  }
+  size_t file_size = st.st_size;
+  void *p = ::mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (p == MAP_FAILED) {
+    ALBA_LOG(WARNING, "read_snapshot: could not map " << path << ": "
+                                                      << strerror(errno));
+    return false;
+  }
+  const char *data = (const char *)p;
+  uint32_t version, crc, size;
+  memcpy(&version, data + sizeof(_MAGIC), 4);
+  memcpy(&crc, data + sizeof(_MAGIC) + 4, 4);
+  memcpy(&size, data + _HEADER_SIZE, 4);
+  const char *body = data + _HEADER_SIZE;
+  size_t body_size = file_size - _HEADER_SIZE;
+  const char *problem = nullptr;
+  if (memcmp(data, _MAGIC, sizeof(_MAGIC)) != 0) {
+    problem = "not a snapshot";
+  } else if (version != _VERSION) {
+    problem = "unknown version";
+  } else if (size + 4 != body_size) {
+    problem = "truncated";
+  } else if (_crc32(body, body_size) != crc) {
+    problem = "checksum mismatch";
+  }
+  std::shared_ptr<message_buffer> buffer;
+  if (problem == nullptr) {
+    buffer = message_buffer::with_size(size);
+    memcpy(buffer->data(0), body + 4, size);
+  }
+  ::munmap(p, file_size);
+  if (problem != nullptr) {
+    ALBA_LOG(WARNING, "read_snapshot: ignoring " << path << ": " << problem);
+    return false;
+  }
+
+  try {
+    message m(buffer);
+    osd_maps_t osd_maps;
+    _from_osd_maps(m, osd_maps);
+    uint32_t n;
+    from(m, n);
+    std::vector<cached_manifest> manifests(n);
+    for (auto &cm : manifests) {
+      from(m, cm.namespace_);
+      from(m, cm.alba_id);
+      cm.manifest = _from_manifest(m);
+    }
+    snapshot.osd_maps = std::move(osd_maps);
+    snapshot.manifests = std::move(manifests);
+  } catch (llio::deserialisation_exception &e) {
+    ALBA_LOG(WARNING, "read_snapshot: ignoring " << path << ": " << e.what());
+    return false;
+  }
+  ALBA_LOG(INFO, "read_snapshot: " << path << " has "
+                                   << snapshot.osd_maps.size()
+                                   << " alba levels and "
+                                   << snapshot.manifests.size()
+                                   << " manifests");
+  return true;
+}
+
+snapshot take_snapshot(OsdAccess &osd_access, size_t max_manifests) {
+  snapshot r;
+  r.osd_maps = osd_access.get_osd_maps();
+  r.manifests = ManifestCache::getInstance().hottest(max_manifests);
+  return r;
+}
+
+void restore_snapshot(OsdAccess &osd_access, snapshot &&snapshot) {
+  if (!osd_access.restore(std::move(snapshot.osd_maps))) {
+    // the osds we know of are more recent
+    ALBA_LOG(INFO, "restore_snapshot: keeping the current osd maps");
+  }
+  auto &cache = ManifestCache::getInstance();
+  // the least valuable go in first, so they're also the first to go
+  for (auto it = snapshot.manifests.rbegin(); it != snapshot.manifests.rend();
+       ++it) {
+    if (nullptr ==
+        cache.find(it->namespace_, it->alba_id, it->manifest->name())) {
+      cache.add(it->namespace_, it->alba_id, std::move(it->manifest));
+    }
+  }
+}
+
+SnapshotWriter::SnapshotWriter(OsdAccess &osd_access, std::string path,
+                               std::chrono::steady_clock::duration interval,
+                               size_t max_manifests)
+    : _osd_access(osd_access), _path(std::move(path)), _interval(interval),
+      _max_manifests(max_manifests), _stopping(false),
+      _thread(&SnapshotWriter::_run, this) {}
+
+SnapshotWriter::~SnapshotWriter() {
+  {
+    std::lock_guard<std::mutex> g(_mutex);
+    _stopping = true;
+  }
+  _cond.notify_all();
+  _thread.join();
+  write();
+}
+
+void SnapshotWriter::write() {
+  snapshot s = take_snapshot(_osd_access, _max_manifests);
+  if (s.osd_maps.empty()) {
+    // nothing useful yet
+    return;
+  }
+  write_snapshot(_path, s);
+}
+
+void SnapshotWriter::_run() {
+  std::unique_lock<std::mutex> lock(_mutex);
+  while (!_stopping) {
+    if (!_cond.wait_for(lock, _interval, [this] { return _stopping; })) {
+      lock.unlock();
+      write();
+      lock.lock();
+    }
+  }
+}
+
+std::shared_ptr<SnapshotWriter>
+shared_snapshot_writer(OsdAccess &osd_access, const string &path,
+                       std::chrono::steady_clock::duration interval,
+                       size_t max_manifests) {
+  static std::mutex mutex;
+  static bool restored = false;
+  static std::weak_ptr<SnapshotWriter> current;
+
+  std::lock_guard<std::mutex> g(mutex);
+  if (!restored) {
+    restored = true;
+    snapshot s;
+    if (read_snapshot(path, s)) {
+      restore_snapshot(osd_access, std::move(s));
+    }
+  }
+  auto writer = current.lock();
+  if (nullptr == writer) {
+    writer = std::make_shared<SnapshotWriter>(osd_access, path, interval,
+                                              max_manifests);
+    current = writer;
+  } else if (writer->path() != path) {
+    ALBA_LOG(WARNING, "shared_snapshot_writer: already writing to "
+                          << writer->path() << ", ignoring " << path);
+  }
+  return writer;
+}
+}
+}
@@ -0,0 +1,92 @@
+/*
+Copyright (C) 2016 iNuron NV
+
+This file is part of Open vStorage Open Source Edition (OSE), as available from
+
+
+    http://www.openvstorage.org and
+    http://www.openvstorage.com.
+
+This file is free software; you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License v3 (GNU AGPLv3)
+as published by the Free Software Foundation, in version 3 as it comes
+in the <LICENSE.txt> file of the Open vStorage OSE distribution.
+
+Open vStorage is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY of any kind.
+*/
+
+#pragma once
+#include "manifest_cache.h"
+#include "osd_access.h"
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace alba {
+namespace proxy_client {
+
+/* what a rora client needs to take the fast path right after a restart:
+   the osd maps (one per alba level) and the hottest manifests.
+
+   file layout: "RORASNAP" | version (4) | crc32 (4) | size (4) | payload
+   where the crc covers size and payload.
+*/
+struct snapshot {
+  osd_maps_t osd_maps;
+  std::vector<cached_manifest> manifests; // the most valuable first
+};
+
+void write_snapshot(const std::string &path, const snapshot &);
+
+// false if there's no (usable) snapshot at path
+bool read_snapshot(const std::string &path, snapshot &);
+
+snapshot take_snapshot(OsdAccess &, size_t max_manifests);
+
+// manifests the cache already has are left alone: they're at least as fresh
+void restore_snapshot(OsdAccess &, snapshot &&);
+
+/* writes a snapshot every interval, and a last one when it's destroyed */
+class SnapshotWriter {
+public:
+  SnapshotWriter(OsdAccess &, std::string path,
+                 std::chrono::steady_clock::duration interval,
+                 size_t max_manifests);
+  ~SnapshotWriter();
+
+  SnapshotWriter(const SnapshotWriter &) = delete;
+  SnapshotWriter &operator=(const SnapshotWriter &) = delete;
+
+  void write();
+
+  const std::string &path() const { return _path; }
+
+private:
+  void _run();
+
+  OsdAccess &_osd_access;
+  const std::string _path;
+  const std::chrono::steady_clock::duration _interval;
+  const size_t _max_manifests;
+
+  std::mutex _mutex;
+  std::condition_variable _cond;
+  bool _stopping;
+  std::thread _thread;
+};
+
+/* the snapshot is restored only once per process (by the first client that
+   asks), and all clients share a single writer, which writes a last
+   snapshot when the last of them lets go of it.
+*/
+std::shared_ptr<SnapshotWriter>
+shared_snapshot_writer(OsdAccess &, const std::string &path,
+                       std::chrono::steady_clock::duration interval,
+                       size_t max_manifests);
+}
+}
@@ -36,6 +36,95 @@ using namespace boost::asio;
       std::chrono::duration_cast<std::chrono::milliseconds>(t).count())
 #define _NEVER boost::posix_time::pos_infin
 
+void *handler_memory::allocate(std::size_t size) {
+  if (!_in_use && size <= sizeof(_storage)) {
+    _in_use = true;
+    return &_storage;
+  }
+  return ::operator new(size);
+}
+
+void handler_memory::deallocate(void *p) {
+  if (p == &_storage) {
+    _in_use = false;
+  } else {
+    ::operator delete(p);
+  }
+}
+
+namespace {
+
+template <typename T> class handler_allocator {
+public:
+  using value_type = T;
+
+  explicit handler_allocator(handler_memory &memory) : _memory(memory) {}
+
+  template <typename U>
+  handler_allocator(const handler_allocator<U> &other) noexcept
+      : _memory(other._memory) {}
+
+  bool operator==(const handler_allocator &other) const noexcept {
+    return &_memory == &other._memory;
+  }
+
+  bool operator!=(const handler_allocator &other) const noexcept {
+    return &_memory != &other._memory;
+  }
+
+  T *allocate(std::size_t n) const {
+    return static_cast<T *>(_memory.allocate(sizeof(T) * n));
+  }
+
+  void deallocate(T *p, std::size_t) const { _memory.deallocate(p); }
+
+private:
+  template <typename> friend class handler_allocator;
+  handler_memory &_memory;
+};
+
+template <typename Handler> class custom_alloc_handler {
+public:
+  using allocator_type = handler_allocator<Handler>;
+
+  custom_alloc_handler(handler_memory &memory, Handler handler)
+      : _memory(memory), _handler(handler) {}
+
+  allocator_type get_allocator() const noexcept {
+    return allocator_type(_memory);
+  }
+
+  template <typename... Args> void operator()(Args &&... args) {
+    _handler(std::forward<Args>(args)...);
+  }
+
+private:
+  handler_memory &_memory;
+  Handler _handler;
+};
+
+template <typename Handler>
+custom_alloc_handler<Handler> make_custom_alloc_handler(handler_memory &memory,
+                                                       Handler handler) {
+  return custom_alloc_handler<Handler>(memory, handler);
+}
+
+// a view on a vector of buffers: asio copies the sequence it's given
+template <typename Buffer> struct buffer_span {
+  typedef Buffer value_type;
+  typedef const Buffer *const_iterator;
+  const_iterator first;
+  const_iterator last;
+  const_iterator begin() const { return first; }
+  const_iterator end() const { return last; }
+};
+
+template <typename Buffer>
+buffer_span<Buffer> span_of(const std::vector<Buffer> &buffers) {
+  return buffer_span<Buffer>{buffers.data(), buffers.data() + buffers.size()};
+}
+}
+
 /*
   using boost::asio::ip::tcp::iostream is comfy,
   but results in using (hardcoded buffers of size 512),
@@ -79,10 +168,8 @@ void TCP_transport::expires_from_now(
   _timeout = _convert(timeout);
 }
 
-void TCP_transport::write_exact(const char *buf, int len) {
-  boost::asio::const_buffers_1 buffer(buf, len);
-  // boost::asio::write(_socket, buffer);
-
+template <typename Buffers>
+void TCP_transport::_write(const Buffers &buffers, std::size_t len) {
   //_io_service.reset();
   _deadline.expires_from_now(_timeout);
   boost::system::error_code ec = boost::asio::error::would_block;
@@ -97,7 +184,8 @@ void TCP_transport::write_exact(const char *buf, int len) {
       ec = boost::asio::error::eof;
     }
   };
-  boost::asio::async_write(_socket, buffer, handler);
+  boost::asio::async_write(_socket, buffers,
+                           make_custom_alloc_handler(_write_memory, handler));
 
   do {
     _io_service.run_one();
@@ -107,10 +195,8 @@ void TCP_transport::write_exact(const char *buf, int len) {
     throw boost::system::system_error(ec);
 }
 
-void TCP_transport::read_exact(char *buf, int len) {
-  boost::asio::mutable_buffers_1 buffer(buf, len);
-  // boost::asio::read(_socket, buffer);
-
+template <typename Buffers>
+void TCP_transport::_read(const Buffers &buffers, std::size_t len) {
   //_io_service.reset();
   _deadline.expires_from_now(_timeout);
   boost::system::error_code ec = boost::asio::error::would_block;
@@ -125,7 +211,8 @@ void TCP_transport::read_exact(char *buf, int len) {
       ec = boost::asio::error::eof;
     }
   };
-  boost::asio::async_read(_socket, buffer, handler);
+  boost::asio::async_read(_socket, buffers,
+                          make_custom_alloc_handler(_read_memory, handler));
 
   // Block until the asynchronous operation has completed.
 
@@ -137,6 +224,40 @@ void TCP_transport::read_exact(char *buf, int len) {
     throw boost::system::system_error(ec);
 }
 
+void TCP_transport::write_exact(const char *buf, int len) {
+  boost::asio::const_buffers_1 buffer(buf, len);
+  // boost::asio::write(_socket, buffer);
+  _write(buffer, len);
+}
+
+void TCP_transport::read_exact(char *buf, int len) {
+  boost::asio::mutable_buffers_1 buffer(buf, len);
+  // boost::asio::read(_socket, buffer);
+  _read(buffer, len);
+}
+
+void TCP_transport::write_iov(const struct iovec *iov, int iovcnt) {
+  // asio hands a buffer sequence to sendmsg as is (a writev)
+  _write_buffers.clear();
+  std::size_t len = 0;
+  for (int i = 0; i < iovcnt; i++) {
+    _write_buffers.emplace_back(iov[i].iov_base, iov[i].iov_len);
+    len += iov[i].iov_len;
+  }
+  _write(span_of(_write_buffers), len);
+}
+
+void TCP_transport::read_iov(const struct iovec *iov, int iovcnt) {
+  // .. and to recvmsg (a readv)
+  _read_buffers.clear();
+  std::size_t len = 0;
+  for (int i = 0; i < iovcnt; i++) {
+    _read_buffers.emplace_back(iov[i].iov_base, iov[i].iov_len);
+    len += iov[i].iov_len;
+  }
+  _read(span_of(_read_buffers), len);
+}
+
 void TCP_transport::_check_deadline() {
   if (_deadline.expires_at() <= deadline_timer::traits_type::now()) {
     boost::system::error_code ignored_ec;
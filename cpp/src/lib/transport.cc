@@ -57,9 +57,25 @@ llio::message Transport::read_message() {
 }
 
 void Transport::output(llio::message_builder &mb) {
-  mb.output_using([&](const char *buffer, const int len) -> void {
-    this->write_exact(buffer, len);
+  mb.output_iov_using([&](const struct iovec *iov, const int iovcnt) -> void {
+    if (iovcnt == 1) {
+      this->write_exact((const char *)iov[0].iov_base, iov[0].iov_len);
+    } else {
+      this->write_iov(iov, iovcnt);
+    }
   });
 }
+
+void Transport::write_iov(const struct iovec *iov, int iovcnt) {
+  for (int i = 0; i < iovcnt; i++) {
+    this->write_exact((const char *)iov[i].iov_base, iov[i].iov_len);
+  }
+}
+
+void Transport::read_iov(const struct iovec *iov, int iovcnt) {
+  for (int i = 0; i < iovcnt; i++) {
+    this->read_exact((char *)iov[i].iov_base, iov[i].iov_len);
+  }
+}
 }
 }
@@ -0,0 +1,161 @@
+/*
+Copyright (C) 2016 iNuron NV
+
+This file is part of Open vStorage Open Source Edition (OSE), as available from
+
+
+    http://www.openvstorage.org and
+    http://www.openvstorage.com.
+
+This file is free software; you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License v3 (GNU AGPLv3)
+as published by the Free Software Foundation, in version 3 as it comes
+in the <LICENSE.txt> file of the Open vStorage OSE distribution.
+
+Open vStorage is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY of any kind.
+*/
+
+#include "reed_solomon.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <random>
+#include <string>
+
+using namespace alba;
+
+TEST(erasure, coding_matrix) {
+  // as jerasure has it: the first row, and the first column, all ones
+  auto cm = erasure::coding_matrix(4, 3);
+  ASSERT_EQ(12, cm.size());
+  for (uint32_t j = 0; j < 4; j++) {
+    EXPECT_EQ(1, cm[j]);
+  }
+  for (uint32_t i = 0; i < 3; i++) {
+    EXPECT_EQ(1, cm[i * 4]);
+  }
+  // k = 1 is replication
+  auto r = erasure::coding_matrix(1, 2);
+  EXPECT_EQ(std::vector<uint8_t>({1, 1}), r);
+}
+
+// encodes the fragments of data (all as long) with k = data.size()
+std::vector<std::vector<byte>> _parity(const std::vector<std::string> &data,
+                                       uint32_t m) {
+  const size_t len = data[0].size();
+  std::vector<std::vector<byte>> parity(m, std::vector<byte>(len));
+  std::vector<const byte *> in;
+  for (auto &d : data) {
+    in.push_back((const byte *)d.data());
+  }
+  std::vector<byte *> out;
+  for (auto &p : parity) {
+    out.push_back(p.data());
+  }
+  erasure::encode(data.size(), m, in.data(), out.data(), len);
+  return parity;
+}
+
+TEST(erasure, known_answers) {
+  /* with another coding matrix than the ocaml side's, a rebuild gives
+     wrong bytes. This is jerasure's for k=7 m=7 w=8, as its reed_sol_01
+     example prints it. */
+  const std::vector<uint8_t> jerasure_7_7{
+      1, 1,   1,   1,   1,   1,   1,   //
+      1, 199, 210, 240, 105, 121, 248, //
+      1, 70,  91,  245, 56,  142, 167, //
+      1, 170, 114, 42,  87,  78,  231, //
+      1, 38,  236, 53,  233, 175, 65,  //
+      1, 64,  174, 232, 52,  237, 39,  //
+      1, 187, 104, 210, 211, 105, 186};
+  EXPECT_EQ(jerasure_7_7, erasure::coding_matrix(7, 7));
+
+  // k=2 m=1: the parity is the xor of the two
+  auto p21 = _parity({"The quick brown ", "fox jumps over t"}, 1);
+  const std::vector<byte> xor_21{0x32, 0x07, 0x1d, 0x00, 0x1b, 0x00,
+                                 0x04, 0x13, 0x18, 0x00, 0x0d, 0x04,
+                                 0x0a, 0x05, 0x4e, 0x54};
+  EXPECT_EQ(xor_21, p21[0]);
+
+  // k=7 m=7, with that matrix
+  auto p77 = _parity({"The quick brown ", "fox jumps over t",
+                      "he lazy dog, and", " then some more.",
+                      "0123456789abcdef", "ghijklmnopqrstuv",
+                      "wxyz!@#$%^&*()_+"},
+                     7);
+  const std::vector<std::vector<byte>> parity_77{
+      {0x5a, 0x37, 0x77, 0x2a, 0x6a, 0x43, 0x76, 0x21, 0x63, 0x1d, 0x7c,
+       0x7f, 0x7d, 0x2f, 0x0a, 0x25},
+      {0x34, 0xe5, 0xdd, 0xa9, 0x1d, 0x9e, 0x5e, 0x9e, 0x02, 0x10, 0x66,
+       0x56, 0x42, 0x42, 0xa3, 0x94},
+      {0x32, 0xab, 0x96, 0xf3, 0xd6, 0x58, 0x0c, 0x7e, 0x25, 0x41, 0xb3,
+       0xf1, 0xb3, 0xfc, 0x43, 0x42},
+      {0x03, 0xd2, 0x85, 0x93, 0x44, 0x42, 0x78, 0x13, 0x3b, 0x61, 0x1b,
+       0x7c, 0x0c, 0x49, 0x6f, 0xae},
+      {0xd2, 0xb5, 0x30, 0xc4, 0x31, 0x81, 0x25, 0x13, 0x59, 0x98, 0x2a,
+       0x80, 0xa7, 0xd3, 0x24, 0xf2},
+      {0x32, 0x1e, 0x7a, 0xe4, 0x93, 0x0a, 0x55, 0x58, 0xec, 0x5c, 0xa2,
+       0xa9, 0xc1, 0x5e, 0x6e, 0x73},
+      {0x73, 0x81, 0x94, 0xe3, 0x40, 0x3f, 0x8c, 0x82, 0x47, 0x59, 0x70,
+       0xb0, 0xb2, 0xdd, 0xe7, 0x4c}};
+  EXPECT_EQ(parity_77, p77);
+}
+
+TEST(erasure, rebuild_from_any_k) {
+  const uint32_t k = 4;
+  const uint32_t m = 13;
+  // (not a multiple of 32, for the tails of the kernels)
+  const size_t len = 1000;
+  std::mt19937 gen(42);
+  std::vector<std::vector<byte>> fragments(k + m, std::vector<byte>(len));
+  for (uint32_t i = 0; i < k; i++) {
+    for (auto &b : fragments[i]) {
+      b = gen();
+    }
+  }
+  std::vector<const byte *> data;
+  std::vector<byte *> parity;
+  for (uint32_t i = 0; i < k + m; i++) {
+    if (i < k) {
+      data.push_back(fragments[i].data());
+    } else {
+      parity.push_back(fragments[i].data());
+    }
+  }
+  erasure::encode(k, m, data.data(), parity.data(), len);
+
+  for (int round = 0; round < 50; round++) {
+    std::vector<uint32_t> ids(k + m);
+    for (uint32_t i = 0; i < k + m; i++) {
+      ids[i] = i;
+    }
+    std::shuffle(ids.begin(), ids.end(), gen);
+    std::vector<uint32_t> sources(ids.begin(), ids.begin() + k);
+    uint32_t wanted = ids[k];
+
+    std::vector<uint8_t> coefficients;
+    ASSERT_TRUE(erasure::decoding_coefficients(k, m, sources, wanted,
+                                               coefficients));
+    std::vector<const byte *> inputs;
+    for (auto s : sources) {
+      inputs.push_back(fragments[s].data());
+    }
+    // a range that starts anywhere
+    size_t offset = gen() % 100;
+    for (auto &p : inputs) {
+      p += offset;
+    }
+    std::vector<byte> out(len - offset);
+    erasure::combine(coefficients.data(), inputs.data(), k, out.data(),
+                     out.size());
+    EXPECT_TRUE(std::equal(out.begin(), out.end(),
+                           fragments[wanted].begin() + offset))
+        << "wanted=" << wanted;
+  }
+
+  std::vector<uint8_t> coefficients;
+  EXPECT_FALSE(
+      erasure::decoding_coefficients(k, m, {0, 1, 2}, 3, coefficients));
+  EXPECT_FALSE(
+      erasure::decoding_coefficients(k, m, {0, 1, 2, 1}, 3, coefficients));
+}
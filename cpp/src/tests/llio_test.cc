@@ -16,13 +16,17 @@ Open vStorage is distributed in the hope that it will be useful,
 but WITHOUT ANY WARRANTY of any kind.
 */
 
+#include "generic_proxy_client.h"
 #include "llio.h"
 #include "stuff.h"
+#include "transport.h"
 #include "gtest/gtest.h"
 #include <boost/log/trivial.hpp>
 #include <boost/optional.hpp>
+#include <cstring>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 using namespace alba::llio;
@@ -125,3 +129,205 @@ TEST(llio, to_from_be) {
     EXPECT_EQ(t, res);
   }
 }
+
+TEST(llio, add_external) {
+  std::string small("small");
+  std::string big(10000, 'x');
+  for (size_t i = 0; i < big.size(); i++) {
+    big[i] = (char)i;
+  }
+
+  message_builder copied;
+  message_builder referenced;
+  for (auto mb : {&copied, &referenced}) {
+    to<uint32_t>(*mb, 42);
+    if (mb == &copied) {
+      mb->add_raw(big.data(), big.size());
+      mb->add_raw(small.data(), small.size());
+      mb->add_raw(big.data(), big.size());
+    } else {
+      mb->add_external(big.data(), big.size());
+      mb->add_external(small.data(), small.size());
+      mb->add_external(big.data(), big.size());
+    }
+    to<uint32_t>(*mb, 43);
+  }
+
+  std::ostringstream sos;
+  copied.output(sos);
+  std::string expected = sos.str();
+
+  std::string gathered;
+  int n_iov = 0;
+  referenced.output_iov_using([&](const struct iovec *iov, int iovcnt) {
+    n_iov = iovcnt;
+    for (int i = 0; i < iovcnt; i++) {
+      gathered.append((const char *)iov[i].iov_base, iov[i].iov_len);
+    }
+  });
+  EXPECT_EQ(5, n_iov);
+  EXPECT_EQ(expected, gathered);
+
+  std::ostringstream sos2;
+  referenced.output(sos2);
+  EXPECT_EQ(expected, sos2.str());
+  EXPECT_EQ(copied.as_string_no_size(), referenced.as_string_no_size());
+}
+
+// replays canned responses and swallows whatever is written to it
+class canned_transport : public alba::transport::Transport {
+public:
+  canned_transport(const std::string &input, int &n_read_iov)
+      : _input(input), _n_read_iov(n_read_iov) {}
+
+  void
+  expires_from_now(const std::chrono::steady_clock::duration &) override {}
+  void write_exact(const char *, int) override {}
+  void read_exact(char *buf, int len) override {
+    ASSERT_LE(_pos + len, _input.size());
+    memcpy(buf, _input.data() + _pos, len);
+    _pos += len;
+  }
+  void read_iov(const struct iovec *iov, int iovcnt) override {
+    _n_read_iov++;
+    alba::transport::Transport::read_iov(iov, iovcnt);
+  }
+
+private:
+  std::string _input;
+  size_t _pos{0};
+  int &_n_read_iov;
+};
+
+void _add_encoded_object_info(message_builder &mb, const std::string &name,
+                              const std::string &manifest,
+                              uint32_t namespace_id) {
+  to(mb, name);
+  to(mb, std::string("alba_id"));
+  char version = 2;
+  mb.add_raw(&version, 1);
+  to(mb, manifest);
+  to<uint32_t>(mb, namespace_id);
+}
+
+TEST(llio, read_objects_slices_response) {
+  using namespace alba::proxy_protocol;
+  using alba::proxy_client::consistent_read;
+  std::string data("0123456789abcdefghij");
+
+  // an error is decoded from the fully buffered response
+  message_builder failed;
+  to<uint32_t>(failed, 5);
+  to(failed, std::string("no such object"));
+
+  message_builder ok;
+  to<uint32_t>(ok, 0);
+  to<uint32_t>(ok, data.size());
+  ok.add_raw(data.data(), data.size());
+  to<uint32_t>(ok, 2);
+  _add_encoded_object_info(ok, "a", "manifest of a", 7);
+  _add_encoded_object_info(ok, "b", "manifest of b", 8);
+
+  std::ostringstream sos;
+  failed.output(sos);
+  ok.output(sos);
+  int n_read_iov = 0;
+  std::unique_ptr<alba::transport::Transport> transport(
+      new canned_transport(sos.str(), n_read_iov));
+  alba::proxy_client::GenericProxy_client client(std::chrono::seconds(1),
+                                                 std::move(transport));
+
+  std::string a("a");
+  std::string b("b");
+  std::vector<alba::byte> buf(data.size(), 0);
+  std::vector<ObjectSlices> slices{
+      ObjectSlices{a, {SliceDescriptor{&buf[0], 0, 4},
+                       SliceDescriptor{&buf[4], 100, 6}}},
+      ObjectSlices{b, {SliceDescriptor{&buf[10], 0, 10}}}};
+  alba::statistics::RoraCounter cntr;
+  std::vector<encoded_object_info> object_infos;
+
+  try {
+    client.read_objects_slices2("ns", slices, consistent_read::T, object_infos,
+                                cntr);
+    FAIL() << "expected a proxy_exception";
+  } catch (alba::proxy_client::proxy_exception &e) {
+    EXPECT_EQ(5, e._return_code);
+    EXPECT_EQ("no such object", e._what);
+  }
+  EXPECT_EQ(0, n_read_iov);
+  EXPECT_EQ(0, object_infos.size());
+  EXPECT_EQ(std::string(data.size(), '\0'),
+            std::string((char *)buf.data(), buf.size()));
+
+  // the slice data is read straight into the slices, the tail is buffered
+  client.read_objects_slices2("ns", slices, consistent_read::T, object_infos,
+                              cntr);
+  EXPECT_EQ(1, n_read_iov);
+  EXPECT_EQ(data, std::string((char *)buf.data(), buf.size()));
+  ASSERT_EQ(2, object_infos.size());
+  for (uint32_t i = 0; i < 2; i++) {
+    auto &info = object_infos[i];
+    std::string name(i == 0 ? "a" : "b");
+    EXPECT_EQ(name, info.name);
+    EXPECT_EQ("alba_id", info.alba_id);
+    message m = info.manifest;
+    uint8_t version;
+    from(m, version);
+    EXPECT_EQ(2, version);
+    std::string manifest;
+    from(m, manifest);
+    EXPECT_EQ("manifest of " + name, manifest);
+    uint32_t namespace_id;
+    from(m, namespace_id);
+    EXPECT_EQ(7 + i, namespace_id);
+  }
+}
+
+TEST(llio, buffer_pool) {
+  namespace bp = alba::llio::buffer_pool;
+  EXPECT_EQ(bp::MIN_CAPACITY, bp::capacity_for(1));
+  EXPECT_EQ(4096, bp::capacity_for(4096));
+  EXPECT_EQ(8192, bp::capacity_for(4097));
+  EXPECT_EQ(bp::MAX_CAPACITY, bp::capacity_for(bp::MAX_CAPACITY));
+  EXPECT_EQ(bp::MAX_CAPACITY + 1, bp::capacity_for(bp::MAX_CAPACITY + 1));
+
+  // a released buffer is handed out again for the same size class
+  char *b0 = bp::allocate(3000);
+  bp::release(b0, bp::capacity_for(3000));
+  char *b1 = bp::allocate(4000);
+  EXPECT_EQ(b0, b1);
+  bp::release(b1, bp::capacity_for(4000));
+
+  // buffers released by another thread are usable here too
+  size_t big = 1 << 20;
+  char *b2 = bp::allocate(big);
+  std::thread t([&]() { bp::release(b2, bp::capacity_for(big)); });
+  t.join();
+  char *b3 = bp::allocate(big);
+  EXPECT_EQ(b2, b3);
+  bp::release(b3, bp::capacity_for(big));
+
+  char *huge = bp::allocate(bp::MAX_CAPACITY + 1);
+  bp::release(huge, bp::capacity_for(bp::MAX_CAPACITY + 1));
+}
+
+TEST(llio, message_builder_reserve) {
+  message_builder mb(10000);
+  std::string s(9000, 'x');
+  to(mb, s);
+  std::string s2(100000, 'y');
+  mb.reserve(s2.size() + 4);
+  to(mb, s2);
+
+  std::ostringstream sos;
+  mb.output(sos);
+  std::istringstream sis(sos.str());
+  auto buffer = message_buffer::from_istream(sis);
+  message m(buffer);
+  std::string r, r2;
+  from(m, r);
+  from(m, r2);
+  EXPECT_EQ(s, r);
+  EXPECT_EQ(s2, r2);
+}
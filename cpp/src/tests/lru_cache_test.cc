@@ -0,0 +1,150 @@
+/*
+Copyright (C) 2016 iNuron NV
+
+This file is part of Open vStorage Open Source Edition (OSE), as available from
+
+
+    http://www.openvstorage.org and
+    http://www.openvstorage.com.
+
+This file is free software; you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License v3 (GNU AGPLv3)
+as published by the Free Software Foundation, in version 3 as it comes
+in the <LICENSE.txt> file of the Open vStorage OSE distribution.
+
+Open vStorage is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY of any kind.
+*/
+
+#include "alba_logger.h"
+#include "lru_cache.h"
+#include "gtest/gtest.h"
+#include <random>
+#include <string>
+
+using ovs::HashedLRUCache;
+using ovs::eviction_policy;
+
+namespace {
+std::ostream &operator<<(std::ostream &os, eviction_policy policy) {
+  os << (policy == eviction_policy::LRU ? "LRU" : "TWO_Q");
+  return os;
+}
+
+bool access(HashedLRUCache<uint64_t, uint64_t> &cache, uint64_t k) {
+  auto eq = [k](const uint64_t &k2) { return k == k2; };
+  if (cache.find(k, eq) != boost::none) {
+    return true;
+  }
+  uint64_t key = k;
+  cache.insert(k, std::move(key), k);
+  return false;
+}
+
+struct hit_ratio {
+  double hot;
+  double overall;
+};
+
+// a hot set that's used all the time, with every now and then a sequential
+// scan (a backup, a scrub) over many more objects than fit in the cache.
+hit_ratio replay(eviction_policy policy) {
+  const size_t capacity = 1000;
+  const uint64_t hot_set = 500;
+  const uint64_t scan_length = 5000;
+  HashedLRUCache<uint64_t, uint64_t> cache(capacity, policy);
+  std::mt19937_64 rng(42);
+  std::uniform_int_distribution<uint64_t> hot(0, hot_set - 1);
+  uint64_t scan_next = 1 << 20;
+  size_t hot_hits = 0, hot_accesses = 0, hits = 0, accesses = 0;
+  for (int round = 0; round < 20; round++) {
+    for (int i = 0; i < 5000; i++) {
+      bool hit = access(cache, hot(rng));
+      hot_hits += hit;
+      hot_accesses++;
+      hits += hit;
+      accesses++;
+      if (i % 2 == 0 && round % 4 == 3) {
+        // scan interleaved with the regular work
+        hits += access(cache, scan_next++);
+        accesses++;
+      }
+    }
+    for (uint64_t i = 0; i < scan_length; i++) {
+      hits += access(cache, scan_next++);
+      accesses++;
+    }
+  }
+  hit_ratio r{(double)hot_hits / hot_accesses, (double)hits / accesses};
+  ALBA_LOG(INFO, policy << ": hot set hit ratio= " << r.hot
+                        << ", overall hit ratio= " << r.overall);
+  return r;
+}
+}
+
+TEST(lru_cache, hit_ratio_with_scans) {
+  hit_ratio lru = replay(eviction_policy::LRU);
+  hit_ratio two_q = replay(eviction_policy::TWO_Q);
+  EXPECT_GT(two_q.hot, lru.hot);
+  EXPECT_GT(two_q.overall, lru.overall);
+}
+
+TEST(lru_cache, two_q_admission) {
+  HashedLRUCache<uint64_t, uint64_t> cache(8, eviction_policy::TWO_Q);
+  for (uint64_t k = 0; k < 8; k++) {
+    access(cache, k);
+  }
+  // a second access doesn't promote out of the FIFO
+  EXPECT_TRUE(access(cache, 0));
+  for (uint64_t k = 100; k < 102; k++) {
+    access(cache, k);
+  }
+  EXPECT_FALSE(access(cache, 0)); // pushed out, but remembered
+  for (uint64_t k = 200; k < 220; k++) { // a scan
+    access(cache, k);
+  }
+  EXPECT_TRUE(access(cache, 0)); // so it went into the main queue
+  EXPECT_EQ(8, cache.size());
+}
+
+TEST(lru_cache, demote_all) {
+  for (auto policy : {eviction_policy::LRU, eviction_policy::TWO_Q}) {
+    HashedLRUCache<uint64_t, uint64_t> cache(100, policy);
+    for (uint64_t k = 0; k < 10; k++) {
+      uint64_t key = k;
+      cache.insert(k, std::move(key), k, 10);
+    }
+    EXPECT_EQ(100, cache.weight());
+    cache.demote_all();
+    EXPECT_EQ(10, cache.demoted());
+    EXPECT_TRUE(access(cache, 5)); // used again: no longer demoted
+    EXPECT_EQ(9, cache.demoted());
+    access(cache, 50);
+    size_t n = 0;
+    while (cache.demoted() > 0) {
+      EXPECT_EQ(10, cache.pop_lru());
+      n++;
+    }
+    EXPECT_EQ(9, n);
+    EXPECT_EQ(2, cache.size());
+    EXPECT_TRUE(access(cache, 5));
+    EXPECT_TRUE(access(cache, 50));
+  }
+}
+
+TEST(lru_cache, shared_clock) {
+  std::atomic<uint64_t> clock{0};
+  HashedLRUCache<uint64_t, uint64_t> a(10, eviction_policy::LRU, &clock);
+  HashedLRUCache<uint64_t, uint64_t> b(10, eviction_policy::LRU, &clock);
+  EXPECT_EQ(UINT64_MAX, a.victim_stamp());
+  access(a, 1);
+  access(b, 2);
+  access(a, 3);
+  // a's 1 is the coldest of both
+  EXPECT_LT(a.victim_stamp(), b.victim_stamp());
+  access(a, 1);
+  // now it's b's 2
+  EXPECT_LT(b.victim_stamp(), a.victim_stamp());
+  b.pop_lru();
+  EXPECT_EQ(UINT64_MAX, b.victim_stamp());
+}
@@ -0,0 +1,152 @@
+/*
+Copyright (C) 2016 iNuron NV
+
+This file is part of Open vStorage Open Source Edition (OSE), as available from
+
+
+    http://www.openvstorage.org and
+    http://www.openvstorage.com.
+
+This file is free software; you can redistribute it and/or modify it
+under the terms of the GNU Affero General Public License v3 (GNU AGPLv3)
+as published by the Free Software Foundation, in version 3 as it comes
+in the <LICENSE.txt> file of the Open vStorage OSE distribution.
+
+Open vStorage is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY of any kind.
+*/
+
+#include "osd_access.h"
+#include "gtest/gtest.h"
+#include <string>
+#include <vector>
+
+using namespace alba::proxy_client;
+using alba::byte;
+
+TEST(osd_access, read_plan_merges_per_key) {
+  std::vector<byte> fragment(100000);
+  for (size_t i = 0; i < fragment.size(); i++) {
+    fragment[i] = (byte)(i * 7);
+  }
+  std::vector<byte> b0(4096), b1(4096), b2(100), b3(4096);
+  std::string k1("fragment_1");
+  std::string k2("fragment_2");
+  std::vector<asd_slice> slices{
+      {&k1, 8192, 4096, b1.data()}, // adjacent to the one below
+      {&k2, 0, 100, b2.data()},     // other key
+      {&k1, 4096, 4096, b0.data()},
+      {&k1, 40960, 4096, b3.data()}, // too far away
+  };
+
+  asd_read_plan plan;
+  plan.build(slices, 1024);
+  ASSERT_EQ(plan.requests.size(), 2);
+
+  auto &r1 = plan.requests[0];
+  EXPECT_EQ(*r1.key, k1);
+  ASSERT_EQ(r1.slices.size(), 2);
+  EXPECT_EQ(r1.slices[0].offset, 4096);
+  EXPECT_EQ(r1.slices[0].length, 8192);
+  EXPECT_EQ(r1.slices[1].offset, 40960);
+  EXPECT_EQ(r1.slices[1].target, b3.data()); // no need for scratch
+
+  auto &r2 = plan.requests[1];
+  EXPECT_EQ(*r2.key, k2);
+  ASSERT_EQ(r2.slices.size(), 1);
+  EXPECT_EQ(r2.slices[0].target, b2.data());
+
+  // play asd
+  for (auto &r : plan.requests) {
+    for (auto &s : r.slices) {
+      memcpy(s.target, &fragment[s.offset], s.length);
+    }
+  }
+  plan.scatter();
+  EXPECT_TRUE(std::equal(b0.begin(), b0.end(), &fragment[4096]));
+  EXPECT_TRUE(std::equal(b1.begin(), b1.end(), &fragment[8192]));
+  EXPECT_TRUE(std::equal(b3.begin(), b3.end(), &fragment[40960]));
+}
+
+TEST(osd_access, read_plan_overlap_and_gap) {
+  std::vector<byte> fragment(10000);
+  for (size_t i = 0; i < fragment.size(); i++) {
+    fragment[i] = (byte)(i * 13);
+  }
+  std::vector<byte> b0(1000), b1(1000), b2(10);
+  std::string k("fragment");
+  std::vector<asd_slice> slices{
+      {&k, 500, 1000, b0.data()},
+      {&k, 0, 1000, b1.data()},  // overlaps
+      {&k, 1600, 10, b2.data()}, // 100 bytes gap
+  };
+
+  asd_read_plan plan;
+  plan.build(slices, 0);
+  ASSERT_EQ(plan.requests.size(), 1);
+  ASSERT_EQ(plan.requests[0].slices.size(), 2);
+
+  plan.build(slices, 100);
+  ASSERT_EQ(plan.requests.size(), 1);
+  ASSERT_EQ(plan.requests[0].slices.size(), 1);
+  auto &s = plan.requests[0].slices[0];
+  EXPECT_EQ(s.offset, 0);
+  EXPECT_EQ(s.length, 1610);
+  memcpy(s.target, &fragment[0], s.length);
+  plan.scatter();
+  EXPECT_TRUE(std::equal(b0.begin(), b0.end(), &fragment[500]));
+  EXPECT_TRUE(std::equal(b1.begin(), b1.end(), &fragment[0]));
+  EXPECT_TRUE(std::equal(b2.begin(), b2.end(), &fragment[1600]));
+}
+
+TEST(osd_access, latency_tracker_follows_the_device) {
+  using alba::asd::latency_tracker;
+  using std::chrono::milliseconds;
+  using std::chrono::microseconds;
+  latency_tracker t(milliseconds(25), milliseconds(1), milliseconds(100));
+  for (int i = 0; i < 10; i++) {
+    t.add(milliseconds(1));
+  }
+  EXPECT_EQ(milliseconds(25), t.timeout()); // not enough samples yet
+
+  // a fast device
+  for (int i = 0; i < 1000; i++) {
+    t.add(i % 100 == 0 ? milliseconds(2) : milliseconds(1));
+  }
+  EXPECT_GE(t.timeout(), milliseconds(2));
+  EXPECT_LE(t.timeout(), milliseconds(5));
+  auto e = t.estimate();
+  EXPECT_EQ(1010, e.samples);
+  EXPECT_GE(e.ewma, microseconds(900));
+  EXPECT_LE(e.ewma, microseconds(1300));
+
+  // that gets slow
+  for (int i = 0; i < 100; i++) {
+    t.add(milliseconds(60));
+  }
+  EXPECT_EQ(milliseconds(100), t.timeout()); // the ceiling
+
+  // and fast again: the slow samples are forgotten
+  for (int i = 0; i < 5000; i++) {
+    t.add(microseconds(200));
+  }
+  EXPECT_EQ(milliseconds(1), t.timeout()); // the floor
+}
+
+TEST(osd_access, latency_tracker_percentile) {
+  using alba::asd::latency_tracker;
+  using std::chrono::milliseconds;
+  latency_tracker t(milliseconds(25), milliseconds(1), milliseconds(100));
+  t.add(milliseconds(1));
+  // not enough samples yet: the timeout
+  EXPECT_EQ(milliseconds(25), t.percentile(0.5));
+
+  // one read in 20 is slow
+  for (int i = 1; i < 100; i++) {
+    t.add(i % 20 == 0 ? milliseconds(20) : milliseconds(1));
+  }
+  EXPECT_GE(t.percentile(0.9), milliseconds(1));
+  EXPECT_LE(t.percentile(0.9), milliseconds(2));
+  EXPECT_GE(t.percentile(0.99), milliseconds(20));
+  EXPECT_LE(t.percentile(0.99), milliseconds(25));
+}
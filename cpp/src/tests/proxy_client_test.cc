@@ -26,12 +26,30 @@ but WITHOUT ANY WARRANTY of any kind.
 #include <boost/property_tree/json_parser.hpp>
 #include <boost/property_tree/ptree.hpp>
 
+#include "fast_path.h"
+#include "generic_proxy_client.h"
+#include "location_resolver.h"
 #include "manifest_cache.h"
 #include "osd_access.h"
 #include "osd_info.h"
+#include "reed_solomon.h"
+#include "rora_proxy_client.h"
+#include "snapshot.h"
+#include "snappy.h"
+#include "transport.h"
+#include "transport_helper.h"
+#include <arpa/inet.h>
+#include <bzlib.h>
+#include <gcrypt.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <thread>
 
 using std::string;
 using std::cout;
@@ -562,8 +580,8 @@ TEST(proxy_client, test_partial_read_full_object) {
   ALBA_LOG(DEBUG, "alba_id " << alba_id);
   auto entry = mfc.find(namespace_, alba_id, name);
   auto pt_r = pt.get_child("result");
-  ASSERT_EQ(entry->name, pt_r.get<string>("name"));
-  ASSERT_EQ(entry->size, pt_r.get<uint64_t>("size"));
+  ASSERT_EQ(entry->name(), pt_r.get<string>("name"));
+  ASSERT_EQ(entry->size(), pt_r.get<uint64_t>("size"));
 
   auto fragments = pt_r.get_child("fragments");
   int chunk_index = 0;
@@ -572,12 +590,11 @@ TEST(proxy_client, test_partial_read_full_object) {
     for (auto js_fr = chunk->second.begin(); js_fr != chunk->second.end();
          ++js_fr) {
 
-      auto mf_fr = entry->fragments[chunk_index][fragment_index];
-      int mf_len = mf_fr->len;
+      int mf_len = entry->fragment_length(chunk_index, fragment_index);
       int js_len = js_fr->second.get<int>("len");
 
       ASSERT_EQ(mf_len, js_len);
-      auto mf_loc = mf_fr->loc;
+      auto mf_loc = entry->fragment_location(chunk_index, fragment_index);
       boost::optional<osd_t> mf_osd_o = std::get<0>(mf_loc);
 
       if (boost::none != mf_osd_o) {
@@ -594,7 +611,8 @@ TEST(proxy_client, test_partial_read_full_object) {
       ASSERT_EQ(mf_version, js_version);
 
       // "crc": [ "Crc32c", "0xc1103e5c" ],
-      shared_ptr<Checksum> mf_crc = mf_fr->crc;
+      shared_ptr<Checksum> mf_crc =
+          entry->fragment_checksum(chunk_index, fragment_index);
       alba::algo_t mf_crc_algo = mf_crc->get_algo();
       auto js_crc = js_fr->second.get_child("crc");
 
@@ -627,7 +645,8 @@ TEST(proxy_client, test_partial_read_full_object) {
 
       //"fnr": "\u0004\u0000\u0000\u0000\u0000\u0000\u0000\u0000"
       ostringstream mf_fnr_ss;
-      dump_string_option(mf_fnr_ss, mf_fr->fnr);
+      dump_string_option(mf_fnr_ss,
+                         entry->fragment_fnr(chunk_index, fragment_index));
 
       auto mf_fnr_s = mf_fnr_ss.str();
       ALBA_LOG(DEBUG, "mf_fnr =" << mf_fnr_s);
@@ -657,6 +676,1658 @@ TEST(proxy_client, manifest_cache_eviction) {
   }
 }
 
+std::shared_ptr<const proxy_protocol::CompactManifest>
+_make_named_manifest(const string &name) {
+  using namespace proxy_protocol;
+  ManifestWithNamespaceId mf;
+  mf.name = name;
+  mf.object_id = "object_id_" + name;
+  mf.encoding_scheme = EncodingScheme{2, 1, 8};
+  mf.compression = std::unique_ptr<Compression>(new NoCompression());
+  mf.encrypt_info = std::make_shared<encryption::NoEncryption>();
+  mf.checksum = std::unique_ptr<Checksum>(new NoChecksum());
+  mf.size = 0;
+  mf.version_id = 1;
+  mf.max_disks_per_node = 3;
+  mf.timestamp = 1.0;
+  mf.namespace_id = namespace_t{0};
+  return std::make_shared<const CompactManifest>(mf);
+}
+
+TEST(proxy_client, manifest_cache_byte_budget) {
+  using namespace proxy_protocol;
+  using alba::proxy_client::ManifestCache;
+  using alba::proxy_client::manifest_cache_weight;
+  auto make_manifest = _make_named_manifest;
+  const size_t weight = manifest_cache_weight(*make_manifest("object_00"));
+  const size_t max_bytes = 10 * weight;
+
+  ManifestCache &mfc = ManifestCache::getInstance();
+  mfc.set_capacity(1000, max_bytes);
+  std::vector<string> namespaces{"budget_0", "budget_1", "budget_2"};
+  for (int i = 0; i < 10; i++) {
+    for (auto &ns : namespaces) {
+      std::ostringstream sos;
+      sos << "object_" << i / 10 << i % 10;
+      mfc.add(ns, "alba_id", make_manifest(sos.str()));
+    }
+  }
+  auto usage = mfc.usage();
+  ALBA_LOG(INFO, usage);
+  EXPECT_LE(usage.bytes, max_bytes);
+  EXPECT_EQ(10, usage.entries);
+  EXPECT_EQ(3, usage.namespaces);
+  for (auto &ns : namespaces) {
+    // the most recent ones survive, in every namespace
+    EXPECT_NE(nullptr, mfc.find(ns, "alba_id", "object_09"));
+    EXPECT_EQ(nullptr, mfc.find(ns, "alba_id", "object_00"));
+    mfc.invalidate_namespace(ns);
+  }
+  usage = mfc.usage();
+  EXPECT_EQ(0, usage.bytes);
+  EXPECT_EQ(0, usage.entries);
+  mfc.set_capacity(10000, 256 << 20);
+}
+
+TEST(proxy_client, manifest_cache_keeps_hot_namespace) {
+  using alba::proxy_client::ManifestCache;
+  using alba::proxy_client::manifest_cache_weight;
+  const size_t weight = manifest_cache_weight(*_make_named_manifest("o_0000"));
+  ManifestCache &mfc = ManifestCache::getInstance();
+  mfc.set_capacity(1000, 200 * weight);
+
+  // a small namespace that's read all the time next to big ones that are
+  // streamed through the cache: the cold entries pay, whichever namespace
+  // they're in. Enough namespaces for the eviction to sample shards.
+  auto name = [](int i) {
+    std::ostringstream sos;
+    sos << "o_" << std::setw(4) << std::setfill('0') << i;
+    return sos.str();
+  };
+  const string hot("hot_namespace");
+  for (int i = 0; i < 16; i++) {
+    mfc.add(hot, "alba_id", _make_named_manifest(name(i)));
+  }
+  std::vector<string> cold;
+  for (int n = 0; n < 9; n++) {
+    cold.push_back("cold_namespace_" + std::to_string(n));
+  }
+  for (int i = 0; i < 2000; i++) {
+    mfc.add(cold[i % cold.size()], "alba_id", _make_named_manifest(name(i)));
+    if (i % 10 == 0) {
+      for (int j = 0; j < 16; j++) {
+        EXPECT_NE(nullptr, mfc.find(hot, "alba_id", name(j)));
+      }
+    }
+  }
+  auto usage = mfc.usage();
+  EXPECT_LE(usage.bytes, 200 * weight);
+  for (int j = 0; j < 16; j++) {
+    EXPECT_NE(nullptr, mfc.find(hot, "alba_id", name(j)));
+  }
+  EXPECT_EQ(nullptr, mfc.find(cold[0], "alba_id", name(0)));
+  mfc.invalidate_namespace(hot);
+  for (auto &ns : cold) {
+    mfc.invalidate_namespace(ns);
+  }
+  EXPECT_EQ(0, mfc.usage().entries);
+  mfc.set_capacity(10000, 256 << 20);
+}
+
+TEST(proxy_client, manifest_cache_demoted_first) {
+  using alba::proxy_client::ManifestCache;
+  using alba::proxy_client::manifest_cache_weight;
+  const size_t weight = manifest_cache_weight(*_make_named_manifest("o_00"));
+  ManifestCache &mfc = ManifestCache::getInstance();
+  mfc.set_capacity(1000, 20 * weight);
+  auto name = [](int i) {
+    std::ostringstream sos;
+    sos << "o_" << i / 10 << i % 10;
+    return sos.str();
+  };
+  for (int i = 0; i < 10; i++) {
+    mfc.add("demoted", "alba_id", _make_named_manifest(name(i)));
+  }
+  mfc.demote_namespace("demoted");
+  for (int i = 0; i < 15; i++) {
+    mfc.add("other", "alba_id", _make_named_manifest(name(i)));
+  }
+  EXPECT_EQ(20, mfc.usage().entries);
+  for (int i = 0; i < 15; i++) {
+    EXPECT_NE(nullptr, mfc.find("other", "alba_id", name(i)));
+  }
+  mfc.invalidate_namespace("demoted");
+  mfc.invalidate_namespace("other");
+  mfc.set_capacity(10000, 256 << 20);
+}
+
+std::unique_ptr<proxy_protocol::ManifestWithNamespaceId>
+_make_test_manifest() {
+  using namespace proxy_protocol;
+  std::unique_ptr<ManifestWithNamespaceId> mf(new ManifestWithNamespaceId());
+  mf->name = "object";
+  mf->object_id = "object_id";
+  mf->chunk_sizes = {4096, 100};
+  mf->encoding_scheme = EncodingScheme{2, 1, 8};
+  mf->compression = std::unique_ptr<Compression>(new SnappyCompression());
+  mf->encrypt_info = std::make_shared<encryption::NoEncryption>();
+  mf->checksum = std::unique_ptr<Checksum>(new Crc32c(0xdeadbeef));
+  mf->size = 4196;
+  mf->version_id = 1;
+  mf->max_disks_per_node = 3;
+  mf->namespace_id = namespace_t{7};
+  for (uint32_t c = 0; c < 2; c++) {
+    std::vector<std::shared_ptr<Fragment>> chunk;
+    for (uint32_t f = 0; f < 3; f++) {
+      auto fragment = std::make_shared<Fragment>();
+      if (f != 1) {
+        fragment->loc.first = osd_t{f};
+      }
+      fragment->loc.second = c;
+      fragment->crc = std::make_shared<Crc32c>(f);
+      fragment->len = 2048 + f;
+      fragment->ctr = string(16, (char)f);
+      chunk.push_back(fragment);
+    }
+    mf->fragments.push_back(chunk);
+  }
+  return mf;
+}
+
+TEST(proxy_client, compact_manifest) {
+  using namespace proxy_protocol;
+  auto mf = _make_test_manifest();
+  CompactManifest cmf(*mf);
+  EXPECT_EQ(mf->name, cmf.name());
+  EXPECT_EQ(mf->object_id, cmf.object_id());
+  EXPECT_EQ(2, cmf.n_chunks());
+  EXPECT_EQ(100, cmf.chunk_size(1));
+  EXPECT_EQ(3, cmf.n_fragments(1));
+  EXPECT_EQ(2, cmf.encoding_scheme().k);
+  EXPECT_EQ(compressor_t::SNAPPY, cmf.compressor());
+  EXPECT_EQ(2050, cmf.fragment_length(1, 2));
+  auto loc = cmf.fragment_location(1, 2);
+  EXPECT_EQ(2, loc.first->i);
+  EXPECT_EQ(1, loc.second);
+  EXPECT_TRUE(boost::none == cmf.fragment_location(0, 1).first);
+  EXPECT_EQ(string(16, (char)2), *cmf.fragment_ctr(0, 2));
+  EXPECT_TRUE(boost::none == cmf.fragment_fnr(0, 2));
+  auto crc = cmf.fragment_checksum(1, 2);
+  ASSERT_EQ(alba::algo_t::CRC32c, crc->get_algo());
+  EXPECT_EQ(2, ((Crc32c *)crc.get())->_digest);
+
+  // the block can be moved around as is
+  std::vector<char> copy(cmf.block(), cmf.block() + cmf.block_size());
+  CompactManifest cmf2(copy.data(), copy.size(), cmf.encrypt_info());
+  std::ostringstream before, after;
+  before << *mf;
+  after << cmf2;
+  EXPECT_EQ(before.str(), after.str());
+
+  // but not truncated
+  EXPECT_THROW(CompactManifest(copy.data(), copy.size() - 8,
+                               cmf.encrypt_info()),
+               alba::llio::deserialisation_exception);
+}
+
+// a manifest as the proxy sends it (version 2)
+std::string _to_wire(const proxy_protocol::ManifestWithNamespaceId &mf) {
+  using namespace alba::llio;
+  message_builder inner;
+  to(inner, mf.name);
+  to(inner, mf.object_id);
+  to(inner, mf.chunk_sizes);
+  inner.add_type(1);
+  inner.add_type(1);
+  to(inner, mf.encoding_scheme.k);
+  to(inner, mf.encoding_scheme.m);
+  inner.add_type(mf.encoding_scheme.w);
+  inner.add_type(2); // snappy
+  inner.add_type(1); // no encryption
+  mf.checksum->to(inner);
+  to(inner, mf.size);
+  inner.add_type(1);
+  to(inner, (uint32_t)mf.fragments.size());
+  for (auto c = mf.fragments.rbegin(); c != mf.fragments.rend(); ++c) {
+    to(inner, (uint32_t)c->size());
+    for (auto f = c->rbegin(); f != c->rend(); ++f) {
+      auto &fragment = **f;
+      message_builder fmb;
+      fmb.add_type(1);
+      to(fmb, fragment.loc.first != boost::none);
+      if (fragment.loc.first != boost::none) {
+        to(fmb, (uint32_t)fragment.loc.first->i);
+      }
+      to(fmb, fragment.loc.second);
+      fragment.crc->to(fmb);
+      to(fmb, fragment.len);
+      to(fmb, fragment.ctr != boost::none);
+      if (fragment.ctr != boost::none) {
+        to(fmb, varint_t{fragment.ctr->size()});
+        fmb.add_raw(fragment.ctr->data(), fragment.ctr->size());
+      }
+      to(fmb, false);
+      std::string fs = fmb.as_string_no_size();
+      to(inner, varint_t{fs.size()});
+      inner.add_raw(fs.data(), fs.size());
+    }
+  }
+  std::string raw = inner.as_string_no_size();
+  std::string compressed;
+  snappy::Compress(raw.data(), raw.size(), &compressed);
+
+  message_builder outer;
+  outer.add_type(2);
+  to(outer, compressed);
+  to(outer, (uint32_t)mf.namespace_id.i);
+  return outer.as_string_no_size();
+}
+
+TEST(proxy_client, compact_manifest_from_wire) {
+  using namespace proxy_protocol;
+  auto mf = _make_test_manifest();
+  std::string wire = _to_wire(*mf);
+
+  auto buffer = alba::llio::message_buffer::from_string(wire);
+  alba::llio::message m(buffer);
+  std::shared_ptr<const CompactManifest> cmf;
+  bool ok_to_continue = false;
+  alba::llio::from2(m, cmf, ok_to_continue);
+  ASSERT_NE(nullptr, cmf);
+  EXPECT_EQ(wire.size(), m.get_pos());
+
+  // the same as going via the full decode
+  alba::llio::message m2(buffer);
+  ManifestWithNamespaceId mf2;
+  alba::llio::from2(m2, mf2, ok_to_continue);
+  CompactManifest cmf2(mf2);
+  // (which doesn't know about version_id & co in version 2)
+  ASSERT_EQ(cmf2.n_chunks(), cmf->n_chunks());
+  EXPECT_EQ(mf->name, cmf->name());
+  EXPECT_EQ(mf->object_id, cmf->object_id());
+  EXPECT_EQ(mf->size, cmf->size());
+  EXPECT_EQ(7, cmf->namespace_id().i);
+  EXPECT_EQ(compressor_t::SNAPPY, cmf->compressor());
+  for (uint32_t c = 0; c < cmf->n_chunks(); c++) {
+    EXPECT_EQ(cmf2.chunk_size(c), cmf->chunk_size(c));
+    ASSERT_EQ(cmf2.n_fragments(c), cmf->n_fragments(c));
+    for (uint32_t f = 0; f < cmf->n_fragments(c); f++) {
+      auto loc = cmf->fragment_location(c, f);
+      auto loc2 = cmf2.fragment_location(c, f);
+      ASSERT_EQ(loc2.first == boost::none, loc.first == boost::none);
+      if (loc.first != boost::none) {
+        EXPECT_EQ(loc2.first->i, loc.first->i);
+      }
+      EXPECT_EQ(loc2.second, loc.second);
+      EXPECT_EQ(cmf2.fragment_length(c, f), cmf->fragment_length(c, f));
+      EXPECT_EQ(*cmf2.fragment_ctr(c, f), *cmf->fragment_ctr(c, f));
+      EXPECT_TRUE(boost::none == cmf->fragment_fnr(c, f));
+      auto crc = cmf->fragment_checksum(c, f);
+      ASSERT_EQ(alba::algo_t::CRC32c, crc->get_algo());
+      EXPECT_EQ(f, ((Crc32c *)crc.get())->_digest);
+    }
+  }
+
+  // a truncated one is refused, not read past the end
+  std::string truncated = wire.substr(0, wire.size() - 20);
+  auto buffer3 = alba::llio::message_buffer::from_string(truncated);
+  alba::llio::message m3(buffer3);
+  EXPECT_THROW(alba::llio::from2(m3, cmf, ok_to_continue),
+               alba::llio::deserialisation_exception);
+}
+
+TEST(proxy_client, object_infos_batch) {
+  using namespace proxy_protocol;
+  using alba::proxy_client::ManifestCache;
+  using alba::proxy_client::manifest_cache_entry;
+  const uint32_t n = 20;
+  alba::llio::message_builder mb;
+  alba::llio::to(mb, n);
+  for (uint32_t i = 0; i < n; i++) {
+    auto mf = _make_test_manifest();
+    mf->name = "object_" + std::to_string(i);
+    alba::llio::to(mb, mf->name);
+    alba::llio::to(mb, string("alba_id"));
+    std::string wire = _to_wire(*mf);
+    mb.add_raw(wire.data(), wire.size());
+  }
+  std::string tail = mb.as_string_no_size();
+  auto buffer = alba::llio::message_buffer::from_string(tail);
+  alba::llio::message m(buffer);
+  std::vector<encoded_object_info> infos;
+  read_read_objects_slices2_response_tail(m, infos);
+  ASSERT_EQ(n, infos.size());
+  EXPECT_EQ(tail.size(), m.get_pos());
+
+  std::vector<std::pair<alba_id_t, manifest_cache_entry>> entries;
+  for (auto &info : infos) {
+    auto mf = decode_manifest(info);
+    EXPECT_EQ(info.name, mf->name());
+    entries.emplace_back(info.alba_id, mf);
+  }
+  ManifestCache &mfc = ManifestCache::getInstance();
+  mfc.add("batch", std::move(entries));
+  EXPECT_EQ(n, mfc.usage().entries);
+  for (uint32_t i = 0; i < n; i++) {
+    EXPECT_NE(nullptr,
+              mfc.find("batch", "alba_id", "object_" + std::to_string(i)));
+  }
+  mfc.invalidate_namespace("batch");
+}
+
+TEST(proxy_client, encrypt_info_interned) {
+  using namespace alba::encryption;
+  Encrypted e1;
+  e1.algo = alba::encryption::algo_t::AES;
+  e1.mode = chaining_mode_t::CTR;
+  e1.key_length = key_length_t::L256;
+  e1.key_identification = string(32, 'a');
+  Encrypted e2 = e1;
+  auto i1 = intern(e1);
+  EXPECT_EQ(i1, intern(e2));
+  EXPECT_NE(&e1, i1.get());
+  e2.key_identification = string(32, 'b');
+  EXPECT_NE(i1, intern(e2));
+  e2.key_identification = e1.key_identification;
+  e2.mode = chaining_mode_t::CBC;
+  EXPECT_NE(i1, intern(e2));
+  EXPECT_EQ(intern(NoEncryption()), intern(NoEncryption()));
+
+  // manifests share them
+  auto mf = _make_test_manifest();
+  proxy_protocol::CompactManifest cmf1(*mf);
+  mf->encrypt_info = std::make_shared<NoEncryption>();
+  proxy_protocol::CompactManifest cmf2(*mf);
+  EXPECT_EQ(cmf1.encrypt_info(), cmf2.encrypt_info());
+}
+
+TEST(proxy_client, partial_decrypt_slices) {
+  // (partial-decrypt-benchmark in test_client times these)
+  using namespace alba::encryption;
+  Encrypted e;
+  e.algo = alba::encryption::algo_t::AES;
+  e.mode = chaining_mode_t::CTR;
+  e.key_length = key_length_t::L256;
+  string key(32, 'k');
+  // the low half of the counter wraps around in the 3rd block
+  string ctr(16, '\xff');
+  ctr[0] = 0;
+  const uint32_t n_slices = 64;
+  const uint32_t slice_size = 4096;
+  const uint32_t size = n_slices * slice_size;
+
+  std::vector<byte> plain(size);
+  for (uint32_t i = 0; i < size; i++) {
+    plain[i] = i * 7 + (i >> 12);
+  }
+  // the whole thing encrypted in one go
+  std::vector<byte> encrypted = plain;
+  gcry_cipher_hd_t hd;
+  gcry_cipher_open(&hd, GCRY_CIPHER_AES256, GCRY_CIPHER_MODE_CTR, 0);
+  gcry_cipher_setkey(hd, key.data(), key.size());
+  gcry_cipher_setctr(hd, ctr.data(), ctr.size());
+  gcry_cipher_encrypt(hd, encrypted.data(), size, nullptr, 0);
+  gcry_cipher_close(hd);
+
+  // all of it, in slices that don't start on a block (except the first)
+  auto slices_of = [&](std::vector<byte> &buf) {
+    std::vector<Encrypted::slice> slices;
+    for (uint32_t i = 0; i < n_slices; i++) {
+      uint32_t offset = i == 0 ? 0 : i * slice_size - 3;
+      uint32_t end = i + 1 == n_slices ? size : (i + 1) * slice_size - 3;
+      slices.push_back(Encrypted::slice{&buf[offset], end - offset,
+                                        (const unsigned char *)ctr.data(),
+                                        offset});
+    }
+    return slices;
+  };
+  std::vector<byte> buf = encrypted;
+  auto slices = slices_of(buf);
+  for (auto &sl : slices) {
+    string c = ctr;
+    ASSERT_TRUE(e.partial_decrypt(sl.buf, sl.len, key, c, sl.offset));
+  }
+  EXPECT_TRUE(plain == buf);
+
+  buf = encrypted;
+  ASSERT_TRUE(e.partial_decrypt(key, slices.data(), slices.size()));
+  EXPECT_TRUE(plain == buf);
+
+  // from a few threads at once, each with its own ciphers
+  std::vector<std::vector<byte>> bufs(4, encrypted);
+  std::vector<std::thread> threads;
+  std::atomic<int> ok{0};
+  for (size_t i = 0; i < bufs.size(); i++) {
+    threads.emplace_back([&, i]() {
+      auto s = slices_of(bufs[i]);
+      ok += e.partial_decrypt(key, s.data(), s.size());
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  EXPECT_EQ(4, ok);
+  for (auto &b : bufs) {
+    EXPECT_TRUE(plain == b);
+  }
+}
+
+TEST(proxy_client, checksums) {
+  // (rfc 3720's vectors)
+  std::vector<uint8_t> zeros(32, 0);
+  std::vector<uint8_t> ones(32, 0xff);
+  std::vector<uint8_t> up(32);
+  std::vector<uint8_t> down(32);
+  for (uint8_t i = 0; i < 32; i++) {
+    up[i] = i;
+    down[i] = 31 - i;
+  }
+  EXPECT_EQ(0x8a9136aa, alba::crc32c(0, zeros.data(), zeros.size()));
+  EXPECT_EQ(0x62a8ab43, alba::crc32c(0, ones.data(), ones.size()));
+  EXPECT_EQ(0x46dd794e, alba::crc32c(0, up.data(), up.size()));
+  EXPECT_EQ(0x113fdb5c, alba::crc32c(0, down.data(), down.size()));
+  EXPECT_EQ(0, alba::crc32c(0, nullptr, 0));
+  string fox("The quick brown fox jumps over the lazy dog");
+  auto fox_data = (const uint8_t *)fox.data();
+  EXPECT_EQ(0x22620404, alba::crc32c(0, fox_data, fox.size()));
+  // in pieces (that aren't a multiple of 8)
+  uint32_t crc = alba::crc32c(0, fox_data, 13);
+  EXPECT_EQ(0x22620404, alba::crc32c(crc, fox_data + 13, fox.size() - 13));
+  // (checksum-benchmark in test_client times it on more)
+  std::vector<uint8_t> data(64 << 10);
+  for (size_t i = 0; i < data.size(); i++) {
+    data[i] = i * 7 + (i >> 12);
+  }
+  uint32_t whole = alba::crc32c(0, data.data(), data.size());
+  crc = 0;
+  for (size_t i = 0; i < 1000; i++) {
+    crc = alba::crc32c(crc, &data[i], 1);
+  }
+  EXPECT_EQ(whole, alba::crc32c(crc, &data[1000], data.size() - 1000));
+
+  string abc("abc");
+  auto digest = alba::sha1((const uint8_t *)abc.data(), abc.size());
+  std::ostringstream ss;
+  for (char c : digest) {
+    alba::stuff::dump_hex(ss, c);
+  }
+  EXPECT_EQ("a9993e364706816aba3e25717850c26c9cd0d89d", ss.str());
+
+  for (auto algo : {alba::algo_t::NO_CHECKSUM, alba::algo_t::SHA1,
+                    alba::algo_t::CRC32c}) {
+    auto c = alba::compute_checksum(algo, fox_data, fox.size());
+    EXPECT_EQ(algo, c->get_algo());
+    EXPECT_TRUE(alba::verify(*c, fox_data, fox.size()));
+    EXPECT_EQ(algo == alba::algo_t::NO_CHECKSUM,
+              alba::verify(*c, fox_data, fox.size() - 1));
+  }
+
+  // an upload with its checksum computed
+  proxy_client::sequences::UpdateUploadObject upload(
+      "fox", fox_data, fox.size(), alba::algo_t::CRC32c);
+  ASSERT_NE(nullptr, upload._cs_o);
+  EXPECT_EQ(0x22620404, ((const Crc32c *)upload._cs_o)->_digest);
+}
+
+std::shared_ptr<const proxy_protocol::CompactManifest>
+_make_chunked_manifest(uint32_t n_chunks, uint32_t chunk_size) {
+  using namespace proxy_protocol;
+  CompactManifest::builder b;
+  b.name = "chunked";
+  b.object_id = "chunked_id";
+  b.encoding_scheme = EncodingScheme{2, 1, 8};
+  b.encrypt_info = std::make_shared<encryption::NoEncryption>();
+  b.size = (uint64_t)n_chunks * chunk_size;
+  std::string crc(4, '\0');
+  for (uint32_t c = 0; c < n_chunks; c++) {
+    b.chunk_sizes.push_back(chunk_size);
+    b.add_chunk(3);
+    for (uint32_t f = 0; f < 3; f++) {
+      b.add_fragment(osd_t{f}, 0, alba::algo_t::CRC32c, crc.data(),
+                     crc.size(), chunk_size / 2);
+    }
+  }
+  return std::make_shared<const CompactManifest>(std::move(b));
+}
+
+const alba_id_t _fast_path_alba_id("fast_path_alba_id");
+
+// the asds behind a fast_path_plan: what's stored on each osd
+struct _fake_asds {
+  std::map<osd_t, string> stored;
+
+  // what OsdAccess would do (every osd answers)
+  void read(std::map<osd_t, std::vector<proxy_client::asd_slice>> &per_osd,
+            std::map<osd_t, int> &results) {
+    for (auto &item : per_osd) {
+      for (auto &slice : item.second) {
+        auto &s = stored[item.first];
+        ASSERT_LE(slice.offset + slice.len, s.size());
+        memcpy(slice.target, &s[slice.offset], slice.len);
+      }
+      if (!item.second.empty()) {
+        results[item.first] = 0;
+      }
+    }
+  }
+};
+
+void _no_decrypt(byte *, const proxy_protocol::Location &) {}
+
+/* adds a one chunk object of 2 * fragment_size bytes (k=2, m=1) to the
+   manifest cache, and its fragments to the asds: fragment f is
+   fragments[f] (as it's stored) on osd first_osd + f, or missing when
+   that's empty, with crcs[f] as its checksum (0 without crcs) */
+void _add_fast_path_object(
+    _fake_asds &asds, const string &namespace_, const string &name,
+    uint32_t fragment_size, const std::vector<string> &fragments,
+    proxy_protocol::compressor_t compressor =
+        proxy_protocol::compressor_t::NO_COMPRESSION,
+    std::shared_ptr<proxy_protocol::EncryptInfo> encrypt_info =
+        std::make_shared<encryption::NoEncryption>(),
+    uint64_t first_osd = 0, const std::vector<uint32_t> &crcs = {}) {
+  using namespace proxy_protocol;
+  CompactManifest::builder b;
+  b.name = name;
+  b.object_id = name + "_id";
+  b.encoding_scheme = EncodingScheme{2, 1, alba::erasure::W8};
+  b.compressor = compressor;
+  b.encrypt_info = encrypt_info;
+  b.size = 2 * fragment_size;
+  b.chunk_sizes.push_back(2 * fragment_size);
+  b.add_chunk(3);
+  for (uint32_t f = 0; f < 3; f++) {
+    boost::optional<osd_t> osd;
+    if (!fragments[f].empty()) {
+      osd = osd_t{first_osd + f};
+      asds.stored[*osd] = fragments[f];
+    }
+    uint32_t crc = crcs.empty() ? 0 : crcs[f];
+    b.add_fragment(osd, 0, alba::algo_t::CRC32c, (const char *)&crc,
+                   sizeof(crc), fragments[f].size());
+  }
+  proxy_client::ManifestCache::getInstance().add(
+      namespace_, _fast_path_alba_id,
+      std::make_shared<const CompactManifest>(std::move(b)));
+}
+
+// the chunk lookup as it was: a scan from the start
+proxy_protocol::Location
+_linear_get_location(const proxy_protocol::CompactManifest &mf,
+                     uint64_t pos, uint32_t len) {
+  int chunk_index = -1;
+  uint64_t total = 0;
+  while (total <= pos) {
+    chunk_index++;
+    total += mf.chunk_size(chunk_index);
+  }
+  uint32_t chunk_size = mf.chunk_size(chunk_index);
+  total -= chunk_size;
+  uint32_t fragment_length = chunk_size / mf.encoding_scheme().k;
+  uint32_t fragment_index = (pos - total) / fragment_length;
+  total += fragment_length * fragment_index;
+  proxy_protocol::Location l;
+  l.chunk_id = chunk_index;
+  l.fragment_id = fragment_index;
+  l.offset = pos - total;
+  l.length = std::min(len, fragment_length - l.offset);
+  return l;
+}
+
+TEST(proxy_client, location_resolver) {
+  using namespace proxy_protocol;
+  using alba::proxy_client::resolve_slices;
+  const uint32_t chunk_size = 1 << 20;
+  auto mf = _make_chunked_manifest(4, chunk_size);
+  std::vector<byte> buf(3 * 8192);
+
+  // a slice across two fragments, one across two chunks,
+  // and one that continues the previous one (in the object and the buffer)
+  std::vector<SliceDescriptor> slices{
+      {&buf[8192], chunk_size - 100, 200},
+      {&buf[0], chunk_size / 2 - 100, 200},
+      {&buf[200], chunk_size / 2 + 100, 300},
+      {&buf[0], chunk_size / 2 - 100, 200}, // a duplicate
+  };
+  std::vector<std::pair<byte *, Location>> results;
+  ASSERT_TRUE(resolve_slices(*mf, slices, results));
+  ASSERT_EQ(4, results.size());
+  EXPECT_EQ(&buf[0], results[0].first);
+  EXPECT_EQ(0, results[0].second.chunk_id);
+  EXPECT_EQ(0, results[0].second.fragment_id);
+  EXPECT_EQ(chunk_size / 2 - 100, results[0].second.offset);
+  EXPECT_EQ(100, results[0].second.length);
+  // coalesced
+  EXPECT_EQ(&buf[100], results[1].first);
+  EXPECT_EQ(1, results[1].second.fragment_id);
+  EXPECT_EQ(0, results[1].second.offset);
+  EXPECT_EQ(400, results[1].second.length);
+  EXPECT_EQ(1, results[2].second.fragment_id);
+  EXPECT_EQ(chunk_size / 2 - 100, results[2].second.offset);
+  EXPECT_EQ(1, results[3].second.chunk_id);
+  EXPECT_EQ(0, results[3].second.fragment_id);
+  EXPECT_EQ(100, results[3].second.length);
+  EXPECT_EQ("chunked_id", results[3].second.object_id);
+
+  // past the end
+  std::vector<SliceDescriptor> too_far{{&buf[0], 4 * chunk_size - 10, 20}};
+  EXPECT_FALSE(resolve_slices(*mf, too_far, results));
+  EXPECT_EQ(4, results.size());
+}
+
+TEST(proxy_client, location_resolver_linear_scan) {
+  // (location-resolver-benchmark in test_client times the two)
+  using namespace proxy_protocol;
+  using alba::proxy_client::resolve_slices;
+  const uint32_t chunk_size = 1 << 20;
+  const uint32_t n_slices = 100;
+  const uint32_t slice_size = 4096;
+  std::vector<byte> buf(2 * slice_size);
+  for (uint32_t n_chunks : {1, 100, 10000}) {
+    auto mf = _make_chunked_manifest(n_chunks, chunk_size);
+    uint64_t object_size = (uint64_t)n_chunks * chunk_size;
+    // 4K reads spread over the object, all to the same 4K of memory
+    std::vector<SliceDescriptor> slices;
+    for (uint32_t i = 0; i < n_slices; i++) {
+      uint64_t offset = (object_size - slice_size) / n_slices * i;
+      slices.push_back(SliceDescriptor{&buf[0], offset, slice_size});
+    }
+
+    std::vector<std::pair<byte *, Location>> results;
+    ASSERT_TRUE(resolve_slices(*mf, slices, results));
+    std::vector<Location> linear;
+    for (auto &slice : slices) {
+      uint64_t pos = slice.offset;
+      uint32_t len = slice.size;
+      while (len > 0) {
+        linear.push_back(_linear_get_location(*mf, pos, len));
+        pos += linear.back().length;
+        len -= linear.back().length;
+      }
+    }
+
+    ASSERT_EQ(linear.size(), results.size());
+    for (size_t i = 0; i < linear.size(); i++) {
+      EXPECT_EQ(linear[i].chunk_id, results[i].second.chunk_id);
+      EXPECT_EQ(linear[i].fragment_id, results[i].second.fragment_id);
+      EXPECT_EQ(linear[i].offset, results[i].second.offset);
+      EXPECT_EQ(linear[i].length, results[i].second.length);
+    }
+  }
+}
+
+// counts what this thread allocates while _count_allocations is set
+namespace {
+thread_local bool _count_allocations{false};
+std::atomic<size_t> _allocations{0};
+}
+
+void *operator new(size_t size) {
+  if (_count_allocations) {
+    _allocations++;
+  }
+  void *p = malloc(size);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+  if (_count_allocations) {
+    _allocations++;
+  }
+  return malloc(size);
+}
+
+void operator delete(void *p) noexcept { free(p); }
+
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+void operator delete(void *p, const std::nothrow_t &) noexcept { free(p); }
+
+TEST(proxy_client, fast_path_no_allocations) {
+  using namespace proxy_protocol;
+  using alba::proxy_client::fast_path_plan;
+  using alba::proxy_client::ManifestCache;
+  const uint32_t chunk_size = 1 << 20;
+  const string namespace_("fast_path_namespace");
+  const string name("chunked");
+  const string missing("missing");
+  std::vector<alba_id_t> alba_levels{"fast_path_alba_id"};
+  ManifestCache::getInstance().add(namespace_, alba_levels[0],
+                                   _make_chunked_manifest(4, chunk_size));
+
+  // a 4K read, and one across two fragments
+  std::vector<byte> buf(2 * 4096);
+  std::vector<ObjectSlices> slices{
+      {name, {{&buf[0], 0, 4096}}},
+      {name, {{&buf[4096], chunk_size / 2 - 2048, 4096}}},
+  };
+  fast_path_plan plan;
+  plan.build(alba_levels, namespace_, slices); // the first one may allocate
+
+  _allocations = 0;
+  _count_allocations = true;
+  for (int i = 0; i < 100; i++) {
+    plan.build(alba_levels, namespace_, slices);
+  }
+  _count_allocations = false;
+  EXPECT_EQ(0, _allocations);
+
+  EXPECT_EQ(0, plan.via_proxy.size());
+  ASSERT_EQ(3, plan.locations.size());
+  ASSERT_EQ(2, plan.per_osd.size());
+  auto &on_0 = plan.per_osd[osd_t{0}];
+  auto &on_1 = plan.per_osd[osd_t{1}];
+  ASSERT_EQ(2, on_0.size());
+  ASSERT_EQ(1, on_1.size());
+  EXPECT_EQ(&buf[4096 + 2048], on_1[0].target);
+  EXPECT_EQ(0, on_1[0].offset);
+  EXPECT_EQ(2048, on_1[0].len);
+
+  // the key as the asds know it
+  llio::message_builder mb;
+  char c = 'p';
+  mb.add_raw(&c, 1);
+  llio::to(mb, (uint32_t)0);
+  c = 'n';
+  mb.add_raw(&c, 1);
+  alba::to_be(mb, namespace_t{0});
+  c = 'o';
+  mb.add_raw(&c, 1);
+  llio::to(mb, string("chunked_id"));
+  llio::to(mb, (uint32_t)0); // chunk
+  llio::to(mb, (uint32_t)1); // fragment
+  llio::to(mb, (uint32_t)0); // version
+  EXPECT_EQ(mb.as_string_no_size(), *on_1[0].key);
+  EXPECT_EQ(*on_0[0].key, *on_0[1].key);
+  EXPECT_NE(*on_0[0].key, *on_1[0].key);
+
+  // an object without a manifest in the cache goes via the proxy,
+  // the osd that's left out keeps its (empty) place
+  std::vector<ObjectSlices> other{
+      {missing, {{&buf[0], 0, 4096}}},
+      {name, {{&buf[4096], 0, 4096}}},
+  };
+  plan.build(alba_levels, namespace_, other);
+  ASSERT_EQ(1, plan.via_proxy.size());
+  EXPECT_EQ(0, plan.via_proxy[0]);
+  ASSERT_EQ(1, plan.locations.size());
+  EXPECT_EQ(1, plan.per_osd[osd_t{0}].size());
+  EXPECT_EQ(0, plan.per_osd[osd_t{1}].size());
+}
+
+TEST(proxy_client, fast_path_failed_slices) {
+  using namespace proxy_protocol;
+  using alba::proxy_client::fast_path_plan;
+  using alba::proxy_client::ManifestCache;
+  const uint32_t chunk_size = 1 << 20;
+  const string namespace_("fast_path_failed_namespace");
+  const string name("chunked");
+  std::vector<alba_id_t> alba_levels{"fast_path_alba_id"};
+  ManifestCache::getInstance().add(namespace_, alba_levels[0],
+                                   _make_chunked_manifest(4, chunk_size));
+
+  // fragment 0 is on osd 0, fragment 1 on osd 1
+  std::vector<byte> buf(5 * 4096);
+  std::vector<ObjectSlices> slices{
+      {name,
+       {{&buf[0], 0, 4096},
+        {&buf[4096], chunk_size / 2, 4096},
+        {&buf[2 * 4096], chunk_size / 2 - 2048, 4096}}},
+      {name, {{&buf[3 * 4096], 4096, 4096}}},
+  };
+  fast_path_plan plan;
+  plan.build(alba_levels, namespace_, slices);
+  // (in offset order: the first, the third in two pieces, the second)
+  ASSERT_EQ(5, plan.locations.size());
+
+  plan.osd_results[osd_t{0}] = 0;
+  plan.osd_results[osd_t{1}] = -1;
+  EXPECT_TRUE(plan.read_ok(plan.locations[1].second));
+  EXPECT_FALSE(plan.read_ok(plan.locations[2].second));
+
+  std::vector<ObjectSlices> via_proxy;
+  plan.failed_slices(slices, via_proxy);
+  ASSERT_EQ(1, via_proxy.size());
+  EXPECT_EQ(name, via_proxy[0].object_name);
+  ASSERT_EQ(2, via_proxy[0].slices.size());
+  EXPECT_EQ(&buf[4096], via_proxy[0].slices[0].buf);
+  EXPECT_EQ(&buf[2 * 4096], via_proxy[0].slices[1].buf);
+}
+
+TEST(proxy_client, fast_path_rebuild) {
+  using namespace proxy_protocol;
+  using alba::proxy_client::fast_path_plan;
+  const string namespace_("fast_path_rebuild_namespace");
+  const std::vector<alba_id_t> alba_levels{_fast_path_alba_id};
+  const uint32_t fragment_size = 4096;
+  const string degraded("degraded");
+  const string healthy("healthy");
+
+  // one chunk, k=2 m=1: fragment f on osd f, except that fragment 0 is
+  // missing in the first object
+  std::vector<std::vector<byte>> fragments(3, std::vector<byte>(fragment_size));
+  for (uint32_t i = 0; i < fragment_size; i++) {
+    fragments[0][i] = i * 7;
+    fragments[1][i] = i * 13 + 1;
+  }
+  const byte *data[] = {fragments[0].data(), fragments[1].data()};
+  byte *parity[] = {fragments[2].data()};
+  alba::erasure::encode(2, 1, data, parity, fragment_size);
+
+  std::vector<string> stored;
+  for (auto &f : fragments) {
+    stored.push_back(string(f.begin(), f.end()));
+  }
+  _fake_asds asds;
+  _add_fast_path_object(asds, namespace_, healthy, fragment_size, stored);
+  stored[0].clear();
+  _add_fast_path_object(asds, namespace_, degraded, fragment_size, stored);
+
+  // the missing fragment is rebuilt from the other two
+  std::vector<byte> buf(3000);
+  std::vector<ObjectSlices> slices{{degraded, {{&buf[0], 1000, 3000}}}};
+  fast_path_plan plan;
+  plan.build(alba_levels, namespace_, slices, true);
+  EXPECT_EQ(0, plan.via_proxy.size());
+  ASSERT_EQ(1, plan.locations.size());
+  EXPECT_EQ(0, plan.per_osd[osd_t{0}].size());
+  EXPECT_EQ(1, plan.per_osd[osd_t{1}].size());
+  EXPECT_EQ(1, plan.per_osd[osd_t{2}].size());
+  asds.read(plan.per_osd, plan.osd_results);
+  EXPECT_EQ(1, plan.rebuild(_no_decrypt));
+  EXPECT_TRUE(plan.done(0));
+  EXPECT_TRUE(std::equal(buf.begin(), buf.end(), &fragments[0][1000]));
+
+  // .. unless asked not to
+  plan.build(alba_levels, namespace_, slices);
+  EXPECT_EQ(1, plan.via_proxy.size());
+
+  // an osd that fails: its part is rebuilt after the read
+  std::fill(buf.begin(), buf.end(), 0);
+  std::vector<ObjectSlices> healthy_slices{
+      {healthy, {{&buf[0], 1000, 3000}}}};
+  plan.osd_results.clear();
+  plan.build(alba_levels, namespace_, healthy_slices, true);
+  ASSERT_EQ(1, plan.locations.size());
+  EXPECT_EQ(1, plan.per_osd[osd_t{0}].size());
+  plan.osd_results[osd_t{0}] = -1;
+  ASSERT_TRUE(plan.plan_rebuilds());
+  EXPECT_EQ(0, plan.rebuild_per_osd[osd_t{0}].size());
+  asds.read(plan.rebuild_per_osd, plan.rebuild_results);
+  EXPECT_EQ(1, plan.rebuild(_no_decrypt));
+  EXPECT_TRUE(std::equal(buf.begin(), buf.end(), &fragments[0][1000]));
+  std::vector<ObjectSlices> via_proxy;
+  plan.failed_slices(healthy_slices, via_proxy);
+  EXPECT_EQ(0, via_proxy.size());
+
+  // (osd 0 failed last time, so it's not a source for the first object)
+  plan.osd_results[osd_t{1}] = -1;
+  plan.build(alba_levels, namespace_, slices, true);
+  EXPECT_EQ(1, plan.via_proxy.size());
+}
+
+TEST(proxy_client, fast_path_compressed) {
+  using namespace proxy_protocol;
+  using alba::proxy_client::fast_path_plan;
+  const string namespace_("fast_path_compressed_namespace");
+  const std::vector<alba_id_t> alba_levels{_fast_path_alba_id};
+  const uint32_t fragment_size = 4096;
+  const string with_snappy("with_snappy");
+  const string with_bzip2("with_bzip2");
+
+  // one chunk, k=2 m=1, fragment f on osd f
+  std::vector<byte> fragment(fragment_size);
+  for (uint32_t i = 0; i < fragment_size; i++) {
+    fragment[i] = i * 7;
+  }
+  _fake_asds asds;
+  auto &stored = asds.stored;
+  auto make = [&](const string &name, compressor_t compressor) {
+    string compressed;
+    if (compressor == compressor_t::SNAPPY) {
+      snappy::Compress((const char *)fragment.data(), fragment.size(),
+                       &compressed);
+    } else {
+      // the uncompressed length first
+      uint32_t length = fragment.size();
+      unsigned int compressed_length = length + length / 100 + 600;
+      compressed.resize(4 + compressed_length);
+      memcpy(&compressed[0], &length, 4);
+      ASSERT_EQ(BZ_OK, BZ2_bzBuffToBuffCompress(
+                           &compressed[4], &compressed_length,
+                           (char *)fragment.data(), length, 9, 0, 0));
+      compressed.resize(4 + compressed_length);
+    }
+    _add_fast_path_object(asds, namespace_, name, fragment_size,
+                          {compressed, compressed, compressed}, compressor);
+  };
+
+  for (auto compressor : {compressor_t::SNAPPY, compressor_t::BZIP2}) {
+    const string &name =
+        compressor == compressor_t::SNAPPY ? with_snappy : with_bzip2;
+    make(name, compressor);
+
+    // two slices of fragment 0: it's read (whole) once
+    std::vector<byte> buf(3100);
+    std::vector<ObjectSlices> slices{
+        {name, {{&buf[0], 1000, 3000}, {&buf[3000], 100, 100}}}};
+    fast_path_plan plan;
+    plan.build(alba_levels, namespace_, slices);
+    EXPECT_EQ(0, plan.via_proxy.size());
+    ASSERT_EQ(2, plan.locations.size());
+    ASSERT_EQ(1, plan.per_osd[osd_t{0}].size());
+    EXPECT_EQ(0, plan.per_osd[osd_t{0}][0].offset);
+    EXPECT_EQ(stored[osd_t{0}].size(), plan.per_osd[osd_t{0}][0].len);
+    asds.read(plan.per_osd, plan.osd_results);
+    EXPECT_FALSE(plan.direct(0));
+    EXPECT_EQ(2, plan.decompress(_no_decrypt));
+    EXPECT_TRUE(plan.done(0) && plan.done(1));
+    EXPECT_TRUE(std::equal(&buf[0], &buf[3000], &fragment[1000]));
+    EXPECT_TRUE(std::equal(&buf[3000], &buf[3100], &fragment[100]));
+
+    // the next read of that fragment doesn't go to the asd
+    std::fill(buf.begin(), buf.end(), 0);
+    std::vector<ObjectSlices> next{{name, {{&buf[0], 2000, 2000}}}};
+    plan.osd_results.clear();
+    plan.build(alba_levels, namespace_, next);
+    ASSERT_EQ(1, plan.locations.size());
+    EXPECT_EQ(0, plan.per_osd[osd_t{0}].size());
+    EXPECT_EQ(1, plan.decompress(_no_decrypt));
+    EXPECT_TRUE(std::equal(&buf[0], &buf[2000], &fragment[2000]));
+  }
+
+  // what doesn't decompress is left to the proxy
+  std::vector<byte> buf(100);
+  const string corrupt("corrupt");
+  make(corrupt, compressor_t::SNAPPY);
+  auto &s = stored[osd_t{0}];
+  std::fill(s.begin(), s.end(), '\xff');
+  std::vector<ObjectSlices> slices{{corrupt, {{&buf[0], 0, 100}}}};
+  fast_path_plan plan;
+  plan.build(alba_levels, namespace_, slices);
+  asds.read(plan.per_osd, plan.osd_results);
+  EXPECT_EQ(0, plan.decompress(_no_decrypt));
+  std::vector<ObjectSlices> via_proxy;
+  plan.failed_slices(slices, via_proxy);
+  EXPECT_EQ(1, via_proxy.size());
+
+  // nor does a fragment that says it's larger than its share of the chunk
+  const string too_large("too_large");
+  make(too_large, compressor_t::BZIP2);
+  uint32_t length = 2 * fragment_size + 1;
+  memcpy(&stored[osd_t{0}][0], &length, 4);
+  std::vector<ObjectSlices> too_large_slices{{too_large, {{&buf[0], 0, 100}}}};
+  plan.build(alba_levels, namespace_, too_large_slices);
+  asds.read(plan.per_osd, plan.osd_results);
+  EXPECT_EQ(0, plan.decompress(_no_decrypt));
+  via_proxy.clear();
+  plan.failed_slices(too_large_slices, via_proxy);
+  EXPECT_EQ(1, via_proxy.size());
+}
+
+TEST(proxy_client, fast_path_verified) {
+  using namespace proxy_protocol;
+  using alba::proxy_client::fast_path_plan;
+  const string namespace_("fast_path_verified_namespace");
+  const std::vector<alba_id_t> alba_levels{_fast_path_alba_id};
+  const uint32_t fragment_size = 4096;
+  const string plain("plain");
+  const string compressed("compressed");
+  const string bad_compressed("bad_compressed");
+
+  // one chunk, k=2 m=1, fragment f on osd f. Fragment 1's checksum is
+  // wrong, as is the one of bad_compressed's fragment 0.
+  std::vector<byte> fragment(fragment_size);
+  for (uint32_t i = 0; i < fragment_size; i++) {
+    fragment[i] = i * 7;
+  }
+  string snappy_fragment;
+  snappy::Compress((const char *)fragment.data(), fragment.size(),
+                   &snappy_fragment);
+  _fake_asds asds;
+  auto make = [&](const string &name, bool compress, bool bad_0) {
+    const string &f0 =
+        compress ? snappy_fragment
+                 : string((const char *)fragment.data(), fragment.size());
+    uint32_t crc = alba::crc32c(0, (const uint8_t *)f0.data(), f0.size());
+    _add_fast_path_object(
+        asds, namespace_, name, fragment_size, {f0, f0, f0},
+        compress ? compressor_t::SNAPPY : compressor_t::NO_COMPRESSION,
+        std::make_shared<encryption::NoEncryption>(), 0,
+        {bad_0 ? crc + 1 : crc, crc + 1, crc + 1});
+  };
+  make(plain, false, false);
+
+  // both fragments whole, and a part of the first: only whole ones are
+  // checked
+  std::vector<byte> buf(3 * fragment_size);
+  std::vector<ObjectSlices> slices{
+      {plain,
+       {{&buf[0], 0, 2 * fragment_size},
+        {&buf[2 * fragment_size], 4096 + 100, 100}}}};
+  fast_path_plan plan;
+  plan.build(alba_levels, namespace_, slices);
+  ASSERT_EQ(3, plan.locations.size());
+  asds.read(plan.per_osd, plan.osd_results);
+  EXPECT_EQ(1, plan.verify_direct());
+  EXPECT_TRUE(plan.direct(0));
+  EXPECT_FALSE(plan.direct(1));
+  EXPECT_TRUE(plan.direct(2));
+  std::vector<ObjectSlices> via_proxy;
+  plan.failed_slices(slices, via_proxy);
+  ASSERT_EQ(1, via_proxy.size());
+  ASSERT_EQ(1, via_proxy[0].slices.size());
+  EXPECT_EQ(&buf[0], via_proxy[0].slices[0].buf);
+
+  // a compressed fragment is checked as it's stored
+  make(compressed, true, false);
+  make(bad_compressed, true, true);
+  for (auto name : {&compressed, &bad_compressed}) {
+    std::vector<ObjectSlices> compressed_slices{
+        {*name, {{&buf[0], 1000, 3000}}}};
+    plan.osd_results.clear();
+    plan.build(alba_levels, namespace_, compressed_slices);
+    asds.read(plan.per_osd, plan.osd_results);
+    EXPECT_EQ(name == &compressed ? 1 : 0,
+              plan.decompress(_no_decrypt, true));
+    if (name == &compressed) {
+      EXPECT_TRUE(std::equal(&buf[0], &buf[3000], &fragment[1000]));
+    }
+  }
+}
+
+TEST(proxy_client, fast_path_cbc) {
+  using namespace proxy_protocol;
+  using alba::proxy_client::fast_path_plan;
+  const string namespace_("fast_path_cbc_namespace");
+  const std::vector<alba_id_t> alba_levels{_fast_path_alba_id};
+  const uint32_t fragment_size = 4096;
+  const string plain("cbc");
+  const string compressed("cbc_snappy");
+  const string key(32, 'k');
+  auto ei = std::make_shared<encryption::Encrypted>();
+  ei->algo = encryption::algo_t::AES;
+  ei->mode = encryption::chaining_mode_t::CBC;
+  ei->key_length = encryption::key_length_t::L256;
+  ei->key_identification = "key";
+
+  std::vector<byte> fragment(fragment_size);
+  for (uint32_t i = 0; i < fragment_size; i++) {
+    fragment[i] = i * 7;
+  }
+  // as the ocaml side stores a fragment: padded, then encrypted
+  auto encrypt = [&](string s, const string &object_id) {
+    size_t n = 16 - s.size() % 16;
+    s.append(n, (char)n);
+    string iv = ei->fragment_iv(key, object_id, 0, 0);
+    gcry_cipher_hd_t hd;
+    gcry_cipher_open(&hd, GCRY_CIPHER_AES256, GCRY_CIPHER_MODE_CBC, 0);
+    gcry_cipher_setkey(hd, key.data(), key.size());
+    gcry_cipher_setiv(hd, iv.data(), iv.size());
+    gcry_cipher_encrypt(hd, &s[0], s.size(), nullptr, 0);
+    gcry_cipher_close(hd);
+    return s;
+  };
+
+  // one chunk, k=2 m=1, fragment f on osd f (+ 3 for the compressed one)
+  _fake_asds asds;
+  auto make = [&](const string &name, compressor_t compressor, uint64_t osd) {
+    string s((const char *)fragment.data(), fragment.size());
+    if (compressor == compressor_t::SNAPPY) {
+      string c;
+      snappy::Compress(s.data(), s.size(), &c);
+      s = c;
+    }
+    s = encrypt(s, name + "_id");
+    _add_fast_path_object(asds, namespace_, name, fragment_size, {s, s, s},
+                          compressor, ei, osd);
+  };
+  make(plain, compressor_t::NO_COMPRESSION, 0);
+  make(compressed, compressor_t::SNAPPY, 3);
+  // what the rora client does
+  auto decrypt = [&](byte *buf, const Location &l) {
+    string iv = l.offset == 0
+                    ? ei->fragment_iv(key, l.object_id.to_string(),
+                                      l.chunk_id, l.fragment_id)
+                    : string((const char *)buf - 16, 16);
+    string k = key;
+    ASSERT_TRUE(ei->partial_decrypt(buf, l.length, k, iv, l.offset));
+  };
+
+  // a slice in the first block, and one that starts and ends mid block
+  std::vector<byte> buf(2100);
+  std::vector<ObjectSlices> slices{
+      {plain, {{&buf[0], 5, 100}, {&buf[100], 1000, 2000}}}};
+  fast_path_plan plan;
+  plan.build(alba_levels, namespace_, slices);
+  EXPECT_EQ(0, plan.via_proxy.size());
+  ASSERT_EQ(2, plan.locations.size());
+  auto &reads = plan.per_osd[osd_t{0}];
+  ASSERT_EQ(2, reads.size());
+  EXPECT_EQ(0, reads[0].offset);
+  EXPECT_EQ(112, reads[0].len);
+  EXPECT_EQ(992 - 16, reads[1].offset);
+  EXPECT_EQ(16 + 3008 - 992, reads[1].len);
+  asds.read(plan.per_osd, plan.osd_results);
+  EXPECT_FALSE(plan.direct(0));
+  EXPECT_EQ(2, plan.decrypt_windows(decrypt));
+  EXPECT_TRUE(plan.done(0) && plan.done(1));
+  EXPECT_TRUE(std::equal(&buf[0], &buf[100], &fragment[5]));
+  EXPECT_TRUE(std::equal(&buf[100], &buf[2100], &fragment[1000]));
+
+  // compressed as well: the whole fragment, unpadded before it's
+  // decompressed
+  std::fill(buf.begin(), buf.end(), 0);
+  std::vector<ObjectSlices> compressed_slices{
+      {compressed, {{&buf[0], 2000, 2000}}}};
+  plan.build(alba_levels, namespace_, compressed_slices);
+  ASSERT_EQ(1, plan.per_osd[osd_t{3}].size());
+  asds.read(plan.per_osd, plan.osd_results);
+  EXPECT_EQ(1, plan.decompress(decrypt));
+  EXPECT_TRUE(std::equal(&buf[0], &buf[2000], &fragment[2000]));
+}
+
+// swallows what's written, there's nothing to read
+class _null_transport : public alba::transport::Transport {
+public:
+  void
+  expires_from_now(const std::chrono::steady_clock::duration &) override {}
+  void write_exact(const char *, int) override {}
+  void read_exact(char *, int) override {
+    throw alba::transport::transport_exception("nothing to read");
+  }
+};
+
+/* a proxy that knows osds first_osd .. first_osd + 5 of _fast_path_alba_id
+   (all on asd_port), and fills the slices it's asked for with 'p' (or
+   fails, with fail set) */
+class _fake_proxy : public proxy_client::GenericProxy_client {
+public:
+  _fake_proxy()
+      : GenericProxy_client(std::chrono::seconds(1),
+                            std::unique_ptr<alba::transport::Transport>(
+                                new _null_transport())) {}
+
+  bool fail{false};
+  size_t objects_read{0};
+  uint64_t first_osd{0};
+  int asd_port{8000};
+
+  bool has_local_fragment_cache() override { return false; }
+  void update_session(
+      const std::vector<std::pair<string, boost::optional<string>>> &,
+      std::vector<std::pair<string, string>> &) override {}
+  void osd_info2(proxy_client::osd_maps_t &result) override {
+    proxy_client::osd_map_t osds;
+    for (uint64_t i = first_osd; i < first_osd + 6; i++) {
+      auto ic = std::make_shared<proxy_client::info_caps>();
+      ic->first.kind_asd = true;
+      ic->first.long_id =
+          "asd_" + std::to_string(asd_port) + "_" + std::to_string(i);
+      ic->first.ips = {"127.0.0.1"};
+      ic->first.port = asd_port;
+      ic->first.use_tls = false;
+      ic->first.use_rdma = false;
+      osds[osd_t{i}] = ic;
+    }
+    result.push_back(std::make_pair(_fast_path_alba_id, osds));
+  }
+  void read_objects_slices2(
+      const string &, const std::vector<proxy_protocol::ObjectSlices> &slices,
+      const proxy_client::consistent_read,
+      std::vector<proxy_protocol::encoded_object_info> &,
+      alba::statistics::RoraCounter &cntr) override {
+    if (fail) {
+      throw proxy_client::proxy_exception(1, "proxy failed");
+    }
+    for (auto &object_slices : slices) {
+      for (auto &slice : object_slices.slices) {
+        memset(slice.buf, 'p', slice.size);
+      }
+    }
+    objects_read += slices.size();
+    cntr.slow_path += slices.size();
+  }
+};
+
+TEST(proxy_client, rora_mixed_batch) {
+  using namespace proxy_protocol;
+  string namespace_("rora_mixed_batch");
+  uint32_t fragment_size = 4096;
+  _fake_asds asds;
+  std::vector<string> fragments{string(fragment_size, 'a'),
+                                string(fragment_size, 'b'),
+                                string(fragment_size, 'c')};
+  string cached_0("cached_0");
+  string cached_1("cached_1");
+  string uncached("uncached");
+  _add_fast_path_object(asds, namespace_, cached_0, fragment_size, fragments);
+  _add_fast_path_object(asds, namespace_, cached_1, fragment_size, fragments,
+                        compressor_t::NO_COMPRESSION,
+                        std::make_shared<encryption::NoEncryption>(), 3);
+
+  // (without io, the asds' share is left as it is)
+  proxy_client::RoraConfig rora_config(100, true);
+  auto fake = new _fake_proxy();
+  proxy_client::RoraProxy_client client(
+      std::unique_ptr<proxy_client::GenericProxy_client>(fake), rora_config);
+
+  std::vector<byte> buf(300, 0);
+  std::vector<ObjectSlices> slices{{cached_0, {{&buf[0], 0, 100}}},
+                                   {uncached, {{&buf[100], 0, 100}}},
+                                   {cached_1, {{&buf[200], 0, 100}}}};
+
+  // the asds and the proxy each count their own share
+  alba::statistics::RoraCounter cntr;
+  client.read_objects_slices(namespace_, slices,
+                             proxy_client::consistent_read::F, cntr);
+  EXPECT_EQ(2, cntr.fast_path);
+  EXPECT_EQ(1, cntr.slow_path);
+  EXPECT_EQ(1, fake->objects_read);
+  EXPECT_EQ(string(100, '\0'), string((char *)&buf[0], 100));
+  EXPECT_EQ(string(100, 'p'), string((char *)&buf[100], 100));
+  EXPECT_EQ(string(100, '\0'), string((char *)&buf[200], 100));
+
+  // a failing proxy still fails the read
+  fake->fail = true;
+  alba::statistics::RoraCounter cntr2;
+  EXPECT_THROW(client.read_objects_slices(namespace_, slices,
+                                          proxy_client::consistent_read::F,
+                                          cntr2),
+               proxy_client::proxy_exception);
+  EXPECT_EQ(2, cntr2.fast_path);
+  EXPECT_EQ(0, cntr2.slow_path);
+
+  proxy_client::ManifestCache::getInstance().invalidate_namespace(namespace_);
+}
+
+/* the asds on 127.0.0.1:port, they answer partial gets (byte i of every
+   fragment is i & 0xff, after delay_ms) and nothing else */
+class _loopback_asds {
+public:
+  _loopback_asds() {
+    _listener = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (bind(_listener, (sockaddr *)&addr, len) != 0 ||
+        listen(_listener, 16) != 0 ||
+        getsockname(_listener, (sockaddr *)&addr, &len) != 0) {
+      throw std::runtime_error("can't listen on 127.0.0.1");
+    }
+    port = ntohs(addr.sin_port);
+    _thread = std::thread([this] { _serve(); });
+  }
+
+  ~_loopback_asds() {
+    _stop = true;
+    _thread.join();
+    for (int fd : _fds) {
+      close(fd);
+    }
+    close(_listener);
+  }
+
+  int port;
+  std::atomic<int> delay_ms{0};
+
+private:
+  int _listener;
+  std::vector<int> _fds;
+  std::atomic<bool> _stop{false};
+  std::thread _thread;
+
+  void _serve() {
+    while (!_stop) {
+      std::vector<pollfd> polled{{_listener, POLLIN, 0}};
+      for (int fd : _fds) {
+        polled.push_back({fd, POLLIN, 0});
+      }
+      if (poll(polled.data(), polled.size(), 10) <= 0) {
+        continue;
+      }
+      if (polled[0].revents) {
+        int fd = accept(_listener, nullptr, nullptr);
+        if (fd >= 0 && _prologue(fd)) {
+          _fds.push_back(fd);
+        } else if (fd >= 0) {
+          close(fd);
+        }
+      }
+      for (size_t i = 1; i < polled.size(); i++) {
+        int fd = polled[i].fd;
+        if (polled[i].revents && !_partial_get(fd)) {
+          close(fd);
+          _fds.erase(std::find(_fds.begin(), _fds.end(), fd));
+        }
+      }
+    }
+  }
+
+  static bool _read(int fd, void *buf, size_t len) {
+    for (size_t done = 0; done < len;) {
+      ssize_t n = recv(fd, (char *)buf + done, len - done, 0);
+      if (n <= 0) {
+        return false;
+      }
+      done += n;
+    }
+    return true;
+  }
+
+  static bool _write(int fd, const string &s) {
+    return send(fd, s.data(), s.size(), MSG_NOSIGNAL) == (ssize_t)s.size();
+  }
+
+  // (the asd is whichever one the client wants)
+  bool _prologue(int fd) {
+    char magic_version[8];
+    char has_long_id;
+    uint32_t len = 0;
+    if (!_read(fd, magic_version, 8) || !_read(fd, &has_long_id, 1) ||
+        (has_long_id && !_read(fd, &len, 4))) {
+      return false;
+    }
+    string long_id(len, '\0');
+    if (!_read(fd, &long_id[0], len)) {
+      return false;
+    }
+    uint32_t rc = 0;
+    string response((char *)&rc, 4);
+    response.append((char *)&len, 4);
+    response.append(long_id);
+    return _write(fd, response);
+  }
+
+  bool _partial_get(int fd) {
+    uint32_t size;
+    if (!_read(fd, &size, 4)) {
+      return false;
+    }
+    string request(size, '\0');
+    if (!_read(fd, &request[0], size)) {
+      return false;
+    }
+    llio::message m(llio::message_buffer::from_string(request));
+    uint32_t code;
+    llio::from(m, code);
+    if (code != 11) {
+      return false;
+    }
+    string key;
+    llio::from(m, key);
+    uint32_t n;
+    llio::from(m, n);
+    uint32_t header[] = {5, 0};
+    string response((char *)header, 8);
+    response.push_back('\01');
+    for (uint32_t i = 0; i < n; i++) {
+      uint32_t offset, length;
+      llio::from(m, offset);
+      llio::from(m, length);
+      for (uint32_t j = 0; j < length; j++) {
+        response.push_back((char)((offset + j) & 0xff));
+      }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(delay_ms));
+    return _write(fd, response);
+  }
+};
+
+TEST(proxy_client, rora_read_no_allocations) {
+  using namespace proxy_protocol;
+  using alba::logger::AlbaLogLevel;
+  string namespace_("rora_read_no_allocations");
+  uint32_t fragment_size = 4096;
+  _fake_asds asds;
+  std::vector<string> fragments(3, string(fragment_size, 'x'));
+  string name("on_the_loopback_asds");
+  _add_fast_path_object(asds, namespace_, name, fragment_size, fragments,
+                        compressor_t::NO_COMPRESSION,
+                        std::make_shared<encryption::NoEncryption>(), 10);
+
+  _loopback_asds loopback;
+  proxy_client::RoraConfig rora_config(100);
+  auto fake = new _fake_proxy();
+  fake->first_osd = 10;
+  fake->asd_port = loopback.port;
+  proxy_client::RoraProxy_client client(
+      std::unique_ptr<proxy_client::GenericProxy_client>(fake), rora_config);
+  // (osds 10 .. 15 may be known already, on an earlier port)
+  proxy_client::OsdAccess::getInstance(5, std::chrono::seconds(1))
+      .update(client);
+
+  // two slices of the first fragment, that are read in one go
+  std::vector<byte> buf(1500);
+  std::vector<ObjectSlices> slices{
+      {name, {{&buf[0], 0, 1000}, {&buf[1000], 2000, 500}}}};
+  auto check = [&buf]() {
+    for (uint32_t i = 0; i < 1000; i++) {
+      ASSERT_EQ((byte)i, buf[i]) << i;
+    }
+    for (uint32_t i = 0; i < 500; i++) {
+      ASSERT_EQ((byte)(2000 + i), buf[1000 + i]) << i;
+    }
+  };
+
+  // the first reads connect, and set up what's reused
+  alba::statistics::RoraCounter cntr;
+  for (int i = 0; i < 2; i++) {
+    client.read_objects_slices(namespace_, slices,
+                               proxy_client::consistent_read::F, cntr);
+  }
+  EXPECT_EQ(4, cntr.fast_path);
+  EXPECT_EQ(0, cntr.slow_path);
+  check();
+
+  // (this binary logs everything, a real logger skips the debug messages)
+  auto logger = alba::logger::getLogger(AlbaLogLevel::DEBUG);
+  alba::logger::setLogFunction([](AlbaLogLevel)
+                                   -> std::function<void(AlbaLogLevel,
+                                                         std::string &)> * {
+                                     return nullptr;
+                                   });
+  std::fill(buf.begin(), buf.end(), 0);
+  _allocations = 0;
+  _count_allocations = true;
+  for (int i = 0; i < 10; i++) {
+    client.read_objects_slices(namespace_, slices,
+                               proxy_client::consistent_read::F, cntr);
+  }
+  _count_allocations = false;
+  alba::logger::setLogFunction([logger](AlbaLogLevel) { return logger; });
+  EXPECT_EQ(0, _allocations);
+  EXPECT_EQ(24, cntr.fast_path);
+  EXPECT_EQ(0, cntr.slow_path);
+  EXPECT_EQ(0, fake->objects_read);
+  check();
+
+  proxy_client::ManifestCache::getInstance().invalidate_namespace(namespace_);
+}
+
+TEST(proxy_client, asd_response_times) {
+  _loopback_asds loopback;
+  loopback.delay_ms = 50;
+  auto timeout = std::chrono::milliseconds(150);
+  asd_client::Asd_client asd(
+      timeout,
+      transport::make_transport(transport::Kind::tcp, "127.0.0.1",
+                                std::to_string(loopback.port), timeout),
+      string("loopback"));
+
+  std::vector<string> keys{"a", "b", "c", "d"};
+  std::vector<byte> buf(400);
+  std::vector<asd_client::partial_get_request> requests;
+  for (uint32_t i = 0; i < keys.size(); i++) {
+    requests.push_back({&keys[i], {{i, 100, &buf[100 * i]}}});
+  }
+  // together they take longer than the timeout, one by one they don't
+  asd.partial_gets(requests, 1, timeout);
+  auto &times = asd.response_times();
+  ASSERT_EQ(4, times.size());
+  for (auto &t : times) {
+    EXPECT_GE(t, std::chrono::milliseconds(50));
+    EXPECT_LT(t, timeout);
+  }
+  for (uint32_t i = 0; i < buf.size(); i++) {
+    ASSERT_EQ((byte)(i / 100 + i % 100), buf[i]) << i;
+  }
+}
+
+TEST(proxy_client, rora_hedged_read) {
+  using namespace proxy_protocol;
+  using proxy_client::hedged_read;
+  string namespace_("rora_hedged_read");
+  uint32_t fragment_size = 4096;
+  _fake_asds asds;
+  std::vector<string> fragments(3, string(fragment_size, 'x'));
+  string name("with_a_slow_asd");
+  _add_fast_path_object(asds, namespace_, name, fragment_size, fragments,
+                        compressor_t::NO_COMPRESSION,
+                        std::make_shared<encryption::NoEncryption>(), 20);
+
+  _loopback_asds loopback;
+  proxy_client::RoraConfig rora_config(
+      100, false, 5, 25, 4, 4096, 16, 256 << 20,
+      proxy_client::cache_policy_t::LRU, "", 60, 10000, 5, 1000, 0.5);
+  auto fake = new _fake_proxy();
+  fake->first_osd = 20;
+  fake->asd_port = loopback.port;
+  proxy_client::RoraProxy_client client(
+      std::unique_ptr<proxy_client::GenericProxy_client>(fake), rora_config);
+  // (as the client would have it, unless a test before had it otherwise)
+  auto &osd_access = proxy_client::OsdAccess::getInstance(
+      5, std::chrono::milliseconds(25), 4, 4096, 16,
+      std::chrono::milliseconds(5), std::chrono::milliseconds(1000));
+  osd_access.update(client);
+  if (nullptr == osd_access.start_hedged_read({}, 0.5)) {
+    std::cout << "no threads to read osds on, nothing to hedge" << std::endl;
+    return;
+  }
+
+  // the asd of osd 20 usually answers right away, and sometimes takes 15ms.
+  // (so a read that takes 20ms is late, but doesn't time out)
+  osd_t osd{20};
+  string key("fragment");
+  std::vector<byte> buf(100);
+  std::map<osd_t, std::vector<proxy_client::asd_slice>> per_osd;
+  per_osd[osd].push_back({&key, 0, 100, &buf[0]});
+  for (int i = 0; i < 16; i++) {
+    loopback.delay_ms = i == 15 ? 15 : 0;
+    ASSERT_EQ(0, osd_access.read_osds_slices(per_osd));
+  }
+  loopback.delay_ms = 20;
+  auto stall = std::chrono::milliseconds(20);
+
+  // the proxy is faster, and the asd's answer goes nowhere
+  std::fill(buf.begin(), buf.end(), 0);
+  std::vector<osd_t> late;
+  std::atomic<bool> hedged{false};
+  std::map<osd_t, int> rcs;
+  auto t0 = std::chrono::steady_clock::now();
+  auto read = osd_access.start_hedged_read(per_osd, 0.5);
+  int rc = read->finish(rcs, [&](const std::vector<osd_t> &late_) {
+    late = late_;
+    return std::function<bool()>([&hedged] {
+      hedged = true;
+      return true;
+    });
+  });
+  EXPECT_LT(std::chrono::steady_clock::now() - t0, stall);
+  read.reset();
+  EXPECT_EQ(hedged_read::LATE, rc);
+  EXPECT_EQ(hedged_read::LATE, rcs[osd]);
+  ASSERT_EQ(1, late.size());
+  EXPECT_EQ(osd.i, late[0].i);
+  EXPECT_TRUE(hedged);
+  std::this_thread::sleep_for(3 * stall);
+  EXPECT_EQ(std::vector<byte>(100, 0), buf);
+
+  // the same via the client: the proxy's data is what's read
+  std::vector<ObjectSlices> slices{{name, {{&buf[0], 0, 100}}}};
+  alba::statistics::RoraCounter cntr;
+  t0 = std::chrono::steady_clock::now();
+  client.read_objects_slices(namespace_, slices,
+                             proxy_client::consistent_read::F, cntr);
+  EXPECT_LT(std::chrono::steady_clock::now() - t0, stall);
+  EXPECT_EQ(0, cntr.fast_path);
+  EXPECT_EQ(1, cntr.slow_path);
+  EXPECT_EQ(1, fake->objects_read);
+  EXPECT_EQ(std::vector<byte>(100, 'p'), buf);
+  std::this_thread::sleep_for(3 * stall);
+  EXPECT_EQ(std::vector<byte>(100, 'p'), buf);
+  loopback.delay_ms = 0;
+
+  proxy_client::ManifestCache::getInstance().invalidate_namespace(namespace_);
+}
+
+TEST(proxy_client, snapshot_round_trip) {
+  using namespace proxy_protocol;
+  using namespace alba::proxy_client;
+  snapshot s0;
+  osd_map_t osds;
+  auto ic = std::make_shared<info_caps>();
+  ic->first.kind_asd = true;
+  ic->first.long_id = "long_id";
+  ic->first.ips = {"127.0.0.1", "::1"};
+  ic->first.port = 8000;
+  ic->first.use_tls = false;
+  ic->first.use_rdma = false;
+  ic->first.node_id = "node_0";
+  ic->second.rora_port = 8001;
+  osds[osd_t{3}] = ic;
+  s0.osd_maps.push_back(std::make_pair(string("alba_id_0"), osds));
+
+  auto mf = _make_test_manifest();
+  auto cmf = std::make_shared<const CompactManifest>(*mf);
+  s0.manifests.push_back(cached_manifest{"namespace", "alba_id_0", cmf});
+
+  string path = "/tmp/snapshot_round_trip.snapshot";
+  write_snapshot(path, s0);
+  snapshot s1;
+  ASSERT_TRUE(read_snapshot(path, s1));
+  ASSERT_EQ(1, s1.osd_maps.size());
+  EXPECT_EQ("alba_id_0", s1.osd_maps[0].first);
+  auto &ic1 = s1.osd_maps[0].second.at(osd_t{3});
+  EXPECT_EQ(ic->first.ips, ic1->first.ips);
+  EXPECT_EQ(ic->first.node_id, ic1->first.node_id);
+  EXPECT_EQ(ic->second.rora_port, ic1->second.rora_port);
+  EXPECT_TRUE(boost::none == ic1->second.rora_ips);
+
+  ASSERT_EQ(1, s1.manifests.size());
+  auto &mf1 = *s1.manifests[0].manifest;
+  std::ostringstream before, after;
+  before << *mf;
+  after << mf1;
+  EXPECT_EQ(before.str(), after.str());
+
+  // restoring doesn't replace what the cache has (and is fresher)
+  auto &mfc = ManifestCache::getInstance();
+  mf->version_id = 2;
+  mfc.add("namespace", "alba_id_0",
+          std::make_shared<const CompactManifest>(*mf));
+  s1.osd_maps.clear(); // leave the osds of this process alone
+  restore_snapshot(alba::proxy_client::OsdAccess::getInstance(
+                       5, std::chrono::seconds(1)),
+                   std::move(s1));
+  EXPECT_EQ(2, mfc.find("namespace", "alba_id_0", "object")->version_id());
+  mfc.invalidate_namespace("namespace");
+
+  // a damaged snapshot is ignored
+  {
+    std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+    f.seekp(30);
+    f.put('x');
+  }
+  snapshot s2;
+  EXPECT_FALSE(read_snapshot(path, s2));
+  std::remove(path.c_str());
+}
+
 TEST(proxy_client, test_partial_read_fc) {
   std::string namespace_("test_partial_read_fc");
   std::ostringstream sos;
@@ -747,6 +2418,12 @@ TEST(proxy_client, upload_from_buffer) {
       "large_object", (const uint8_t *)blob_s.data(), blob_s.size(), nullptr);
 
   client->apply_sequence(namespace_, write_barrier, seq);
+
+  // with a checksum for the proxy to check
+  const auto seq2 = proxy_client::sequences::Sequence().add_upload(
+      "large_object_crc", (const uint8_t *)blob_s.data(), blob_s.size(),
+      alba::algo_t::CRC32c);
+  client->apply_sequence(namespace_, write_barrier, seq2);
 }
 
 TEST(proxy_client, manifest_with_ctr) {